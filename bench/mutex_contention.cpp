@@ -0,0 +1,68 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ditto/adaptive_mutex.h"
+#include "ditto/resource_lock.h"
+
+/**
+ * Measures the throughput of short critical sections under contention, with
+ * several threads repeatedly locking the same Ditto::ResourceLock.
+ */
+
+namespace {
+
+constexpr std::uint32_t NUM_ITERATIONS = 200000;
+constexpr std::uint32_t CRITICAL_SECTION_LENGTH = 64;
+
+struct Counters {
+  std::uint64_t values[CRITICAL_SECTION_LENGTH]{};
+};
+
+template <class M>
+auto run(std::uint32_t num_threads) -> double {
+  Ditto::ResourceLock<Counters, M> counters;
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (std::uint32_t i = 0; i < num_threads; i++) {
+    threads.emplace_back([&] {
+      for (std::uint32_t j = 0; j < NUM_ITERATIONS; j++) {
+        counters.lock([](Counters& res) {
+          for (auto& value : res.values) {
+            value++;
+          }
+        });
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+
+  const auto total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  return static_cast<double>(total_ns) / (num_threads * NUM_ITERATIONS);
+}
+
+}  // namespace
+
+auto main() -> int {
+  const std::uint32_t max_threads =
+      std::max(2u, std::thread::hardware_concurrency());
+
+  std::printf("%8s %16s %16s\n", "threads", "std::mutex", "AdaptiveMutex");
+  for (std::uint32_t num_threads = 1; num_threads <= max_threads;
+       num_threads *= 2) {
+    const double std_ns = run<std::mutex>(num_threads);
+    const double adaptive_ns = run<Ditto::AdaptiveMutex<>>(num_threads);
+    std::printf("%8u %13.1f ns %13.1f ns\n", num_threads, std_ns,
+                adaptive_ns);
+  }
+  return 0;
+}
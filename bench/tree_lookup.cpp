@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "ditto/bplus_tree.h"
+#include "ditto/red_black_tree.h"
+
+/**
+ * Compares Ditto::RedBlackTree and Ditto::BPlusTree holding the same keys, on
+ * random point lookups and on short range scans.
+ */
+
+namespace {
+
+constexpr std::uint32_t NUM_KEYS = 1000000;
+constexpr std::uint32_t NUM_LOOKUPS = 1000000;
+constexpr std::uint32_t NUM_SCANS = 100000;
+constexpr std::uint32_t SCAN_LENGTH = 100;
+
+template <class F>
+auto time_ns(std::uint32_t num_ops, F&& function) -> double {
+  const auto start = std::chrono::steady_clock::now();
+  function();
+  const auto elapsed = std::chrono::steady_clock::now() - start;
+  const auto total_ns =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+  return static_cast<double>(total_ns) / num_ops;
+}
+
+// Sum of the values found, so that the compiler cannot drop the lookups
+volatile std::uint64_t g_sink;
+
+template <class Tree>
+auto run_lookups(Tree& tree, const std::vector<std::uint32_t>& probes)
+    -> double {
+  return time_ns(NUM_LOOKUPS, [&] {
+    std::uint64_t sum = 0;
+    for (const std::uint32_t key : probes) {
+      auto value = tree.lookup(key);
+      sum += value.has_value() ? **value : 0;
+    }
+    g_sink = sum;
+  });
+}
+
+template <class Tree>
+auto run_scans(Tree& tree, const std::vector<std::uint32_t>& probes)
+    -> double {
+  return time_ns(NUM_SCANS, [&] {
+    std::uint64_t sum = 0;
+    for (std::uint32_t i = 0; i < NUM_SCANS; i++) {
+      const std::uint32_t first = probes[i];
+      tree.for_each_in_range(first, first + SCAN_LENGTH,
+                             [&](const std::uint32_t&, std::uint32_t& value) {
+                               sum += value;
+                             });
+    }
+    g_sink = sum;
+  });
+}
+
+}  // namespace
+
+auto main() -> int {
+  std::mt19937 generator{42};
+
+  std::vector<std::uint32_t> keys(NUM_KEYS);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), generator);
+
+  std::vector<std::uint32_t> probes(NUM_LOOKUPS);
+  std::uniform_int_distribution<std::uint32_t> distribution{0, NUM_KEYS - 1};
+  for (auto& probe : probes) {
+    probe = distribution(generator);
+  }
+
+  Ditto::RedBlackTree<std::uint32_t, std::uint32_t> red_black_tree;
+  Ditto::BPlusTree<std::uint32_t, std::uint32_t> bplus_tree;
+  for (const std::uint32_t key : keys) {
+    red_black_tree.insert(key, key);
+    bplus_tree.insert(key, key);
+  }
+
+  std::printf("%12s %16s %16s\n", "operation", "RedBlackTree", "BPlusTree");
+  std::printf("%12s %13.1f ns %13.1f ns\n", "lookup",
+              run_lookups(red_black_tree, probes),
+              run_lookups(bplus_tree, probes));
+  std::printf("%12s %13.1f ns %13.1f ns\n", "range scan",
+              run_scans(red_black_tree, probes),
+              run_scans(bplus_tree, probes));
+  return 0;
+}
@@ -0,0 +1,155 @@
+#ifndef DITTO_ADAPTIVE_MUTEX_H_
+#define DITTO_ADAPTIVE_MUTEX_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+
+#include "ditto/arch.h"
+
+namespace Ditto {
+
+/**
+ * @brief Mutex that spins for a while before putting the thread to sleep.
+ *
+ * Critical sections of a few hundred nanoseconds are usually over before a
+ * thread parked in the kernel would even be woken up. When the mutex is
+ * contended, lock() first polls it with an exponential backoff of
+ * arch::cpu_relax() for up to MAX_SPINS iterations. Only then does it fall
+ * back to std::atomic::wait, which is a futex on Linux.
+ *
+ * The state follows the classic three-state futex mutex (unlocked, locked and
+ * locked with waiters), so unlock() only issues a wake-up when some thread is
+ * actually sleeping on the mutex.
+ */
+template <std::uint32_t MAX_SPINS = 256>
+class AdaptiveMutex {
+ public:
+  AdaptiveMutex() = default;
+  AdaptiveMutex(const AdaptiveMutex&) = delete;
+  AdaptiveMutex(AdaptiveMutex&&) = delete;
+  auto operator=(const AdaptiveMutex&) -> AdaptiveMutex& = delete;
+  auto operator=(AdaptiveMutex&&) -> AdaptiveMutex& = delete;
+
+  void lock() {
+    if (!try_lock()) {
+      lock_contended();
+    }
+  }
+
+  [[nodiscard]] auto try_lock() -> bool {
+    std::uint32_t expected = UNLOCKED;
+    return m_state.compare_exchange_strong(expected, LOCKED,
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    if (m_state.exchange(UNLOCKED, std::memory_order_release) == CONTENDED) {
+      m_state.notify_one();
+    }
+  }
+
+ private:
+  static constexpr std::uint32_t UNLOCKED = 0;
+  static constexpr std::uint32_t LOCKED = 1;
+  static constexpr std::uint32_t CONTENDED = 2;
+  static constexpr std::uint32_t MAX_BACKOFF = 16;
+
+  std::atomic<std::uint32_t> m_state{UNLOCKED};
+
+  void lock_contended() {
+    std::uint32_t backoff = 1;
+    for (std::uint32_t spins = 0; spins < MAX_SPINS; spins += backoff) {
+      // Only attempt the exchange when the mutex looks free, so that spinning
+      // threads do not keep stealing the cache line from the owner
+      if ((m_state.load(std::memory_order_relaxed) == UNLOCKED) &&
+          try_lock()) {
+        return;
+      }
+      for (std::uint32_t i = 0; i < backoff; i++) {
+        arch::cpu_relax();
+      }
+      backoff = std::min(backoff * 2, MAX_BACKOFF);
+    }
+
+    // Mark the mutex as contended so that the owner wakes us up. If it was
+    // released in the meantime we just took it, still marked as contended,
+    // which at worst costs a spurious wake-up on unlock
+    while (m_state.exchange(CONTENDED, std::memory_order_acquire) !=
+           UNLOCKED) {
+      m_state.wait(CONTENDED, std::memory_order_relaxed);
+    }
+  }
+};
+
+/**
+ * @brief Mutex for single-core embedded targets that protects a resource by
+ * masking interrupts.
+ *
+ * Controller must provide two static functions: disable_interrupts(), which
+ * masks interrupts and returns the previous mask state, and
+ * restore_interrupts(state). The previous state is kept in the mutex and
+ * restored on unlock, so nested locks of different mutexes must be released
+ * in reverse order, as is always the case with Ditto::ResourceLock.
+ */
+template <class Controller>
+class InterruptMaskMutex {
+ public:
+  using State = decltype(Controller::disable_interrupts());
+
+  InterruptMaskMutex() = default;
+  InterruptMaskMutex(const InterruptMaskMutex&) = delete;
+  InterruptMaskMutex(InterruptMaskMutex&&) = delete;
+  auto operator=(const InterruptMaskMutex&) -> InterruptMaskMutex& = delete;
+  auto operator=(InterruptMaskMutex&&) -> InterruptMaskMutex& = delete;
+
+  void lock() { m_previous_state = Controller::disable_interrupts(); }
+
+  // With interrupts masked there is nobody else that could hold the mutex
+  [[nodiscard]] auto try_lock() -> bool {
+    lock();
+    return true;
+  }
+
+  void unlock() { Controller::restore_interrupts(m_previous_state); }
+
+ private:
+  State m_previous_state{};
+};
+
+#if defined(__arm__) && defined(__ARM_ARCH_PROFILE) && \
+    (__ARM_ARCH_PROFILE == 'M')
+
+namespace arch {
+
+/**
+ * @brief Interrupt controller for InterruptMaskMutex on Cortex-M cores, based
+ * on PRIMASK.
+ */
+struct CortexMInterrupts {
+  static auto disable_interrupts() -> std::uint32_t {
+    std::uint32_t primask;
+    asm volatile(
+        "mrs %0, primask\n"
+        "cpsid i\n"
+        : "=r"(primask)
+        :
+        : "memory");
+    return primask;
+  }
+
+  static void restore_interrupts(std::uint32_t primask) {
+    asm volatile("msr primask, %0\n" : : "r"(primask) : "memory");
+  }
+};
+
+}  // namespace arch
+
+using CortexMInterruptMutex = InterruptMaskMutex<arch::CortexMInterrupts>;
+
+#endif
+
+}  // namespace Ditto
+
+#endif  // DITTO_ADAPTIVE_MUTEX_H_
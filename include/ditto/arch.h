@@ -6,6 +6,21 @@
 
 namespace Ditto::arch {
 uintptr_t get_frame_pointer();
+
+/**
+ * @brief Hints the CPU that the caller is busy-waiting, e.g. with the pause
+ * instruction on x86 or yield on ARM. It is inlined in spin loops, so unlike
+ * the rest of this namespace it is not implemented in src/arch.
+ */
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+  asm volatile("pause\n" ::: "memory");
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield\n" ::: "memory");
+#else
+  asm volatile("" ::: "memory");
+#endif
+}
 }
 
 #endif  // DITTO_ARCH_H
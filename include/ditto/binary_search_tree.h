@@ -4,17 +4,155 @@
 #include <stdint.h>
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
+#include "ditto/assert.h"
 #include "ditto/non_null_ptr.h"
 #include "ditto/optional.h"
+#include "ditto/pair.h"
+#include "ditto/pool_allocator.h"
 
 namespace Ditto {
 
-template <class K, class V>
+/**
+ * @brief Balancing policy of a Ditto::BinarySearchTree that does no balancing.
+ * Inserting keys in order makes the tree degenerate into a list.
+ */
+struct NoBalancing {
+  static constexpr bool REBALANCES = false;
+  static constexpr std::size_t MAX_HEIGHT = 0;
+
+  struct NodeData {};
+
+  template <class Node>
+  static auto rebalance(Node* node) -> Node* {
+    return node;
+  }
+};
+
+/**
+ * @brief Balancing policy of a Ditto::BinarySearchTree that keeps it an AVL
+ * tree: the heights of the subtrees of every node differ at most by one, so
+ * the tree is at most 1.44 * log2(N + 2) levels deep.
+ */
+struct AvlBalancing {
+  static constexpr bool REBALANCES = true;
+  // Bound of the height for as many nodes as fit in the address space
+  static constexpr std::size_t MAX_HEIGHT = sizeof(void*) * 8 * 3 / 2;
+
+  struct NodeData {
+    std::uint8_t height = 1;
+  };
+
+  /**
+   * @brief Restores the balance of a subtree whose children are balanced and
+   * differ at most by two levels. Returns the new root of the subtree.
+   */
+  template <class Node>
+  static auto rebalance(Node* node) -> Node* {
+    update_height(node);
+    const int balance = height(node->left) - height(node->right);
+    if (balance > 1) {
+      if (height(node->left->left) < height(node->left->right)) {
+        node->left = rotate_left(node->left);
+      }
+      return rotate_right(node);
+    }
+    if (balance < -1) {
+      if (height(node->right->right) < height(node->right->left)) {
+        node->right = rotate_right(node->right);
+      }
+      return rotate_left(node);
+    }
+    return node;
+  }
+
+ private:
+  template <class Node>
+  static auto height(Node* node) -> int {
+    return (node != nullptr) ? node->balance.height : 0;
+  }
+
+  template <class Node>
+  static void update_height(Node* node) {
+    node->balance.height = static_cast<std::uint8_t>(
+        1 + std::max(height(node->left), height(node->right)));
+  }
+
+  template <class Node>
+  static auto rotate_left(Node* node) -> Node* {
+    Node* right = node->right;
+    node->right = right->left;
+    right->left = node;
+    update_height(node);
+    update_height(right);
+    return right;
+  }
+
+  template <class Node>
+  static auto rotate_right(Node* node) -> Node* {
+    Node* left = node->left;
+    node->left = left->right;
+    left->right = node;
+    update_height(node);
+    update_height(left);
+    return left;
+  }
+};
+
+/**
+ * @brief Binary search tree, balanced according to the Balancing policy.
+ * Without balancing it is as deep as the order of insertions makes it, see
+ * Ditto::AvlTree for a balanced one.
+ */
+template <class K, class V, class Allocator = std::allocator<Pair<K, V>>,
+          class Balancing = NoBalancing>
 class BinarySearchTree {
  public:
+  using allocator_type = Allocator;
+
+  BinarySearchTree() = default;
+  explicit BinarySearchTree(const Allocator& allocator)
+      : m_allocator(allocator) {}
+
+  BinarySearchTree(BinarySearchTree&& other) noexcept
+      : m_allocator(std::move(other.m_allocator)),
+        m_root(std::exchange(other.m_root, nullptr)) {}
+
+  auto operator=(BinarySearchTree&& other) noexcept -> BinarySearchTree& {
+    if (this != &other) {
+      clear();
+      if constexpr (NodeAllocatorTraits::
+                        propagate_on_container_move_assignment::value) {
+        m_allocator = std::move(other.m_allocator);
+      } else {
+        DITTO_VERIFY(m_allocator == other.m_allocator);
+      }
+      m_root = std::exchange(other.m_root, nullptr);
+    }
+    return *this;
+  }
+
+  BinarySearchTree(const BinarySearchTree&) = delete;
+  auto operator=(const BinarySearchTree&) -> BinarySearchTree& = delete;
+
+  ~BinarySearchTree() { clear(); }
+
+  [[nodiscard]] auto get_allocator() const -> allocator_type {
+    return allocator_type{m_allocator};
+  }
+
+  /**
+   * @brief Destroys all elements. If they are trivially destructible and the
+   * allocator can release all of its nodes at once, like a
+   * Ditto::SlabAllocator that is not shared, this is O(1).
+   */
+  void clear();
+
   void insert(const K& key, const V& value);
   auto lookup(const K& key) -> Ditto::optional<Ditto::NonNullPtr<V>>;
 
@@ -26,31 +164,106 @@ class BinarySearchTree {
   struct Node {
     K key;
     V value;
-    std::unique_ptr<Node> left;
-    std::unique_ptr<Node> right;
+    Node* left = nullptr;
+    Node* right = nullptr;
+    [[no_unique_address]] typename Balancing::NodeData balance;
 
     Node(const K& key, const V& value) : key(key), value(value) {}
   };
 
-  std::unique_ptr<Node> m_root;
+  // Links followed from the root to reach a node, so that the subtrees along
+  // the way can be rebalanced bottom-up. Only balanced trees record them,
+  // since their height is bounded.
+  class Path {
+   public:
+    void push(Node** link) {
+      if constexpr (Balancing::REBALANCES) {
+        DITTO_VERIFY(m_size < m_links.size());
+        m_links[m_size++] = link;
+      }
+    }
+
+    [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+    auto operator[](std::size_t index) -> Node**& { return m_links[index]; }
+
+    void rebalance() {
+      while (m_size > 0) {
+        Node** link = m_links[--m_size];
+        *link = Balancing::rebalance(*link);
+      }
+    }
+
+   private:
+    std::array<Node**, Balancing::MAX_HEIGHT> m_links;
+    std::size_t m_size = 0;
+  };
 
-  static void insert_node(Ditto::NonNullPtr<std::unique_ptr<Node>> root,
-                          std::unique_ptr<Node> new_node);
+  using NodeAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node>;
+  using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
+
+  [[no_unique_address]] NodeAllocator m_allocator;
+  Node* m_root = nullptr;
+
+  template <class... Args>
+  auto create_node(Args&&... args) -> Node* {
+    Node* node = NodeAllocatorTraits::allocate(m_allocator, 1);
+    NodeAllocatorTraits::construct(m_allocator, node,
+                                   std::forward<Args>(args)...);
+    return node;
+  }
+
+  void destroy_node(Node* node) {
+    NodeAllocatorTraits::destroy(m_allocator, node);
+    NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+  }
+
+  static void insert_node(Ditto::NonNullPtr<Node*> root, Node* new_node);
   static auto depth_from_node(Node* node, std::uint32_t current_depth)
       -> std::uint32_t;
 };
 
-template <class K, class V>
-inline void BinarySearchTree<K, V>::insert(const K& key, const V& value) {
-  Ditto::NonNullPtr<std::unique_ptr<Node>> node_double_ptr = &m_root;
+template <class K, class V, class Allocator, class Balancing>
+void BinarySearchTree<K, V, Allocator, Balancing>::clear() {
+  if constexpr (std::is_trivially_destructible_v<Node> &&
+                BulkDeallocatable<NodeAllocator>) {
+    if (m_allocator.deallocate_all()) {
+      m_root = nullptr;
+      return;
+    }
+  }
+
+  // Rotate left children up while freeing the nodes left without one, so that
+  // the whole tree is freed without recursion nor an auxiliary stack
+  Node* node = std::exchange(m_root, nullptr);
+  while (node != nullptr) {
+    if (node->left != nullptr) {
+      Node* left = node->left;
+      node->left = left->right;
+      left->right = node;
+      node = left;
+    } else {
+      Node* right = node->right;
+      destroy_node(node);
+      node = right;
+    }
+  }
+}
+
+template <class K, class V, class Allocator, class Balancing>
+inline void BinarySearchTree<K, V, Allocator, Balancing>::insert(
+    const K& key, const V& value) {
+  Ditto::NonNullPtr<Node*> node_double_ptr = &m_root;
+  Path path;
 
   while (*node_double_ptr) {
-    std::unique_ptr<Node>& node_ptr = *node_double_ptr;
+    Node*& node_ptr = *node_double_ptr;
     if (node_ptr->key == key) {
       node_ptr->value = value;
       return;
     }
 
+    path.push(&node_ptr);
     if (key < node_ptr->key) {
       node_double_ptr = &node_ptr->left;
     } else {
@@ -58,50 +271,78 @@ inline void BinarySearchTree<K, V>::insert(const K& key, const V& value) {
     }
   }
 
-  *node_double_ptr = std::make_unique<Node>(key, value);
+  *node_double_ptr = create_node(key, value);
+  path.rebalance();
 }
 
-template <class K, class V>
-inline auto BinarySearchTree<K, V>::lookup(const K& key)
-    -> Ditto::optional<Ditto::NonNullPtr<V>> {
-  Node* node = m_root.get();
+template <class K, class V, class Allocator, class Balancing>
+inline auto BinarySearchTree<K, V, Allocator, Balancing>::lookup(
+    const K& key) -> Ditto::optional<Ditto::NonNullPtr<V>> {
+  Node* node = m_root;
 
   while (node != nullptr) {
     if (node->key == key) {
       return Ditto::optional<Ditto::NonNullPtr<V>>{
           Ditto::NonNullPtr<V>{&node->value}};
     } else if (key < node->key) {
-      node = node->left.get();
+      node = node->left;
     } else {
-      node = node->right.get();
+      node = node->right;
     }
   }
   return {};
 }
 
-template <class K, class V>
-auto BinarySearchTree<K, V>::erase(const K& key) -> Ditto::optional<V> {
-  Ditto::NonNullPtr<std::unique_ptr<Node>> node_double_ptr = &m_root;
+template <class K, class V, class Allocator, class Balancing>
+auto BinarySearchTree<K, V, Allocator, Balancing>::erase(const K& key)
+    -> Ditto::optional<V> {
+  Ditto::NonNullPtr<Node*> node_double_ptr = &m_root;
+  Path path;
 
   while (*node_double_ptr != nullptr) {
-    std::unique_ptr<Node>& node_ptr = *node_double_ptr;
+    Node*& node_ptr = *node_double_ptr;
 
     if (node_ptr->key == key) {
-      std::unique_ptr<Node> removed_node = std::move(node_ptr);
+      Node* removed_node = node_ptr;
       if (removed_node->left == nullptr) {
-        node_ptr = std::move(removed_node->right);
+        node_ptr = removed_node->right;
       } else if (removed_node->right == nullptr) {
-        node_ptr = std::move(removed_node->left);
-      } else {
+        node_ptr = removed_node->left;
+      } else if constexpr (!Balancing::REBALANCES) {
         // They are both valid. In this case we take the left node as the new
         // parent and then insert the right node into the right subtree
         //
-        node_ptr = std::move(removed_node->left);
-        insert_node(&node_ptr, std::move(removed_node->right));
+        node_ptr = removed_node->left;
+        insert_node(&node_ptr, removed_node->right);
+      } else {
+        // Replace the node with its successor, the leftmost node of its right
+        // subtree, which keeps the height of the subtree
+        const std::size_t removed_index = path.size();
+        path.push(&node_ptr);
+        Node** successor_link = &removed_node->right;
+        while ((*successor_link)->left != nullptr) {
+          path.push(successor_link);
+          successor_link = &(*successor_link)->left;
+        }
+        Node* successor = *successor_link;
+        *successor_link = successor->right;
+        successor->left = removed_node->left;
+        successor->right = removed_node->right;
+        node_ptr = successor;
+        if (path.size() > removed_index + 1) {
+          // This link belonged to the removed node
+          path[removed_index + 1] = &successor->right;
+        }
       }
+      path.rebalance();
+
+      Ditto::optional<V> value{std::move(removed_node->value)};
+      destroy_node(removed_node);
+      return value;
+    }
 
-      return Ditto::optional<V>{std::move(removed_node->value)};
-    } else if (key < node_ptr->key) {
+    path.push(&node_ptr);
+    if (key < node_ptr->key) {
       node_double_ptr = &node_ptr->left;
     } else {
       node_double_ptr = &node_ptr->right;
@@ -111,14 +352,13 @@ auto BinarySearchTree<K, V>::erase(const K& key) -> Ditto::optional<V> {
   return {};
 }
 
-template <class K, class V>
-void BinarySearchTree<K, V>::insert_node(
-    Ditto::NonNullPtr<std::unique_ptr<Node>> root,
-    std::unique_ptr<Node> new_node) {
-  Ditto::NonNullPtr<std::unique_ptr<Node>> node_double_ptr = root;
+template <class K, class V, class Allocator, class Balancing>
+void BinarySearchTree<K, V, Allocator, Balancing>::insert_node(
+    Ditto::NonNullPtr<Node*> root, Node* new_node) {
+  Ditto::NonNullPtr<Node*> node_double_ptr = root;
 
   while (*node_double_ptr) {
-    std::unique_ptr<Node>& node_ptr = *node_double_ptr;
+    Node*& node_ptr = *node_double_ptr;
     if (new_node->key < node_ptr->key) {
       node_double_ptr = &node_ptr->left;
     } else {
@@ -126,39 +366,47 @@ void BinarySearchTree<K, V>::insert_node(
     }
   }
 
-  *node_double_ptr = std::move(new_node);
+  *node_double_ptr = new_node;
 }
 
-template <class K, class V>
-auto BinarySearchTree<K, V>::depth_from_node(Node* node, uint32_t current_depth)
-    -> std::uint32_t {
+template <class K, class V, class Allocator, class Balancing>
+auto BinarySearchTree<K, V, Allocator, Balancing>::depth_from_node(
+    Node* node, uint32_t current_depth) -> std::uint32_t {
   uint32_t depth = current_depth;
 
   if (node) {
     depth++;
 
     if (node->left && node->right) {
-      return std::max(depth_from_node(node->left.get(), depth),
-                      depth_from_node(node->right.get(), depth));
+      return std::max(depth_from_node(node->left, depth),
+                      depth_from_node(node->right, depth));
     }
 
     if (node->left) {
-      depth = depth_from_node(node->left.get(), depth);
+      depth = depth_from_node(node->left, depth);
     }
 
     if (node->right) {
-      depth = depth_from_node(node->right.get(), depth);
+      depth = depth_from_node(node->right, depth);
     }
   }
 
   return depth;
 }
 
-template <class K, class V>
-auto BinarySearchTree<K, V>::depth() const -> std::uint32_t {
-  return depth_from_node(m_root.get(), 0);
+template <class K, class V, class Allocator, class Balancing>
+auto BinarySearchTree<K, V, Allocator, Balancing>::depth() const
+    -> std::uint32_t {
+  return depth_from_node(m_root, 0);
 }
 
+/**
+ * @brief Binary search tree that keeps itself balanced as an AVL tree, so
+ * lookups, insertions and erasures are O(log N) whatever the order of the keys.
+ */
+template <class K, class V, class Allocator = std::allocator<Pair<K, V>>>
+using AvlTree = BinarySearchTree<K, V, Allocator, AvlBalancing>;
+
 }  // namespace Ditto
 
 #endif  // DITTO_BINARY_SEARCH_TREE_H_
@@ -0,0 +1,939 @@
+#ifndef DITTO_BPLUS_TREE_H_
+#define DITTO_BPLUS_TREE_H_
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+#include "ditto/non_null_ptr.h"
+#include "ditto/optional.h"
+#include "ditto/pair.h"
+#include "ditto/pool_allocator.h"
+#include "ditto/span.h"
+#include "ditto/thread_slot.h"
+
+namespace Ditto {
+
+/**
+ * @brief Ordered map implemented as a B+tree with nodes of about NODE_SIZE
+ * bytes.
+ *
+ * Each node holds as many keys as fit in NODE_SIZE bytes, so a lookup only
+ * takes one cache miss per level instead of one per key comparison, and the
+ * tree is a few levels deep even for millions of keys. Keys are searched
+ * inside a node by counting how many are smaller than the target, without
+ * branching on the comparisons, which the compiler vectorizes for arithmetic
+ * keys.
+ *
+ * Values only live in the leaves, which are linked in both directions so
+ * that iteration and range scans are sequential reads of whole nodes.
+ *
+ * K and V must be default constructible and movable, since nodes store them
+ * in arrays. Inserting or erasing an element may move other elements of the
+ * same node, so it invalidates iterators and references to them.
+ */
+template <class K, class V, std::size_t NODE_SIZE = 256,
+          class Allocator = std::allocator<Pair<K, V>>>
+class BPlusTree {
+  static_assert(std::is_default_constructible_v<K> &&
+                    std::is_default_constructible_v<V>,
+                "Keys and values must be default constructible");
+
+  struct Node {
+    // Number of keys in the node
+    std::size_t count = 0;
+  };
+
+  static constexpr std::size_t LEAF_CAPACITY = std::max<std::size_t>(
+      4, (NODE_SIZE - 3 * sizeof(void*)) / (sizeof(K) + sizeof(V)));
+  static constexpr std::size_t INNER_CAPACITY = std::max<std::size_t>(
+      4, (NODE_SIZE - 2 * sizeof(void*)) / (sizeof(K) + sizeof(void*)));
+  static constexpr std::size_t MIN_LEAF_COUNT = LEAF_CAPACITY / 2;
+  static constexpr std::size_t MIN_INNER_COUNT = INNER_CAPACITY / 2;
+
+  struct alignas(CACHE_LINE_SIZE) Leaf : Node {
+    Leaf* prev = nullptr;
+    Leaf* next = nullptr;
+    std::array<K, LEAF_CAPACITY> keys;
+    std::array<V, LEAF_CAPACITY> values;
+  };
+
+  // children[i] holds the keys in [keys[i - 1], keys[i])
+  struct alignas(CACHE_LINE_SIZE) Inner : Node {
+    std::array<K, INNER_CAPACITY> keys;
+    std::array<Node*, INNER_CAPACITY + 1> children;
+  };
+
+  // Leaves and inner nodes are allocated as the same type, so that a
+  // Ditto::SlabAllocator can serve both from a single arena
+  struct NodeStorage {
+    alignas(Leaf) alignas(Inner) std::byte
+        storage[std::max(sizeof(Leaf), sizeof(Inner))];
+  };
+
+  template <bool CONST>
+  struct EntryRef {
+    const K& key;
+    std::conditional_t<CONST, const V&, V&> value;
+  };
+
+  template <bool CONST>
+  class Iterator {
+    using Tree = std::conditional_t<CONST, const BPlusTree, BPlusTree>;
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = EntryRef<CONST>;
+    using reference = EntryRef<CONST>;
+    using pointer = void;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    Iterator() = default;
+
+    template <bool OTHER_CONST,
+              std::enable_if_t<CONST && !OTHER_CONST, bool> = false>
+    Iterator(const Iterator<OTHER_CONST>& other)
+        : m_tree(other.m_tree), m_leaf(other.m_leaf), m_index(other.m_index) {}
+
+    auto operator++() -> Iterator& {
+      m_index++;
+      if (m_index == m_leaf->count) {
+        m_leaf = m_leaf->next;
+        m_index = 0;
+      }
+      return *this;
+    }
+
+    auto operator++(int) -> Iterator {
+      Iterator current = *this;
+      ++*this;
+      return current;
+    }
+
+    auto operator--() -> Iterator& {
+      if (m_leaf == nullptr) {
+        // Decrementing end()
+        m_leaf = m_tree->last_leaf();
+        m_index = m_leaf->count - 1;
+      } else if (m_index == 0) {
+        m_leaf = m_leaf->prev;
+        m_index = m_leaf->count - 1;
+      } else {
+        m_index--;
+      }
+      return *this;
+    }
+
+    auto operator--(int) -> Iterator {
+      Iterator current = *this;
+      --*this;
+      return current;
+    }
+
+    [[nodiscard]] auto operator*() const -> reference {
+      return reference{m_leaf->keys[m_index], m_leaf->values[m_index]};
+    }
+
+    template <bool OTHER_CONST>
+    [[nodiscard]] auto operator==(const Iterator<OTHER_CONST>& other) const
+        -> bool {
+      return (m_leaf == other.m_leaf) && (m_index == other.m_index);
+    }
+
+   private:
+    Tree* m_tree = nullptr;
+    Leaf* m_leaf = nullptr;
+    std::size_t m_index = 0;
+
+    Iterator(Tree* tree, Leaf* leaf, std::size_t index)
+        : m_tree(tree), m_leaf(leaf), m_index(index) {}
+
+    template <bool>
+    friend class Iterator;
+
+    friend BPlusTree;
+  };
+
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+
+  BPlusTree() = default;
+  explicit BPlusTree(const Allocator& allocator) : m_allocator(allocator) {}
+
+  /**
+   * @brief Builds the tree from entries sorted by strictly increasing keys in
+   * O(N), without comparing nor rebalancing. Nodes are filled as much as
+   * possible, so the tree is as shallow as it can be.
+   */
+  explicit BPlusTree(Ditto::span<const Pair<K, V>> sorted_entries,
+                     const Allocator& allocator = Allocator());
+
+  BPlusTree(BPlusTree&& other) noexcept
+      : m_allocator(std::move(other.m_allocator)),
+        m_root(std::exchange(other.m_root, nullptr)),
+        m_height(std::exchange(other.m_height, 0)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  auto operator=(BPlusTree&& other) noexcept -> BPlusTree& {
+    if (this != &other) {
+      clear();
+      if constexpr (NodeAllocatorTraits::
+                        propagate_on_container_move_assignment::value) {
+        m_allocator = std::move(other.m_allocator);
+      } else {
+        DITTO_VERIFY(m_allocator == other.m_allocator);
+      }
+      m_root = std::exchange(other.m_root, nullptr);
+      m_height = std::exchange(other.m_height, 0);
+      m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+  }
+
+  BPlusTree(const BPlusTree&) = delete;
+  auto operator=(const BPlusTree&) -> BPlusTree& = delete;
+
+  ~BPlusTree() { clear(); }
+
+  [[nodiscard]] auto get_allocator() const -> allocator_type {
+    return allocator_type{m_allocator};
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> size_type { return m_size; }
+
+  /**
+   * @brief Number of levels of the tree, including the leaves.
+   */
+  [[nodiscard]] auto depth() const -> std::uint32_t {
+    return (m_root != nullptr) ? static_cast<std::uint32_t>(m_height + 1) : 0;
+  }
+
+  /**
+   * @brief Destroys all elements. If they are trivially destructible and the
+   * allocator can release all of its nodes at once, like a
+   * Ditto::SlabAllocator that is not shared, this is O(1).
+   */
+  void clear();
+
+  void insert(const K& key, const V& value);
+  auto lookup(const K& key) -> Ditto::optional<Ditto::NonNullPtr<V>>;
+  auto erase(const K& key) -> Ditto::optional<V>;
+
+  [[nodiscard]] auto begin() -> iterator {
+    return iterator{this, first_leaf(), 0};
+  }
+  [[nodiscard]] auto end() -> iterator { return iterator{this, nullptr, 0}; }
+  [[nodiscard]] auto begin() const -> const_iterator {
+    return const_iterator{this, first_leaf(), 0};
+  }
+  [[nodiscard]] auto end() const -> const_iterator {
+    return const_iterator{this, nullptr, 0};
+  }
+  [[nodiscard]] auto cbegin() const -> const_iterator { return begin(); }
+  [[nodiscard]] auto cend() const -> const_iterator { return end(); }
+
+  /**
+   * @brief Returns an iterator to the first element whose key is not less than
+   * the given key.
+   */
+  [[nodiscard]] auto lower_bound(const K& key) -> iterator {
+    auto [leaf, index] = lower_bound_position(key);
+    return iterator{this, leaf, index};
+  }
+  [[nodiscard]] auto lower_bound(const K& key) const -> const_iterator {
+    auto [leaf, index] = lower_bound_position(key);
+    return const_iterator{this, leaf, index};
+  }
+
+  /**
+   * @brief Returns an iterator to the first element whose key is greater than
+   * the given key.
+   */
+  [[nodiscard]] auto upper_bound(const K& key) -> iterator {
+    auto [leaf, index] = upper_bound_position(key);
+    return iterator{this, leaf, index};
+  }
+  [[nodiscard]] auto upper_bound(const K& key) const -> const_iterator {
+    auto [leaf, index] = upper_bound_position(key);
+    return const_iterator{this, leaf, index};
+  }
+
+  /**
+   * @brief Calls action(key, value) in order for every element whose key is
+   * in the range [first, last).
+   */
+  template <std::invocable<const K&, V&> Action>
+  void for_each_in_range(const K& first, const K& last, Action action) {
+    scan_range(this, first, last, action);
+  }
+  template <std::invocable<const K&, const V&> Action>
+  void for_each_in_range(const K& first, const K& last, Action action) const {
+    scan_range(this, first, last, action);
+  }
+
+ private:
+  // Result of inserting into a node that had to be split
+  struct Split {
+    K separator{};
+    Node* right = nullptr;
+  };
+
+  // State of a bulk load, shared by the recursive calls of build_sorted()
+  struct SortedBuild {
+    const Pair<K, V>* entries = nullptr;
+    std::size_t num_entries = 0;
+    std::size_t next_entry = 0;
+    Leaf* last_leaf = nullptr;
+    // Number of nodes of each level, from the leaves up. Every level has at
+    // most half the nodes of the one below, so this is always enough
+    std::array<std::size_t, std::numeric_limits<std::size_t>::digits>
+        level_sizes{};
+  };
+
+  using NodeAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<NodeStorage>;
+  using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
+
+  [[no_unique_address]] NodeAllocator m_allocator;
+  Node* m_root = nullptr;
+  // Number of levels of inner nodes above the leaves
+  std::size_t m_height = 0;
+  size_type m_size = 0;
+
+  // Number of keys less than key. Comparisons are accumulated instead of
+  // branched on, which lets the compiler vectorize the loop
+  static auto count_less(const K* keys, std::size_t count, const K& key)
+      -> std::size_t {
+    if constexpr (std::is_arithmetic_v<K>) {
+      std::size_t index = 0;
+      for (std::size_t i = 0; i < count; i++) {
+        index += static_cast<std::size_t>(keys[i] < key);
+      }
+      return index;
+    } else {
+      return static_cast<std::size_t>(
+          std::lower_bound(keys, keys + count, key) - keys);
+    }
+  }
+
+  // Number of keys less than or equal to key
+  static auto count_not_greater(const K* keys, std::size_t count,
+                                const K& key) -> std::size_t {
+    if constexpr (std::is_arithmetic_v<K>) {
+      std::size_t index = 0;
+      for (std::size_t i = 0; i < count; i++) {
+        index += static_cast<std::size_t>(!(key < keys[i]));
+      }
+      return index;
+    } else {
+      return static_cast<std::size_t>(
+          std::upper_bound(keys, keys + count, key) - keys);
+    }
+  }
+
+  static auto as_leaf(Node* node) -> Leaf* { return static_cast<Leaf*>(node); }
+  static auto as_inner(Node* node) -> Inner* {
+    return static_cast<Inner*>(node);
+  }
+
+  auto create_leaf() -> Leaf* {
+    NodeStorage* storage = NodeAllocatorTraits::allocate(m_allocator, 1);
+    // Default-initialized, so that the key and value arrays are not zeroed
+    return new (storage) Leaf;
+  }
+
+  auto create_inner() -> Inner* {
+    NodeStorage* storage = NodeAllocatorTraits::allocate(m_allocator, 1);
+    return new (storage) Inner;
+  }
+
+  template <class N>
+  void destroy_node(N* node) {
+    std::destroy_at(node);
+    NodeAllocatorTraits::deallocate(
+        m_allocator, reinterpret_cast<NodeStorage*>(node), 1);
+  }
+
+  void destroy_subtree(Node* node, std::size_t level);
+
+  // Number of items that node index gets when num_items are spread evenly
+  // over num_nodes nodes, and index of the first of them
+  static auto share_size(std::size_t num_items, std::size_t num_nodes,
+                         std::size_t index) -> std::size_t {
+    return num_items / num_nodes + ((index < num_items % num_nodes) ? 1 : 0);
+  }
+  static auto share_start(std::size_t num_items, std::size_t num_nodes,
+                          std::size_t index) -> std::size_t {
+    return index * (num_items / num_nodes) +
+           std::min(index, num_items % num_nodes);
+  }
+
+  static auto first_key(Node* node, std::size_t level) -> const K& {
+    for (; level > 0; level--) {
+      node = as_inner(node)->children[0];
+    }
+    return as_leaf(node)->keys[0];
+  }
+
+  auto build_sorted(SortedBuild& build, std::size_t level, std::size_t index)
+      -> Node*;
+
+  [[nodiscard]] auto find_leaf(const K& key) const -> Leaf*;
+  [[nodiscard]] auto first_leaf() const -> Leaf*;
+  [[nodiscard]] auto last_leaf() const -> Leaf*;
+  [[nodiscard]] auto lower_bound_position(const K& key) const
+      -> std::pair<Leaf*, std::size_t>;
+  [[nodiscard]] auto upper_bound_position(const K& key) const
+      -> std::pair<Leaf*, std::size_t>;
+
+  template <class Tree, class Action>
+  static void scan_range(Tree* tree, const K& first, const K& last,
+                         Action& action);
+
+  auto insert_into(Node* node, std::size_t level, const K& key,
+                   const V& value) -> Split;
+  auto insert_into_leaf(Leaf* leaf, const K& key, const V& value) -> Split;
+  auto insert_child(Inner* inner, std::size_t index, const Split& split)
+      -> Split;
+
+  auto erase_from(Node* node, std::size_t level, const K& key)
+      -> Ditto::optional<V>;
+  void rebalance_leaf(Inner* parent, std::size_t index);
+  void rebalance_inner(Inner* parent, std::size_t index);
+  void remove_child(Inner* parent, std::size_t index);
+};
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+BPlusTree<K, V, NODE_SIZE, Allocator>::BPlusTree(
+    Ditto::span<const Pair<K, V>> sorted_entries, const Allocator& allocator)
+    : m_allocator(allocator) {
+  const std::size_t num_entries = sorted_entries.size();
+  if (num_entries == 0) {
+    return;
+  }
+
+  // Spread the entries evenly over the minimum number of leaves, so that all
+  // of them are at least half full, and the nodes of every level the same
+  // way over the level above, until a single root is left
+  SortedBuild build{sorted_entries.data(), num_entries};
+  build.level_sizes[0] = (num_entries + LEAF_CAPACITY - 1) / LEAF_CAPACITY;
+  while (build.level_sizes[m_height] > 1) {
+    build.level_sizes[m_height + 1] =
+        (build.level_sizes[m_height] + INNER_CAPACITY) / (INNER_CAPACITY + 1);
+    m_height++;
+  }
+  m_root = build_sorted(build, m_height, 0);
+  m_size = num_entries;
+}
+
+// Builds the subtrees in order, so the leaves are filled and linked from the
+// first entry to the last. Recursion is bounded by the height of the tree.
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::build_sorted(SortedBuild& build,
+                                                         std::size_t level,
+                                                         std::size_t index)
+    -> Node* {
+  if (level == 0) {
+    Leaf* leaf = create_leaf();
+    leaf->count = share_size(build.num_entries, build.level_sizes[0], index);
+    const Pair<K, V>* entries = build.entries;
+    for (std::size_t j = 0; j < leaf->count; j++) {
+      const std::size_t entry = build.next_entry++;
+      DITTO_VERIFY((entry == 0) ||
+                   (entries[entry - 1].left() < entries[entry].left()));
+      leaf->keys[j] = entries[entry].left();
+      leaf->values[j] = entries[entry].right();
+    }
+    leaf->prev = build.last_leaf;
+    if (build.last_leaf != nullptr) {
+      build.last_leaf->next = leaf;
+    }
+    build.last_leaf = leaf;
+    return leaf;
+  }
+
+  const std::size_t num_children = build.level_sizes[level - 1];
+  const std::size_t num_nodes = build.level_sizes[level];
+  const std::size_t first_child = share_start(num_children, num_nodes, index);
+  const std::size_t node_children = share_size(num_children, num_nodes, index);
+
+  Inner* inner = create_inner();
+  for (std::size_t j = 0; j < node_children; j++) {
+    Node* child = build_sorted(build, level - 1, first_child + j);
+    inner->children[j] = child;
+    if (j > 0) {
+      inner->keys[j - 1] = first_key(child, level - 1);
+    }
+  }
+  inner->count = node_children - 1;
+  return inner;
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::clear() {
+  if (m_root == nullptr) {
+    return;
+  }
+
+  bool released = false;
+  if constexpr (std::is_trivially_destructible_v<K> &&
+                std::is_trivially_destructible_v<V> &&
+                BulkDeallocatable<NodeAllocator>) {
+    released = m_allocator.deallocate_all();
+  }
+  if (!released) {
+    destroy_subtree(m_root, m_height);
+  }
+  m_root = nullptr;
+  m_height = 0;
+  m_size = 0;
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::destroy_subtree(
+    Node* node, std::size_t level) {
+  if (level == 0) {
+    destroy_node(as_leaf(node));
+    return;
+  }
+
+  // Recursion is bounded by the height of the tree, which is logarithmic
+  Inner* inner = as_inner(node);
+  for (std::size_t i = 0; i <= inner->count; i++) {
+    destroy_subtree(inner->children[i], level - 1);
+  }
+  destroy_node(inner);
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::find_leaf(const K& key) const
+    -> Leaf* {
+  Node* node = m_root;
+  for (std::size_t level = m_height; level > 0; level--) {
+    Inner* inner = as_inner(node);
+    node = inner->children[count_not_greater(inner->keys.data(),
+                                             inner->count, key)];
+  }
+  return as_leaf(node);
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::first_leaf() const -> Leaf* {
+  Node* node = m_root;
+  if (node == nullptr) {
+    return nullptr;
+  }
+  for (std::size_t level = m_height; level > 0; level--) {
+    node = as_inner(node)->children[0];
+  }
+  return as_leaf(node);
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::last_leaf() const -> Leaf* {
+  Node* node = m_root;
+  for (std::size_t level = m_height; level > 0; level--) {
+    Inner* inner = as_inner(node);
+    node = inner->children[inner->count];
+  }
+  return as_leaf(node);
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::lower_bound_position(
+    const K& key) const -> std::pair<Leaf*, std::size_t> {
+  if (m_root == nullptr) {
+    return {nullptr, 0};
+  }
+  Leaf* leaf = find_leaf(key);
+  const std::size_t index = count_less(leaf->keys.data(), leaf->count, key);
+  if (index == leaf->count) {
+    // All keys of the leaf are smaller, the bound is the first of the next
+    return {leaf->next, 0};
+  }
+  return {leaf, index};
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::upper_bound_position(
+    const K& key) const -> std::pair<Leaf*, std::size_t> {
+  if (m_root == nullptr) {
+    return {nullptr, 0};
+  }
+  Leaf* leaf = find_leaf(key);
+  const std::size_t index =
+      count_not_greater(leaf->keys.data(), leaf->count, key);
+  if (index == leaf->count) {
+    return {leaf->next, 0};
+  }
+  return {leaf, index};
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+template <class Tree, class Action>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::scan_range(Tree* tree,
+                                                       const K& first,
+                                                       const K& last,
+                                                       Action& action) {
+  auto [leaf, index] = tree->lower_bound_position(first);
+  for (; leaf != nullptr; leaf = leaf->next, index = 0) {
+    for (; index < leaf->count; index++) {
+      if (!(leaf->keys[index] < last)) {
+        return;
+      }
+      action(std::as_const(leaf->keys[index]), leaf->values[index]);
+    }
+  }
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::lookup(const K& key)
+    -> Ditto::optional<Ditto::NonNullPtr<V>> {
+  if (m_root == nullptr) {
+    return {};
+  }
+  Leaf* leaf = find_leaf(key);
+  const std::size_t index = count_less(leaf->keys.data(), leaf->count, key);
+  if ((index == leaf->count) || (key < leaf->keys[index])) {
+    return {};
+  }
+  return Ditto::optional<Ditto::NonNullPtr<V>>{
+      Ditto::NonNullPtr<V>{&leaf->values[index]}};
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::insert(const K& key,
+                                                   const V& value) {
+  if (m_root == nullptr) {
+    m_root = create_leaf();
+  }
+
+  Split split = insert_into(m_root, m_height, key, value);
+  if (split.right != nullptr) {
+    // The root was split, grow the tree by one level
+    Inner* root = create_inner();
+    root->count = 1;
+    root->keys[0] = std::move(split.separator);
+    root->children[0] = m_root;
+    root->children[1] = split.right;
+    m_root = root;
+    m_height++;
+  }
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::insert_into(Node* node,
+                                                        std::size_t level,
+                                                        const K& key,
+                                                        const V& value)
+    -> Split {
+  if (level == 0) {
+    return insert_into_leaf(as_leaf(node), key, value);
+  }
+
+  Inner* inner = as_inner(node);
+  const std::size_t index =
+      count_not_greater(inner->keys.data(), inner->count, key);
+  Split split = insert_into(inner->children[index], level - 1, key, value);
+  if (split.right == nullptr) {
+    return {};
+  }
+  return insert_child(inner, index, split);
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::insert_into_leaf(Leaf* leaf,
+                                                             const K& key,
+                                                             const V& value)
+    -> Split {
+  std::size_t index = count_less(leaf->keys.data(), leaf->count, key);
+  if ((index < leaf->count) && !(key < leaf->keys[index])) {
+    leaf->values[index] = value;
+    return {};
+  }
+  m_size++;
+
+  Split split;
+  if (leaf->count == LEAF_CAPACITY) {
+    // Move the upper half to a new leaf, then insert into the half where the
+    // key belongs. Both halves end up at least half full
+    Leaf* right = create_leaf();
+    const std::size_t left_count = LEAF_CAPACITY - LEAF_CAPACITY / 2;
+    right->count = LEAF_CAPACITY - left_count;
+    std::move(leaf->keys.begin() + left_count, leaf->keys.end(),
+              right->keys.begin());
+    std::move(leaf->values.begin() + left_count, leaf->values.end(),
+              right->values.begin());
+    leaf->count = left_count;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next != nullptr) {
+      leaf->next->prev = right;
+    }
+    leaf->next = right;
+
+    if (index > left_count) {
+      index -= left_count;
+      leaf = right;
+    }
+    split.right = right;
+  }
+
+  auto keys = leaf->keys.begin();
+  auto values = leaf->values.begin();
+  std::move_backward(keys + index, keys + leaf->count, keys + leaf->count + 1);
+  std::move_backward(values + index, values + leaf->count,
+                     values + leaf->count + 1);
+  leaf->keys[index] = key;
+  leaf->values[index] = value;
+  leaf->count++;
+
+  if (split.right != nullptr) {
+    split.separator = as_leaf(split.right)->keys[0];
+  }
+  return split;
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::insert_child(Inner* inner,
+                                                         std::size_t index,
+                                                         const Split& split)
+    -> Split {
+  if (inner->count < INNER_CAPACITY) {
+    auto keys = inner->keys.begin();
+    auto children = inner->children.begin();
+    std::move_backward(keys + index, keys + inner->count,
+                       keys + inner->count + 1);
+    std::move_backward(children + index + 1, children + inner->count + 1,
+                       children + inner->count + 2);
+    inner->keys[index] = split.separator;
+    inner->children[index + 1] = split.right;
+    inner->count++;
+    return {};
+  }
+
+  // Lay out all keys and children in order, then push the middle key up and
+  // split the rest evenly
+  std::array<K, INNER_CAPACITY + 1> keys;
+  std::array<Node*, INNER_CAPACITY + 2> children;
+  std::move(inner->keys.begin(), inner->keys.begin() + index, keys.begin());
+  keys[index] = split.separator;
+  std::move(inner->keys.begin() + index, inner->keys.end(),
+            keys.begin() + index + 1);
+  std::copy(inner->children.begin(), inner->children.begin() + index + 1,
+            children.begin());
+  children[index + 1] = split.right;
+  std::copy(inner->children.begin() + index + 1, inner->children.end(),
+            children.begin() + index + 2);
+
+  constexpr std::size_t LEFT_COUNT = INNER_CAPACITY / 2;
+  Inner* right = create_inner();
+  inner->count = LEFT_COUNT;
+  right->count = INNER_CAPACITY - LEFT_COUNT;
+  std::move(keys.begin(), keys.begin() + LEFT_COUNT, inner->keys.begin());
+  std::copy(children.begin(), children.begin() + LEFT_COUNT + 1,
+            inner->children.begin());
+  std::move(keys.begin() + LEFT_COUNT + 1, keys.end(), right->keys.begin());
+  std::copy(children.begin() + LEFT_COUNT + 1, children.end(),
+            right->children.begin());
+
+  return Split{std::move(keys[LEFT_COUNT]), right};
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::erase(const K& key)
+    -> Ditto::optional<V> {
+  if (m_root == nullptr) {
+    return {};
+  }
+
+  Ditto::optional<V> value = erase_from(m_root, m_height, key);
+  if (m_height > 0) {
+    Inner* root = as_inner(m_root);
+    if (root->count == 0) {
+      // The root was left with a single child, shrink the tree by one level
+      m_root = root->children[0];
+      m_height--;
+      destroy_node(root);
+    }
+  } else if (m_root->count == 0) {
+    destroy_node(as_leaf(m_root));
+    m_root = nullptr;
+  }
+  return value;
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+auto BPlusTree<K, V, NODE_SIZE, Allocator>::erase_from(Node* node,
+                                                       std::size_t level,
+                                                       const K& key)
+    -> Ditto::optional<V> {
+  if (level == 0) {
+    Leaf* leaf = as_leaf(node);
+    const std::size_t index = count_less(leaf->keys.data(), leaf->count, key);
+    if ((index == leaf->count) || (key < leaf->keys[index])) {
+      return {};
+    }
+
+    Ditto::optional<V> value{std::move(leaf->values[index])};
+    std::move(leaf->keys.begin() + index + 1,
+              leaf->keys.begin() + leaf->count, leaf->keys.begin() + index);
+    std::move(leaf->values.begin() + index + 1,
+              leaf->values.begin() + leaf->count,
+              leaf->values.begin() + index);
+    leaf->count--;
+    m_size--;
+    return value;
+  }
+
+  // Separators are left as they are even if they match the erased key, since
+  // they still route lookups correctly
+  Inner* inner = as_inner(node);
+  const std::size_t index =
+      count_not_greater(inner->keys.data(), inner->count, key);
+  Node* child = inner->children[index];
+  Ditto::optional<V> value = erase_from(child, level - 1, key);
+  if (level == 1) {
+    if (child->count < MIN_LEAF_COUNT) {
+      rebalance_leaf(inner, index);
+    }
+  } else if (child->count < MIN_INNER_COUNT) {
+    rebalance_inner(inner, index);
+  }
+  return value;
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::rebalance_leaf(Inner* parent,
+                                                           std::size_t index) {
+  Leaf* leaf = as_leaf(parent->children[index]);
+  Leaf* left = (index > 0) ? as_leaf(parent->children[index - 1]) : nullptr;
+  Leaf* right =
+      (index < parent->count) ? as_leaf(parent->children[index + 1]) : nullptr;
+
+  if ((left != nullptr) && (left->count > MIN_LEAF_COUNT)) {
+    // Borrow the last element of the left sibling
+    std::move_backward(leaf->keys.begin(), leaf->keys.begin() + leaf->count,
+                       leaf->keys.begin() + leaf->count + 1);
+    std::move_backward(leaf->values.begin(),
+                       leaf->values.begin() + leaf->count,
+                       leaf->values.begin() + leaf->count + 1);
+    left->count--;
+    leaf->keys[0] = std::move(left->keys[left->count]);
+    leaf->values[0] = std::move(left->values[left->count]);
+    leaf->count++;
+    parent->keys[index - 1] = leaf->keys[0];
+  } else if ((right != nullptr) && (right->count > MIN_LEAF_COUNT)) {
+    // Borrow the first element of the right sibling
+    leaf->keys[leaf->count] = std::move(right->keys[0]);
+    leaf->values[leaf->count] = std::move(right->values[0]);
+    leaf->count++;
+    std::move(right->keys.begin() + 1, right->keys.begin() + right->count,
+              right->keys.begin());
+    std::move(right->values.begin() + 1,
+              right->values.begin() + right->count, right->values.begin());
+    right->count--;
+    parent->keys[index] = right->keys[0];
+  } else {
+    // Merge with a sibling, which fits since both are at most half full
+    if (left == nullptr) {
+      left = leaf;
+      index++;
+    }
+    Leaf* merged = as_leaf(parent->children[index]);
+    std::move(merged->keys.begin(), merged->keys.begin() + merged->count,
+              left->keys.begin() + left->count);
+    std::move(merged->values.begin(), merged->values.begin() + merged->count,
+              left->values.begin() + left->count);
+    left->count += merged->count;
+
+    left->next = merged->next;
+    if (merged->next != nullptr) {
+      merged->next->prev = left;
+    }
+    remove_child(parent, index);
+    destroy_node(merged);
+  }
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::rebalance_inner(
+    Inner* parent, std::size_t index) {
+  Inner* inner = as_inner(parent->children[index]);
+  Inner* left = (index > 0) ? as_inner(parent->children[index - 1]) : nullptr;
+  Inner* right =
+      (index < parent->count) ? as_inner(parent->children[index + 1]) : nullptr;
+
+  if ((left != nullptr) && (left->count > MIN_INNER_COUNT)) {
+    // Rotate the last child of the left sibling through the parent
+    std::move_backward(inner->keys.begin(),
+                       inner->keys.begin() + inner->count,
+                       inner->keys.begin() + inner->count + 1);
+    std::move_backward(inner->children.begin(),
+                       inner->children.begin() + inner->count + 1,
+                       inner->children.begin() + inner->count + 2);
+    inner->keys[0] = std::move(parent->keys[index - 1]);
+    inner->children[0] = left->children[left->count];
+    inner->count++;
+    parent->keys[index - 1] = std::move(left->keys[left->count - 1]);
+    left->count--;
+  } else if ((right != nullptr) && (right->count > MIN_INNER_COUNT)) {
+    // Rotate the first child of the right sibling through the parent
+    inner->keys[inner->count] = std::move(parent->keys[index]);
+    inner->children[inner->count + 1] = right->children[0];
+    inner->count++;
+    parent->keys[index] = std::move(right->keys[0]);
+    std::move(right->keys.begin() + 1, right->keys.begin() + right->count,
+              right->keys.begin());
+    std::move(right->children.begin() + 1,
+              right->children.begin() + right->count + 1,
+              right->children.begin());
+    right->count--;
+  } else {
+    // Merge with a sibling, pulling down the separator between them
+    if (left == nullptr) {
+      left = inner;
+      index++;
+    }
+    Inner* merged = as_inner(parent->children[index]);
+    left->keys[left->count] = std::move(parent->keys[index - 1]);
+    std::move(merged->keys.begin(), merged->keys.begin() + merged->count,
+              left->keys.begin() + left->count + 1);
+    std::copy(merged->children.begin(),
+              merged->children.begin() + merged->count + 1,
+              left->children.begin() + left->count + 1);
+    left->count += merged->count + 1;
+    remove_child(parent, index);
+    destroy_node(merged);
+  }
+}
+
+template <class K, class V, std::size_t NODE_SIZE, class Allocator>
+void BPlusTree<K, V, NODE_SIZE, Allocator>::remove_child(Inner* parent,
+                                                         std::size_t index) {
+  // Removes children[index] along with the separator on its left
+  std::move(parent->keys.begin() + index, parent->keys.begin() + parent->count,
+            parent->keys.begin() + index - 1);
+  std::move(parent->children.begin() + index + 1,
+            parent->children.begin() + parent->count + 1,
+            parent->children.begin() + index);
+  parent->count--;
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_BPLUS_TREE_H_
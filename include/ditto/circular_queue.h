@@ -86,6 +86,23 @@ class CircularQueue {
     return nullptr;
   }
 
+  /**
+   * @brief Returns a pointer to the first element in the queue (in FIFO order)
+   * for which the predicate returns true.
+   * @retval The pointer if such an element exists. nullptr otherwise.
+   */
+  template <class Predicate>
+  [[nodiscard]] auto find_if(Predicate predicate) & -> T* {
+    CircularIndex index = m_read;
+    for (std::size_t i = 0; i < size(); i++) {
+      auto* ptr = reinterpret_cast<T*>(&m_element_storage[index++]);
+      if (predicate(static_cast<const T&>(*ptr))) {
+        return ptr;
+      }
+    }
+    return nullptr;
+  }
+
   /**
    * @brief Takes the next element from the queue and returns it.
    * @retval A T wrapped in an std::optional. It will be valid if there are
@@ -118,6 +135,19 @@ class CircularQueue {
   }
   [[nodiscard]] auto full() const -> bool { return m_full; }
 
+  /**
+   * @brief Returns the number of elements currently in the queue.
+   */
+  [[nodiscard]] auto size() const -> std::size_t {
+    if (m_full) {
+      return SIZE;
+    }
+    if (m_write >= m_read) {
+      return m_write - m_read;
+    }
+    return SIZE - m_read + m_write;
+  }
+
  private:
   class CircularIndex {
    public:
@@ -0,0 +1,486 @@
+#ifndef DITTO_CONCURRENT_SKIP_LIST_H_
+#define DITTO_CONCURRENT_SKIP_LIST_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+#include "ditto/adaptive_mutex.h"
+#include "ditto/epoch.h"
+#include "ditto/optional.h"
+#include "ditto/thread_slot.h"
+
+namespace Ditto {
+
+/**
+ * @brief Ordered map that can be read and modified from several threads at
+ * once, implemented as a lazy skip list.
+ *
+ * Lookups and range scans never lock nor wait: they walk the list inside a
+ * read-side critical section of an EpochDomain. Insertions and erasures only
+ * lock the nodes that precede the modified one at each of its levels, using
+ * Mutex, so modifications of different parts of the list run in parallel.
+ * Erased nodes are reclaimed in batches of RECLAIM_BATCH_SIZE once a grace
+ * period guarantees that no reader can still reach them, so the thread that
+ * fills a batch blocks for that grace period.
+ *
+ * Values are never modified once inserted, which is what allows reading them
+ * without locks: insert() does not overwrite existing keys, and updating a
+ * value means erasing and inserting it again. Lookups return copies.
+ *
+ * Range scans are weakly consistent: they visit keys in increasing order and
+ * at most once, every element that is present during the whole scan is
+ * visited, and elements inserted or erased during the scan may or may not be.
+ */
+template <class K, class V, std::uint32_t MAX_LEVEL = 32,
+          class Mutex = AdaptiveMutex<>, std::size_t NUM_READER_SLOTS = 32>
+class ConcurrentSkipList {
+  static_assert((MAX_LEVEL > 0) && (MAX_LEVEL <= 32),
+                "The number of levels must be in [1, 32]");
+
+ public:
+  static constexpr std::size_t RECLAIM_BATCH_SIZE = 64;
+
+  ConcurrentSkipList() : m_head(create_node<Node>(MAX_LEVEL)) {}
+
+  ConcurrentSkipList(const ConcurrentSkipList&) = delete;
+  ConcurrentSkipList(ConcurrentSkipList&&) = delete;
+  auto operator=(const ConcurrentSkipList&) -> ConcurrentSkipList& = delete;
+  auto operator=(ConcurrentSkipList&&) -> ConcurrentSkipList& = delete;
+
+  ~ConcurrentSkipList();
+
+  /**
+   * @brief Returns the number of elements. It is only exact while no other
+   * thread modifies the list.
+   */
+  [[nodiscard]] auto size() const -> std::size_t {
+    return m_size.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+
+  /**
+   * @brief Inserts the key if it is not in the list yet. Returns whether it
+   * was inserted.
+   */
+  auto insert(const K& key, const V& value) -> bool;
+
+  /**
+   * @brief Erases the key and returns its value, if it was in the list. Must
+   * not be called from within a for_each_in_range() action, since it may wait
+   * for a grace period.
+   */
+  auto erase(const K& key) -> Ditto::optional<V>;
+
+  [[nodiscard]] auto lookup(const K& key) const -> Ditto::optional<V>;
+  [[nodiscard]] auto contains(const K& key) const -> bool;
+
+  /**
+   * @brief Calls action(key, value) in order for every element whose key is
+   * in the range [first, last).
+   */
+  template <std::invocable<const K&, const V&> Action>
+  void for_each_in_range(const K& first, const K& last, Action action) const;
+
+ private:
+  struct Node {
+    Node(std::uint32_t height, std::atomic<Node*>* links)
+        : height(height), links(links) {}
+
+    const std::uint32_t height;
+    std::atomic<Node*>* const links;
+    // Set once the node is being erased, after which it is never relinked
+    std::atomic<bool> marked{false};
+    // Set once the node is reachable at all its levels
+    std::atomic<bool> fully_linked{false};
+    Mutex mutex;
+    Node* next_retired = nullptr;
+
+    auto next(std::uint32_t level) -> std::atomic<Node*>& {
+      return links[level];
+    }
+  };
+
+  struct Entry : Node {
+    Entry(std::uint32_t height, std::atomic<Node*>* links, const K& key,
+          const V& value)
+        : Node(height, links), key(key), value(value) {}
+
+    const K key;
+    const V value;
+  };
+
+  using Levels = std::array<Node*, MAX_LEVEL>;
+
+  // Locks the predecessors of the lowest levels of a node, bottom-up so that
+  // all threads take the locks in the same order. A node that precedes
+  // several levels is only locked once.
+  class PredecessorLocks {
+   public:
+    explicit PredecessorLocks(const Levels& preds) : m_preds(preds) {}
+
+    PredecessorLocks(const PredecessorLocks&) = delete;
+    auto operator=(const PredecessorLocks&) -> PredecessorLocks& = delete;
+
+    ~PredecessorLocks() {
+      for (std::uint32_t level = 0; level < m_num_locked; level++) {
+        if (is_first_of_node(level)) {
+          m_preds[level]->mutex.unlock();
+        }
+      }
+    }
+
+    void lock(std::uint32_t level) {
+      if (is_first_of_node(level)) {
+        m_preds[level]->mutex.lock();
+      }
+      m_num_locked = level + 1;
+    }
+
+   private:
+    const Levels& m_preds;
+    std::uint32_t m_num_locked = 0;
+
+    [[nodiscard]] auto is_first_of_node(std::uint32_t level) const -> bool {
+      return (level == 0) || (m_preds[level] != m_preds[level - 1]);
+    }
+  };
+
+  // The head has no key, it precedes every element at all levels
+  Node* const m_head;
+  std::atomic<std::size_t> m_size{0};
+  mutable EpochDomain<NUM_READER_SLOTS> m_domain;
+
+  std::mutex m_retired_mutex;
+  Node* m_retired = nullptr;
+  std::size_t m_num_retired = 0;
+
+  static auto key_of(Node* node) -> const K& {
+    return static_cast<Entry*>(node)->key;
+  }
+
+  static auto is_live(Node* node) -> bool {
+    return node->fully_linked.load(std::memory_order_acquire) &&
+           !node->marked.load(std::memory_order_acquire);
+  }
+
+  // Nodes are allocated together with the links of their levels
+  template <class N, class... Args>
+  static auto create_node(std::uint32_t height, Args&&... args) -> N*;
+  template <class N>
+  static void destroy_node(N* node);
+
+  static auto random_height() -> std::uint32_t;
+
+  auto find(const K& key, Levels& preds, Levels& succs) const -> int;
+  [[nodiscard]] auto lower_bound_node(const K& key) const -> Node*;
+  void retire(Node* node);
+};
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+ConcurrentSkipList<K, V, MAX_LEVEL, Mutex,
+                   NUM_READER_SLOTS>::~ConcurrentSkipList() {
+  // No other thread can be using the list anymore
+  Node* node = m_head->next(0).load(std::memory_order_relaxed);
+  while (node != nullptr) {
+    Node* next = node->next(0).load(std::memory_order_relaxed);
+    destroy_node(static_cast<Entry*>(node));
+    node = next;
+  }
+  while (m_retired != nullptr) {
+    Node* next = m_retired->next_retired;
+    destroy_node(static_cast<Entry*>(m_retired));
+    m_retired = next;
+  }
+  destroy_node(m_head);
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::insert(
+    const K& key, const V& value) -> bool {
+  const std::uint32_t height = random_height();
+  Levels preds;
+  Levels succs;
+
+  auto guard = m_domain.read_lock();
+  while (true) {
+    const int found_level = find(key, preds, succs);
+    if (found_level != -1) {
+      Node* found = succs[found_level];
+      if (found->marked.load(std::memory_order_acquire)) {
+        // It is being erased, try again once it is unlinked
+        continue;
+      }
+      // Wait for a concurrent insertion of the key, so that the key can be
+      // found once this returns
+      while (!found->fully_linked.load(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+      return false;
+    }
+
+    PredecessorLocks locks{preds};
+    bool valid = true;
+    for (std::uint32_t level = 0; valid && (level < height); level++) {
+      locks.lock(level);
+      Node* pred = preds[level];
+      Node* succ = succs[level];
+      valid = !pred->marked.load(std::memory_order_acquire) &&
+              (pred->next(level).load(std::memory_order_acquire) == succ) &&
+              ((succ == nullptr) ||
+               !succ->marked.load(std::memory_order_acquire));
+    }
+    if (!valid) {
+      // Another thread modified the list around the key
+      continue;
+    }
+
+    Entry* node = create_node<Entry>(height, key, value);
+    for (std::uint32_t level = 0; level < height; level++) {
+      node->next(level).store(succs[level], std::memory_order_relaxed);
+    }
+    for (std::uint32_t level = 0; level < height; level++) {
+      preds[level]->next(level).store(node, std::memory_order_release);
+    }
+    node->fully_linked.store(true, std::memory_order_release);
+    m_size.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::erase(
+    const K& key) -> Ditto::optional<V> {
+  Levels preds;
+  Levels succs;
+  Node* victim = nullptr;
+
+  {
+    auto guard = m_domain.read_lock();
+    while (true) {
+      const int found_level = find(key, preds, succs);
+      if (victim == nullptr) {
+        if (found_level == -1) {
+          return {};
+        }
+        // A node that is not fully linked yet is not in the list until its
+        // insertion is done, and the levels of a node are all found from its
+        // top one
+        Node* candidate = succs[found_level];
+        const auto top_level = static_cast<std::uint32_t>(found_level);
+        if (!is_live(candidate) || (candidate->height != top_level + 1)) {
+          return {};
+        }
+
+        candidate->mutex.lock();
+        if (candidate->marked.load(std::memory_order_relaxed)) {
+          // Another thread is erasing it
+          candidate->mutex.unlock();
+          return {};
+        }
+        candidate->marked.store(true, std::memory_order_release);
+        victim = candidate;
+      }
+
+      PredecessorLocks locks{preds};
+      bool valid = true;
+      for (std::uint32_t level = 0; valid && (level < victim->height);
+           level++) {
+        locks.lock(level);
+        Node* pred = preds[level];
+        valid = !pred->marked.load(std::memory_order_acquire) &&
+                (pred->next(level).load(std::memory_order_acquire) == victim);
+      }
+      if (!valid) {
+        continue;
+      }
+
+      for (std::uint32_t level = victim->height; level-- > 0;) {
+        preds[level]->next(level).store(
+            victim->next(level).load(std::memory_order_relaxed),
+            std::memory_order_release);
+      }
+      victim->mutex.unlock();
+      break;
+    }
+  }
+
+  m_size.fetch_sub(1, std::memory_order_relaxed);
+  // The value is never modified, and the node is not reclaimed until it is
+  // retired
+  Ditto::optional<V> value{static_cast<Entry*>(victim)->value};
+  retire(victim);
+  return value;
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::lookup(
+    const K& key) const -> Ditto::optional<V> {
+  auto guard = m_domain.read_lock();
+  Node* node = lower_bound_node(key);
+  if ((node != nullptr) && (key_of(node) == key) && is_live(node)) {
+    return Ditto::optional<V>{static_cast<Entry*>(node)->value};
+  }
+  return {};
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::contains(
+    const K& key) const -> bool {
+  auto guard = m_domain.read_lock();
+  Node* node = lower_bound_node(key);
+  return (node != nullptr) && (key_of(node) == key) && is_live(node);
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+template <std::invocable<const K&, const V&> Action>
+void ConcurrentSkipList<K, V, MAX_LEVEL, Mutex,
+                        NUM_READER_SLOTS>::for_each_in_range(const K& first,
+                                                             const K& last,
+                                                             Action action)
+    const {
+  auto guard = m_domain.read_lock();
+  // Erased nodes keep their links, so the walk can go on from them
+  for (Node* node = lower_bound_node(first);
+       (node != nullptr) && (key_of(node) < last);
+       node = node->next(0).load(std::memory_order_acquire)) {
+    if (is_live(node)) {
+      const auto* entry = static_cast<Entry*>(node);
+      action(entry->key, entry->value);
+    }
+  }
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+template <class N, class... Args>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::create_node(
+    std::uint32_t height, Args&&... args) -> N* {
+  constexpr std::size_t alignment =
+      std::max(alignof(N), alignof(std::atomic<Node*>));
+  constexpr std::size_t links_offset =
+      (sizeof(N) + alignof(std::atomic<Node*>) - 1) /
+      alignof(std::atomic<Node*>) * alignof(std::atomic<Node*>);
+
+  auto* memory = static_cast<std::byte*>(
+      ::operator new(links_offset + height * sizeof(std::atomic<Node*>),
+                     std::align_val_t{alignment}));
+  auto* links = reinterpret_cast<std::atomic<Node*>*>(memory + links_offset);
+  for (std::uint32_t level = 0; level < height; level++) {
+    new (&links[level]) std::atomic<Node*>{nullptr};
+  }
+  return new (memory) N{height, links, std::forward<Args>(args)...};
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+template <class N>
+void ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::destroy_node(
+    N* node) {
+  constexpr std::size_t alignment =
+      std::max(alignof(N), alignof(std::atomic<Node*>));
+  node->~N();
+  ::operator delete(node, std::align_val_t{alignment});
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex,
+                        NUM_READER_SLOTS>::random_height() -> std::uint32_t {
+  // Every level is kept with a probability of 1/2. Each thread has its own
+  // xorshift generator, so that insertions do not contend on it.
+  thread_local std::uint64_t state =
+      0x9E3779B97F4A7C15ULL * (this_thread_index() + 1);
+  state ^= state << 13;
+  state ^= state >> 7;
+  state ^= state << 17;
+
+  const auto bits = static_cast<std::uint32_t>(state >> 32) |
+                    (std::uint32_t{1} << (MAX_LEVEL - 1));
+  return static_cast<std::uint32_t>(std::countr_zero(bits)) + 1;
+}
+
+// Fills preds and succs with the last node before the key and the first one
+// after it at every level. Returns the highest level at which a node with the
+// key was found, or -1 if none was found.
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::find(
+    const K& key, Levels& preds, Levels& succs) const -> int {
+  int found_level = -1;
+  Node* pred = m_head;
+  for (std::uint32_t level = MAX_LEVEL; level-- > 0;) {
+    Node* curr = pred->next(level).load(std::memory_order_acquire);
+    while ((curr != nullptr) && (key_of(curr) < key)) {
+      pred = curr;
+      curr = pred->next(level).load(std::memory_order_acquire);
+    }
+    if ((found_level == -1) && (curr != nullptr) && (key_of(curr) == key)) {
+      found_level = static_cast<int>(level);
+    }
+    preds[level] = pred;
+    succs[level] = curr;
+  }
+  return found_level;
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+auto ConcurrentSkipList<K, V, MAX_LEVEL, Mutex,
+                        NUM_READER_SLOTS>::lower_bound_node(const K& key) const
+    -> Node* {
+  Node* pred = m_head;
+  Node* curr = nullptr;
+  for (std::uint32_t level = MAX_LEVEL; level-- > 0;) {
+    curr = pred->next(level).load(std::memory_order_acquire);
+    while ((curr != nullptr) && (key_of(curr) < key)) {
+      pred = curr;
+      curr = pred->next(level).load(std::memory_order_acquire);
+    }
+  }
+  return curr;
+}
+
+template <class K, class V, std::uint32_t MAX_LEVEL, class Mutex,
+          std::size_t NUM_READER_SLOTS>
+void ConcurrentSkipList<K, V, MAX_LEVEL, Mutex, NUM_READER_SLOTS>::retire(
+    Node* node) {
+  Node* batch = nullptr;
+  {
+    std::scoped_lock<std::mutex> lock{m_retired_mutex};
+    node->next_retired = m_retired;
+    m_retired = node;
+    if (++m_num_retired < RECLAIM_BATCH_SIZE) {
+      return;
+    }
+    batch = std::exchange(m_retired, nullptr);
+    m_num_retired = 0;
+  }
+
+  // Readers that could still be walking through the batch have left after a
+  // grace period
+  m_domain.synchronize();
+  while (batch != nullptr) {
+    Node* next = batch->next_retired;
+    destroy_node(static_cast<Entry*>(batch));
+    batch = next;
+  }
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_CONCURRENT_SKIP_LIST_H_
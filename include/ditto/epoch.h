@@ -0,0 +1,104 @@
+#ifndef DITTO_EPOCH_H_
+#define DITTO_EPOCH_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include "ditto/thread_slot.h"
+
+namespace Ditto {
+
+/**
+ * @brief Tracks read-side critical sections so that writers can wait for a
+ * grace period: the moment at which all readers that could still observe an
+ * old version of some data have left.
+ *
+ * Readers register in a per-thread, cache-line-padded slot using one of two
+ * counters, selected by the parity of the current epoch. Entering and leaving
+ * is wait-free and only touches the slot of the calling thread. synchronize()
+ * flips the epoch twice, each time waiting for the counters of the previous
+ * parity to drain, which guarantees that every reader that entered before the
+ * call has left.
+ */
+template <std::size_t NUM_SLOTS = 32>
+class EpochDomain {
+  static_assert(NUM_SLOTS > 0, "At least one reader slot is required");
+
+ public:
+  /**
+   * @brief Keeps the read-side critical section open while alive.
+   */
+  class [[nodiscard]] ReadGuard {
+   public:
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard(ReadGuard&&) = delete;
+    auto operator=(const ReadGuard&) -> ReadGuard& = delete;
+    auto operator=(ReadGuard&&) -> ReadGuard& = delete;
+
+    ~ReadGuard() { m_counter->fetch_sub(1, std::memory_order_release); }
+
+   private:
+    std::atomic<std::uint32_t>* m_counter;
+
+    explicit ReadGuard(std::atomic<std::uint32_t>* counter)
+        : m_counter(counter) {}
+
+    friend EpochDomain;
+  };
+
+  EpochDomain() = default;
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain(EpochDomain&&) = delete;
+  auto operator=(const EpochDomain&) -> EpochDomain& = delete;
+  auto operator=(EpochDomain&&) -> EpochDomain& = delete;
+
+  /**
+   * @brief Enters a read-side critical section. Data loaded after this call
+   * will not be reclaimed until the returned guard is destroyed.
+   */
+  auto read_lock() -> ReadGuard {
+    Slot& slot = m_slots[this_thread_index() % NUM_SLOTS];
+    const std::uint32_t phase = m_epoch.load(std::memory_order_seq_cst) & 1;
+    std::atomic<std::uint32_t>* counter = &slot.readers[phase];
+    counter->fetch_add(1, std::memory_order_seq_cst);
+    return ReadGuard{counter};
+  }
+
+  /**
+   * @brief Waits for a grace period. Must not be called from within a
+   * read-side critical section.
+   */
+  void synchronize() {
+    std::scoped_lock<std::mutex> lock{m_synchronize_mutex};
+    for (std::size_t i = 0; i < 2; i++) {
+      const std::uint32_t phase =
+          m_epoch.fetch_add(1, std::memory_order_seq_cst);
+      wait_for_readers(phase & 1);
+    }
+  }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Slot {
+    std::array<std::atomic<std::uint32_t>, 2> readers{};
+  };
+
+  std::array<Slot, NUM_SLOTS> m_slots;
+  alignas(CACHE_LINE_SIZE) std::atomic<std::uint32_t> m_epoch{0};
+  std::mutex m_synchronize_mutex;
+
+  void wait_for_readers(std::uint32_t phase) {
+    for (Slot& slot : m_slots) {
+      while (slot.readers[phase].load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_EPOCH_H_
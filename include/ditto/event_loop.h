@@ -1,19 +1,160 @@
 #ifndef DITTO_EVENT_LOOP_H_
 #define DITTO_EVENT_LOOP_H_
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bitset>
+#include <coroutine>
 #include <cstddef>
+#include <cstdint>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
+#include "ditto/assert.h"
 #include "ditto/circular_queue.h"
+#include "ditto/histogram.h"
 #include "ditto/linear_map.h"
 #include "ditto/non_null_ptr.h"
 
 namespace Ditto {
 
+/**
+ * @brief What EventLoop::post_event does when the lane of the event is full.
+ */
+enum class OverflowPolicy {
+  // The posted event is discarded
+  DROP_NEWEST,
+  // The oldest event of the lane is discarded to make room for the new one
+  DROP_OLDEST,
+  // The posted event is merged with a pending event of the same type. If there
+  // is none, the posted event is discarded
+  COALESCE,
+  // The producer waits until there is room for the event. Only meant for HALs
+  // where events are posted from threads, and only available if the HAL has a
+  // yield() method. See EventLoop::post_event
+  BLOCK,
+};
+
+/**
+ * @brief Outcome of EventLoop::post_event.
+ */
+enum class PostStatus {
+  // The event has been queued
+  QUEUED,
+  // The event was already pending and has been merged with it
+  COALESCED,
+  // The event has been queued, but the oldest event of the lane was dropped
+  DROPPED_OLDEST,
+  // The event has been dropped
+  DROPPED,
+};
+
+/**
+ * @brief Default instrumentation of the EventLoop. It records nothing and
+ * compiles out completely.
+ */
+struct NoEventLoopInstrumentation {
+  static constexpr bool ENABLED = false;
+};
+
+/**
+ * @brief EventLoop instrumentation that keeps, for each event type, a
+ * histogram of the cycles events spend queued and of the cycles their
+ * listeners take to handle them, as well as the high-water mark of the event
+ * queue.
+ *
+ * Events are indexed by their underlying value, which must be lower than
+ * NUM_EVENT_TYPES. The EventLoop timestamps events with HAL::cycle_count(),
+ * which must return a free-running std::uint32_t counter.
+ */
+template <std::size_t NUM_EVENT_TYPES, std::size_t NUM_BUCKETS = 32>
+class EventLoopStats {
+ public:
+  static constexpr bool ENABLED = true;
+
+  using Histogram = Log2Histogram<NUM_BUCKETS>;
+
+  template <class Event>
+  void record_queue_latency(Event event, std::uint32_t cycles) {
+    m_queue_latency[index_of(event)].record(cycles);
+  }
+
+  template <class Event>
+  void record_handler_duration(Event event, std::uint32_t cycles) {
+    m_handler_duration[index_of(event)].record(cycles);
+  }
+
+  void record_queue_depth(std::size_t depth) {
+    m_queue_high_water_mark = std::max(m_queue_high_water_mark, depth);
+  }
+
+  template <class Event>
+  [[nodiscard]] auto queue_latency(Event event) const -> const Histogram& {
+    return m_queue_latency[index_of(event)];
+  }
+
+  template <class Event>
+  [[nodiscard]] auto handler_duration(Event event) const -> const Histogram& {
+    return m_handler_duration[index_of(event)];
+  }
+
+  /**
+   * @brief Largest number of events that have been pending in a single
+   * priority lane of the loop.
+   */
+  [[nodiscard]] auto queue_high_water_mark() const -> std::size_t {
+    return m_queue_high_water_mark;
+  }
+
+ private:
+  std::array<Histogram, NUM_EVENT_TYPES> m_queue_latency;
+  std::array<Histogram, NUM_EVENT_TYPES> m_handler_duration;
+  std::size_t m_queue_high_water_mark = 0;
+
+  template <class Event>
+  static auto index_of(Event event) -> std::size_t {
+    const auto index = static_cast<std::size_t>(event);
+    DITTO_VERIFY(index < NUM_EVENT_TYPES);
+    return index;
+  }
+};
+
+/**
+ * @brief Event loop that dispatches events to their subscribed listeners.
+ *
+ * Events are queued in NUM_PRIORITIES lanes, each of them able to hold
+ * MAX_INFLIGHT_EVENTS events. Lanes with a higher index have a higher priority
+ * and are always drained first, unless aging is enabled and a lower lane has
+ * been waiting for too long.
+ *
+ * Besides listeners, coroutines (see Ditto::Task) can co_await wait_for() to
+ * suspend until an event is dispatched, or sleep_for()/sleep_until() to
+ * suspend until a timer expires. Timers require the HAL to provide a
+ * `std::uint32_t now()` tick counter and to wake up wfe() periodically (e.g.:
+ * with a tick interrupt). Suspended coroutines are resumed from run() and must
+ * only be created and awaited on the thread running the loop.
+ *
+ * The Instrumentation parameter selects at compile time whether the loop
+ * measures queueing latency and handler duration (see EventLoopStats). With
+ * the default NoEventLoopInstrumentation no timestamps are taken or stored.
+ *
+ * Event types can be marked as coalescing with set_coalescing(). Posting an
+ * event of such a type while another one is still pending in the same lane or
+ * in a higher priority one is a no-op, so a burst of redundant notifications
+ * costs a single dispatch. Pending coalescing events are tracked per lane in
+ * a bitset indexed by the underlying value of the event, so only event types
+ * whose value is lower than NUM_EVENT_TYPES can be coalescing. Other events
+ * are never coalesced and can have any value.
+ */
 template <class Event, class HAL, std::size_t MAX_INFLIGHT_EVENTS = 10,
-          std::size_t MAX_LISTENERS = 10>
+          std::size_t MAX_LISTENERS = 10, std::size_t NUM_PRIORITIES = 1,
+          class Instrumentation = NoEventLoopInstrumentation,
+          std::size_t NUM_EVENT_TYPES = 32>
 class EventLoop {
+  static_assert(NUM_PRIORITIES > 0, "At least one priority lane is required");
+
  public:
   class Listener {
    public:
@@ -22,29 +163,237 @@ class EventLoop {
     virtual ~Listener() = default;
   };
 
+  /**
+   * @brief Awaitable returned by wait_for(). Resumes the awaiting coroutine
+   * after the event has been dispatched to the listeners, returning the event.
+   */
+  class EventAwaiter {
+   public:
+    EventAwaiter(const EventAwaiter&) = delete;
+    EventAwaiter& operator=(const EventAwaiter&) = delete;
+    EventAwaiter(EventAwaiter&&) = delete;
+    EventAwaiter& operator=(EventAwaiter&&) = delete;
+
+    // The awaiter lives in the frame of the awaiting coroutine. If the frame
+    // is destroyed while suspended, the loop must forget about it
+    ~EventAwaiter() {
+      if (m_handle) {
+        m_loop->unlink(this);
+      }
+    }
+
+    auto await_ready() const noexcept -> bool { return false; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      m_handle = handle;
+      m_next = m_loop->m_event_waiters;
+      m_loop->m_event_waiters = this;
+    }
+    auto await_resume() const noexcept -> Event { return m_event; }
+
+   private:
+    EventLoop* m_loop;
+    Event m_event;
+    std::coroutine_handle<> m_handle;
+    EventAwaiter* m_next = nullptr;
+
+    EventAwaiter(EventLoop* loop, Event event)
+        : m_loop(loop), m_event(event) {}
+
+    friend EventLoop;
+  };
+
+  /**
+   * @brief Awaitable returned by sleep_for() and sleep_until(). Resumes the
+   * awaiting coroutine once HAL::now() reaches the deadline.
+   */
+  class TimerAwaiter {
+   public:
+    TimerAwaiter(const TimerAwaiter&) = delete;
+    TimerAwaiter& operator=(const TimerAwaiter&) = delete;
+    TimerAwaiter(TimerAwaiter&&) = delete;
+    TimerAwaiter& operator=(TimerAwaiter&&) = delete;
+
+    ~TimerAwaiter() {
+      if (m_handle) {
+        m_loop->unlink(this);
+      }
+    }
+
+    auto await_ready() const noexcept -> bool { return false; }
+    void await_suspend(std::coroutine_handle<> handle) noexcept {
+      m_handle = handle;
+      m_next = m_loop->m_timer_waiters;
+      m_loop->m_timer_waiters = this;
+    }
+    void await_resume() const noexcept {}
+
+   private:
+    EventLoop* m_loop;
+    std::uint32_t m_deadline;
+    std::coroutine_handle<> m_handle;
+    TimerAwaiter* m_next = nullptr;
+
+    TimerAwaiter(EventLoop* loop, std::uint32_t deadline)
+        : m_loop(loop), m_deadline(deadline) {}
+
+    friend EventLoop;
+  };
+
   explicit EventLoop(HAL* hal) : m_hal(hal) {}
 
-  void post_event(Event e) { m_event_queue.push(e); }
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+  EventLoop(EventLoop&&) = delete;
+  EventLoop& operator=(EventLoop&&) = delete;
+
+  // Coroutines still waiting are never resumed. Their awaiters are detached so
+  // that destroying their frames later does not touch the loop
+  ~EventLoop() {
+    detach_all(m_event_waiters);
+    detach_all(m_ready_event_waiters);
+    detach_all(m_timer_waiters);
+    detach_all(m_ready_timer_waiters);
+  }
+
+  /**
+   * @brief Queues an event in the lane of the given priority. If the lane is
+   * full, the configured OverflowPolicy decides what happens. Every event lost
+   * due to an overflow increments the overflow counter of the lane. The
+   * returned status lets producers throttle when the loop falls behind.
+   *
+   * With OverflowPolicy::BLOCK each attempt to queue the event runs between
+   * HAL::disable_interrupts() and HAL::enable_interrupts(), and HAL::yield() is
+   * called between attempts. It must not be used from interrupt handlers or
+   * from the thread running the loop.
+   */
+  auto post_event(Event e, std::size_t priority = 0) -> PostStatus {
+    DITTO_VERIFY(priority < NUM_PRIORITIES);
+    Lane& lane = m_lanes[priority];
+    QueuedEvent queued{e};
+    if constexpr (Instrumentation::ENABLED) {
+      queued.posted_at = m_hal->cycle_count();
+    }
+
+    PostStatus status = PostStatus::QUEUED;
+    if (m_overflow_policy == OverflowPolicy::BLOCK) {
+      status = push_blocking(priority, queued);
+    } else if (is_pending(e, priority)) {
+      status = PostStatus::COALESCED;
+    } else if (!push(lane, queued)) {
+      status = handle_overflow(lane, queued);
+    }
+
+    if constexpr (Instrumentation::ENABLED) {
+      m_instrumentation.record_queue_depth(lane.queue.size());
+    }
+    return status;
+  }
+
+  /**
+   * @brief Enables or disables coalescing for the given event type.
+   * @retval false if the underlying value of the event is not lower than
+   * NUM_EVENT_TYPES, in which case the event cannot be coalescing.
+   */
+  auto set_coalescing(Event event, bool enabled) -> bool {
+    const auto index = static_cast<std::size_t>(event);
+    if (index >= NUM_EVENT_TYPES) {
+      return false;
+    }
+    m_coalescing_events.set(index, enabled);
+    return true;
+  }
+
+  /**
+   * @brief Sets what post_event does when a lane is full.
+   * @retval false if the policy is OverflowPolicy::BLOCK and the HAL has no
+   * yield(), in which case the current policy is kept.
+   */
+  auto set_overflow_policy(OverflowPolicy policy) -> bool {
+    if constexpr (!HAL_CAN_YIELD) {
+      if (policy == OverflowPolicy::BLOCK) {
+        return false;
+      }
+    }
+    m_overflow_policy = policy;
+    return true;
+  }
+
+  /**
+   * @brief Enables aging of pending events. Once a non-empty lane has been
+   * skipped `threshold` times in favour of higher priority lanes, its next
+   * event is dispatched before them. A threshold of 0 disables aging.
+   */
+  void set_aging_threshold(std::uint32_t threshold) {
+    m_aging_threshold = threshold;
+  }
+
+  /**
+   * @brief Returns the number of events lost because the lane of the given
+   * priority was full.
+   */
+  [[nodiscard]] auto overflow_count(std::size_t priority) const
+      -> std::uint32_t {
+    DITTO_VERIFY(priority < NUM_PRIORITIES);
+    return m_lanes[priority].overflow_count;
+  }
+
+  [[nodiscard]] auto instrumentation() const -> const Instrumentation& {
+    return m_instrumentation;
+  }
+
+  [[nodiscard]] auto wait_for(Event event) -> EventAwaiter {
+    return EventAwaiter{this, event};
+  }
+
+  [[nodiscard]] auto sleep_until(std::uint32_t deadline) -> TimerAwaiter {
+    return TimerAwaiter{this, deadline};
+  }
+
+  [[nodiscard]] auto sleep_for(std::uint32_t ticks) -> TimerAwaiter {
+    return TimerAwaiter{this, static_cast<std::uint32_t>(m_hal->now() + ticks)};
+  }
 
   void run() {
     while (m_running.load(std::memory_order_relaxed)) {
+      if constexpr (requires(HAL & hal) { hal.now(); }) {
+        if (m_timer_waiters != nullptr) {
+          resume_expired_timers();
+        }
+      }
+
       m_hal->disable_interrupts();
-      std::optional<Event> event = m_event_queue.pop();
-      if (!event.has_value()) {
+      std::optional<QueuedEvent> queued = pop_next_event();
+      if (!queued.has_value()) {
         m_hal->enable_interrupts();
         m_hal->wfe();
       } else {
+        const Event event = queued->event;
         // Look for subscribers and notify them
-        std::optional<NonNullPtr<Listener>> listener =
-            m_listeners.at(event.value());
+        std::optional<NonNullPtr<Listener>> listener = m_listeners.at(event);
         Listener* broadcast = m_broadcast;
         m_hal->enable_interrupts();
 
+        [[maybe_unused]] std::uint32_t dispatched_at = 0;
+        if constexpr (Instrumentation::ENABLED) {
+          dispatched_at = m_hal->cycle_count();
+          m_instrumentation.record_queue_latency(
+              event, dispatched_at - queued->posted_at);
+        }
+
         if (listener.has_value()) {
-          listener.value()->on_event(event.value());
+          listener.value()->on_event(event);
         }
         if (broadcast) {
-          broadcast->on_event(event.value());
+          broadcast->on_event(event);
+        }
+
+        if constexpr (Instrumentation::ENABLED) {
+          m_instrumentation.record_handler_duration(
+              event, m_hal->cycle_count() - dispatched_at);
+        }
+
+        if (m_event_waiters != nullptr) {
+          resume_event_waiters(event);
         }
       }
     }
@@ -61,12 +410,251 @@ class EventLoop {
   void stop() { m_running.store(false, std::memory_order_relaxed); }
 
  private:
+  static constexpr bool HAL_CAN_YIELD = requires(HAL & hal) { hal.yield(); };
+
+  struct NoTimestamp {};
+  using Timestamp = std::conditional_t<Instrumentation::ENABLED, std::uint32_t,
+                                       NoTimestamp>;
+
+  struct QueuedEvent {
+    Event event;
+    [[no_unique_address]] Timestamp posted_at{};
+  };
+
+  struct Lane {
+    CircularQueue<QueuedEvent, MAX_INFLIGHT_EVENTS> queue;
+    std::uint32_t overflow_count = 0;
+    std::uint32_t skipped_count = 0;
+    // Coalescing event types queued in this lane
+    std::bitset<NUM_EVENT_TYPES> pending_events;
+  };
+
   HAL* m_hal = nullptr;
-  CircularQueue<Event, MAX_INFLIGHT_EVENTS> m_event_queue;
+  std::array<Lane, NUM_PRIORITIES> m_lanes;
+  std::uint32_t m_aging_threshold = 0;
+  OverflowPolicy m_overflow_policy = OverflowPolicy::DROP_NEWEST;
+  std::bitset<NUM_EVENT_TYPES> m_coalescing_events;
   LinearMap<Event, NonNullPtr<Listener>, MAX_LISTENERS> m_listeners;
   Listener* m_broadcast = nullptr;
+  EventAwaiter* m_event_waiters = nullptr;
+  TimerAwaiter* m_timer_waiters = nullptr;
+  // Waiters detached from the lists above, about to be resumed
+  EventAwaiter* m_ready_event_waiters = nullptr;
+  TimerAwaiter* m_ready_timer_waiters = nullptr;
+
+  [[no_unique_address]] Instrumentation m_instrumentation;
 
   std::atomic_bool m_running{true};
+
+  auto is_coalescing(Event event) const -> bool {
+    if (m_coalescing_events.none()) {
+      return false;
+    }
+    const auto index = static_cast<std::size_t>(event);
+    return (index < NUM_EVENT_TYPES) && m_coalescing_events.test(index);
+  }
+
+  // Returns true if the event is a coalescing one and it is already queued in
+  // the lane of the given priority or in a higher priority one. A copy queued
+  // in a lower priority lane would be dispatched later, so it is not reused.
+  auto is_pending(Event event, std::size_t priority) const -> bool {
+    if (!is_coalescing(event)) {
+      return false;
+    }
+    const auto index = static_cast<std::size_t>(event);
+    for (std::size_t i = priority; i < NUM_PRIORITIES; i++) {
+      if (m_lanes[i].pending_events.test(index)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  auto push(Lane& lane, const QueuedEvent& queued) -> bool {
+    if (!lane.queue.push(queued)) {
+      return false;
+    }
+    if (is_coalescing(queued.event)) {
+      lane.pending_events.set(static_cast<std::size_t>(queued.event));
+    }
+    return true;
+  }
+
+  auto pop(Lane& lane) -> std::optional<QueuedEvent> {
+    std::optional<QueuedEvent> queued = lane.queue.pop();
+    if (queued.has_value() && lane.pending_events.any()) {
+      const auto index = static_cast<std::size_t>(queued->event);
+      if (index < NUM_EVENT_TYPES) {
+        lane.pending_events.reset(index);
+      }
+    }
+    return queued;
+  }
+
+  auto handle_overflow(Lane& lane, const QueuedEvent& queued) -> PostStatus {
+    if (m_overflow_policy == OverflowPolicy::DROP_OLDEST) {
+      (void)pop(lane);
+      lane.overflow_count++;
+      push(lane, queued);
+      return PostStatus::DROPPED_OLDEST;
+    }
+
+    if (m_overflow_policy == OverflowPolicy::COALESCE) {
+      const auto* pending =
+          lane.queue.find_if([&](const QueuedEvent& other) {
+            return other.event == queued.event;
+          });
+      if (pending != nullptr) {
+        return PostStatus::COALESCED;
+      }
+    }
+
+    lane.overflow_count++;
+    return PostStatus::DROPPED;
+  }
+
+  auto push_blocking(std::size_t priority, const QueuedEvent& queued)
+      -> PostStatus {
+    // set_overflow_policy() refuses BLOCK if the HAL cannot yield
+    if constexpr (HAL_CAN_YIELD) {
+      Lane& lane = m_lanes[priority];
+      while (true) {
+        m_hal->disable_interrupts();
+        if (is_pending(queued.event, priority)) {
+          m_hal->enable_interrupts();
+          return PostStatus::COALESCED;
+        }
+        const bool pushed = push(lane, queued);
+        m_hal->enable_interrupts();
+        if (pushed) {
+          return PostStatus::QUEUED;
+        }
+        m_hal->yield();
+      }
+    }
+    return PostStatus::DROPPED;
+  }
+
+  void resume_event_waiters(Event event) {
+    // Detach the matching waiters first, since resuming them may register new
+    // waiters. They are collected in reverse, restoring the order in which
+    // they started waiting.
+    EventAwaiter* ready = nullptr;
+    EventAwaiter** link = &m_event_waiters;
+    while (*link != nullptr) {
+      EventAwaiter* waiter = *link;
+      if (waiter->m_event == event) {
+        *link = waiter->m_next;
+        waiter->m_next = ready;
+        ready = waiter;
+      } else {
+        link = &waiter->m_next;
+      }
+    }
+
+    // Resuming a waiter may destroy the frames of the ones that follow, which
+    // then unlink themselves from the ready list
+    m_ready_event_waiters = ready;
+    while (m_ready_event_waiters != nullptr) {
+      EventAwaiter* waiter = m_ready_event_waiters;
+      m_ready_event_waiters = waiter->m_next;
+      std::exchange(waiter->m_handle, {}).resume();
+    }
+  }
+
+  void resume_expired_timers() {
+    const std::uint32_t now = m_hal->now();
+
+    TimerAwaiter* ready = nullptr;
+    TimerAwaiter** link = &m_timer_waiters;
+    while (*link != nullptr) {
+      TimerAwaiter* waiter = *link;
+      // Tolerates the wrap-around of the tick counter
+      if (static_cast<std::int32_t>(now - waiter->m_deadline) >= 0) {
+        *link = waiter->m_next;
+        waiter->m_next = ready;
+        ready = waiter;
+      } else {
+        link = &waiter->m_next;
+      }
+    }
+
+    m_ready_timer_waiters = ready;
+    while (m_ready_timer_waiters != nullptr) {
+      TimerAwaiter* waiter = m_ready_timer_waiters;
+      m_ready_timer_waiters = waiter->m_next;
+      std::exchange(waiter->m_handle, {}).resume();
+    }
+  }
+
+  template <class Awaiter>
+  static auto unlink_from(Awaiter*& list, Awaiter* awaiter) -> bool {
+    for (Awaiter** link = &list; *link != nullptr; link = &(*link)->m_next) {
+      if (*link == awaiter) {
+        *link = awaiter->m_next;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void unlink(EventAwaiter* awaiter) {
+    if (!unlink_from(m_event_waiters, awaiter)) {
+      unlink_from(m_ready_event_waiters, awaiter);
+    }
+  }
+
+  void unlink(TimerAwaiter* awaiter) {
+    if (!unlink_from(m_timer_waiters, awaiter)) {
+      unlink_from(m_ready_timer_waiters, awaiter);
+    }
+  }
+
+  template <class Awaiter>
+  static void detach_all(Awaiter*& list) {
+    while (list != nullptr) {
+      list->m_handle = {};
+      list = list->m_next;
+    }
+  }
+
+  // Must be called with interrupts disabled
+  auto pop_next_event() -> std::optional<QueuedEvent> {
+    if constexpr (NUM_PRIORITIES == 1) {
+      return pop(m_lanes[0]);
+    } else {
+      Lane* selected = nullptr;
+      for (std::size_t i = NUM_PRIORITIES; i > 0; i--) {
+        Lane& lane = m_lanes[i - 1];
+        if (lane.queue.empty()) {
+          continue;
+        }
+        if (selected == nullptr) {
+          selected = &lane;
+        } else if ((m_aging_threshold != 0) &&
+                   (lane.skipped_count >= m_aging_threshold)) {
+          // This lane has starved for long enough, give it a turn
+          selected = &lane;
+          break;
+        }
+      }
+
+      if (selected == nullptr) {
+        return {};
+      }
+
+      if (m_aging_threshold != 0) {
+        for (Lane& lane : m_lanes) {
+          if (&lane == selected) {
+            lane.skipped_count = 0;
+          } else if (!lane.queue.empty() && (&lane < selected)) {
+            lane.skipped_count++;
+          }
+        }
+      }
+      return pop(*selected);
+    }
+  }
 };
 
 }  // namespace Ditto
@@ -0,0 +1,214 @@
+#ifndef DITTO_FIXED_HEAP_H_
+#define DITTO_FIXED_HEAP_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+#include "ditto/thread_slot.h"
+
+namespace Ditto {
+
+/**
+ * @brief Default arity of a Ditto::FixedDaryHeap: as many elements as fit in
+ * a cache line, between 2 and 8.
+ */
+template <class T>
+inline constexpr std::size_t CACHE_LINE_ARITY = std::clamp<std::size_t>(
+    std::bit_floor(std::max<std::size_t>(CACHE_LINE_SIZE / sizeof(T), 1)), 2,
+    8);
+
+/**
+ * @brief Statically allocated priority queue holding up to CAPACITY elements
+ * in an implicit heap where every node has ARITY children.
+ *
+ * top() is the smallest element according to Compare, so the default is a
+ * min-heap and std::greater<T> makes a max-heap. Note this is the opposite of
+ * std::priority_queue.
+ *
+ * A wider heap is shallower, so pushing compares and moves fewer elements, at
+ * the cost of comparing ARITY children per level when popping. The storage is
+ * laid out so that the children of a node are contiguous and start at a
+ * multiple of ARITY elements from a cache-line-aligned base. When
+ * ARITY * sizeof(T) divides the cache line size, every level of a pop only
+ * touches one cache line.
+ */
+template <class T, std::size_t CAPACITY,
+          std::size_t ARITY = CACHE_LINE_ARITY<T>,
+          class Compare = std::less<T>>
+class FixedDaryHeap {
+  static_assert(ARITY >= 2, "A heap node needs at least two children");
+
+ public:
+  using value_type = T;
+
+  FixedDaryHeap() = default;
+  explicit FixedDaryHeap(const Compare& compare) : m_compare(compare) {}
+
+  FixedDaryHeap(const FixedDaryHeap&) = delete;
+  FixedDaryHeap& operator=(const FixedDaryHeap&) = delete;
+  FixedDaryHeap(FixedDaryHeap&&) = delete;
+  FixedDaryHeap& operator=(FixedDaryHeap&&) = delete;
+
+  ~FixedDaryHeap() { clear(); }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto full() const -> bool { return m_size == CAPACITY; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+  [[nodiscard]] static constexpr auto capacity() -> std::size_t {
+    return CAPACITY;
+  }
+
+  /**
+   * @brief Adds an element to the heap in O(log N).
+   * @retval true if inserted. false if the heap is full.
+   */
+  auto push(T value) -> bool;
+
+  /**
+   * @brief Constructs an element from the given arguments and adds it to the
+   * heap.
+   * @retval true if inserted. false if the heap is full.
+   */
+  template <class... Args>
+  auto emplace(Args&&... args) -> bool {
+    return push(T(std::forward<Args>(args)...));
+  }
+
+  /**
+   * @brief Returns the smallest element. The heap must not be empty.
+   */
+  [[nodiscard]] auto top() const -> const T& {
+    DITTO_VERIFY(!empty());
+    return at(0);
+  }
+
+  /**
+   * @brief Removes the smallest element and returns it.
+   * @retval The element if the heap was not empty. std::nullopt otherwise.
+   */
+  auto pop() -> std::optional<T>;
+
+  void clear() {
+    for (std::size_t i = 0; i < m_size; i++) {
+      at(i).~T();
+    }
+    m_size = 0;
+  }
+
+ private:
+  // Element i lives in slot i + ARITY - 1, which puts the children of i,
+  // ARITY * i + 1 to ARITY * i + ARITY, at slots starting at ARITY * (i + 1)
+  static constexpr std::size_t OFFSET = ARITY - 1;
+
+  alignas(CACHE_LINE_SIZE) std::array<
+      typename std::aligned_storage<sizeof(T), alignof(T)>::type,
+      CAPACITY + OFFSET> m_storage;
+  std::size_t m_size = 0;
+  [[no_unique_address]] Compare m_compare;
+
+  auto slot(std::size_t index) -> void* { return &m_storage[index + OFFSET]; }
+  auto at(std::size_t index) -> T& {
+    return *std::launder(reinterpret_cast<T*>(&m_storage[index + OFFSET]));
+  }
+  auto at(std::size_t index) const -> const T& {
+    return *std::launder(
+        reinterpret_cast<const T*>(&m_storage[index + OFFSET]));
+  }
+
+  static constexpr auto parent_of(std::size_t index) -> std::size_t {
+    return (index - 1) / ARITY;
+  }
+
+  // Moves the element into the hole at index, moving down the smaller
+  // children until the element is not larger than any of them
+  void sift_down(std::size_t index, T value);
+};
+
+template <class T, std::size_t CAPACITY, class Compare = std::less<T>>
+using FixedHeap = FixedDaryHeap<T, CAPACITY, 2, Compare>;
+
+template <class T, std::size_t CAPACITY, std::size_t ARITY, class Compare>
+auto FixedDaryHeap<T, CAPACITY, ARITY, Compare>::push(T value) -> bool {
+  if (full()) {
+    return false;
+  }
+
+  std::size_t index = m_size;
+  if ((index == 0) || !m_compare(value, at(parent_of(index)))) {
+    new (slot(index)) T(std::move(value));
+    m_size++;
+    return true;
+  }
+
+  // The last slot is raw storage, so the first parent moved down is
+  // constructed there and the following ones are assigned
+  std::size_t parent = parent_of(index);
+  new (slot(index)) T(std::move(at(parent)));
+  m_size++;
+  index = parent;
+  while (index > 0) {
+    parent = parent_of(index);
+    if (!m_compare(value, at(parent))) {
+      break;
+    }
+    at(index) = std::move(at(parent));
+    index = parent;
+  }
+  at(index) = std::move(value);
+  return true;
+}
+
+template <class T, std::size_t CAPACITY, std::size_t ARITY, class Compare>
+auto FixedDaryHeap<T, CAPACITY, ARITY, Compare>::pop() -> std::optional<T> {
+  if (empty()) {
+    return std::nullopt;
+  }
+
+  std::optional<T> result{std::move(at(0))};
+  m_size--;
+  T last(std::move(at(m_size)));
+  at(m_size).~T();
+  if (m_size == 0) {
+    return result;
+  }
+  sift_down(0, std::move(last));
+  return result;
+}
+
+template <class T, std::size_t CAPACITY, std::size_t ARITY, class Compare>
+void FixedDaryHeap<T, CAPACITY, ARITY, Compare>::sift_down(std::size_t index,
+                                                           T value) {
+  while (true) {
+    const std::size_t first_child = ARITY * index + 1;
+    if (first_child >= m_size) {
+      break;
+    }
+
+    const std::size_t end = std::min(first_child + ARITY, m_size);
+    std::size_t smallest = first_child;
+    for (std::size_t child = first_child + 1; child < end; child++) {
+      if (m_compare(at(child), at(smallest))) {
+        smallest = child;
+      }
+    }
+
+    if (!m_compare(at(smallest), value)) {
+      break;
+    }
+    at(index) = std::move(at(smallest));
+    index = smallest;
+  }
+  at(index) = std::move(value);
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_FIXED_HEAP_H_
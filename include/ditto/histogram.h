@@ -0,0 +1,68 @@
+#ifndef DITTO_HISTOGRAM_H_
+#define DITTO_HISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+#include "ditto/assert.h"
+
+namespace Ditto {
+
+/**
+ * @brief Histogram with logarithmic buckets. Bucket 0 counts samples with a
+ * value of 0 and bucket N counts samples in the range [2^(N-1), 2^N). The last
+ * bucket also counts all samples that do not fit in the previous ones.
+ *
+ * Recording a sample is O(1) and takes no more than a count-leading-zeros
+ * instruction and a few additions, making it suitable for hot paths.
+ */
+template <std::size_t NUM_BUCKETS = 32>
+class Log2Histogram {
+  static_assert(NUM_BUCKETS > 0, "At least one bucket is required");
+
+ public:
+  void record(std::uint32_t value) {
+    const std::size_t index =
+        std::min<std::size_t>(std::bit_width(value), NUM_BUCKETS - 1);
+    m_buckets[index]++;
+    m_count++;
+    m_total += value;
+    m_max = std::max(m_max, value);
+  }
+
+  void reset() { *this = Log2Histogram{}; }
+
+  [[nodiscard]] auto bucket(std::size_t index) const -> std::uint32_t {
+    DITTO_VERIFY(index < NUM_BUCKETS);
+    return m_buckets[index];
+  }
+
+  /**
+   * @brief Returns the smallest value that falls into the bucket.
+   */
+  [[nodiscard]] static auto bucket_lower_bound(std::size_t index)
+      -> std::uint64_t {
+    return index == 0 ? 0 : std::uint64_t{1} << (index - 1);
+  }
+
+  [[nodiscard]] static constexpr auto num_buckets() -> std::size_t {
+    return NUM_BUCKETS;
+  }
+
+  [[nodiscard]] auto count() const -> std::uint32_t { return m_count; }
+  [[nodiscard]] auto total() const -> std::uint64_t { return m_total; }
+  [[nodiscard]] auto max() const -> std::uint32_t { return m_max; }
+
+ private:
+  std::array<std::uint32_t, NUM_BUCKETS> m_buckets{};
+  std::uint32_t m_count = 0;
+  std::uint32_t m_max = 0;
+  std::uint64_t m_total = 0;
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_HISTOGRAM_H_
@@ -0,0 +1,235 @@
+#ifndef DITTO_INDEXED_PRIORITY_QUEUE_H_
+#define DITTO_INDEXED_PRIORITY_QUEUE_H_
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+
+namespace Ditto {
+
+/**
+ * @brief Statically allocated priority queue of the indices 0 to
+ * CAPACITY - 1, each queued at most once with a priority of type P.
+ *
+ * Besides the binary heap of queued indices, it keeps the position of every
+ * index in the heap, so the priority of a queued index can be looked up in
+ * O(1) and changed in O(log N). This is the decrease-key operation needed by
+ * Dijkstra-style searches, where the index is a graph vertex, or by timer
+ * queues that reschedule a timer identified by its slot in a table.
+ *
+ * Like Ditto::FixedHeap, top() is the index with the smallest priority
+ * according to Compare.
+ */
+template <std::default_initializable P, std::size_t CAPACITY,
+          class Compare = std::less<P>>
+class IndexedPriorityQueue {
+  static_assert(CAPACITY < std::numeric_limits<std::uint32_t>::max(),
+                "Too many indices for the position table");
+
+ public:
+  IndexedPriorityQueue() { m_position.fill(NOT_QUEUED); }
+  explicit IndexedPriorityQueue(const Compare& compare)
+      : m_compare(compare) {
+    m_position.fill(NOT_QUEUED);
+  }
+
+  IndexedPriorityQueue(const IndexedPriorityQueue&) = default;
+  IndexedPriorityQueue& operator=(const IndexedPriorityQueue&) = default;
+  IndexedPriorityQueue(IndexedPriorityQueue&&) = default;
+  IndexedPriorityQueue& operator=(IndexedPriorityQueue&&) = default;
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+  [[nodiscard]] static constexpr auto capacity() -> std::size_t {
+    return CAPACITY;
+  }
+
+  [[nodiscard]] auto contains(std::size_t index) const -> bool {
+    DITTO_VERIFY(index < CAPACITY);
+    return m_position[index] != NOT_QUEUED;
+  }
+
+  /**
+   * @brief Queues the index with the given priority in O(log N).
+   * @retval true if queued. false if the index was already queued, in which
+   * case its priority is left untouched.
+   */
+  auto push(std::size_t index, P priority) -> bool {
+    if (contains(index)) {
+      return false;
+    }
+    m_position[index] = static_cast<Index>(m_size);
+    m_heap[m_size] = Entry{std::move(priority), static_cast<Index>(index)};
+    m_size++;
+    sift_up(m_size - 1);
+    return true;
+  }
+
+  /**
+   * @brief Returns the priority of a queued index.
+   */
+  [[nodiscard]] auto priority(std::size_t index) const -> const P& {
+    DITTO_VERIFY(contains(index));
+    return m_heap[m_position[index]].priority;
+  }
+
+  /**
+   * @brief Lowers the priority of a queued index in O(log N). The new
+   * priority must not be larger than the current one.
+   */
+  void decrease_key(std::size_t index, P priority) {
+    DITTO_VERIFY(contains(index));
+    const std::size_t position = m_position[index];
+    DITTO_VERIFY(!m_compare(m_heap[position].priority, priority));
+    m_heap[position].priority = std::move(priority);
+    sift_up(position);
+  }
+
+  /**
+   * @brief Changes the priority of a queued index in O(log N), in either
+   * direction.
+   */
+  void update(std::size_t index, P priority) {
+    DITTO_VERIFY(contains(index));
+    const std::size_t position = m_position[index];
+    const bool decreased = m_compare(priority, m_heap[position].priority);
+    m_heap[position].priority = std::move(priority);
+    if (decreased) {
+      sift_up(position);
+    } else {
+      sift_down(position);
+    }
+  }
+
+  /**
+   * @brief Returns the index with the smallest priority. The queue must not be
+   * empty.
+   */
+  [[nodiscard]] auto top() const -> std::size_t {
+    DITTO_VERIFY(!empty());
+    return m_heap[0].index;
+  }
+
+  [[nodiscard]] auto top_priority() const -> const P& {
+    DITTO_VERIFY(!empty());
+    return m_heap[0].priority;
+  }
+
+  /**
+   * @brief Removes the index with the smallest priority and returns it.
+   * @retval The index if the queue was not empty. std::nullopt otherwise.
+   */
+  auto pop() -> std::optional<std::size_t> {
+    if (empty()) {
+      return std::nullopt;
+    }
+    const std::size_t index = m_heap[0].index;
+    remove_at(0);
+    return index;
+  }
+
+  /**
+   * @brief Removes a queued index in O(log N).
+   * @retval true if removed. false if the index was not queued.
+   */
+  auto erase(std::size_t index) -> bool {
+    if (!contains(index)) {
+      return false;
+    }
+    remove_at(m_position[index]);
+    return true;
+  }
+
+  void clear() {
+    for (std::size_t i = 0; i < m_size; i++) {
+      m_position[m_heap[i].index] = NOT_QUEUED;
+    }
+    m_size = 0;
+  }
+
+ private:
+  using Index = std::conditional_t<
+      (CAPACITY < std::numeric_limits<std::uint16_t>::max()), std::uint16_t,
+      std::uint32_t>;
+  static constexpr Index NOT_QUEUED = std::numeric_limits<Index>::max();
+
+  // Priorities are stored next to their index in the heap, so sifting only
+  // touches the heap and writes back the positions of the entries it moves
+  struct Entry {
+    P priority;
+    Index index;
+  };
+
+  std::array<Entry, CAPACITY> m_heap;
+  std::array<Index, CAPACITY> m_position;
+  std::size_t m_size = 0;
+  [[no_unique_address]] Compare m_compare;
+
+  void place(std::size_t position, Entry entry) {
+    m_position[entry.index] = static_cast<Index>(position);
+    m_heap[position] = std::move(entry);
+  }
+
+  void sift_up(std::size_t position) {
+    Entry entry = std::move(m_heap[position]);
+    while (position > 0) {
+      const std::size_t parent = (position - 1) / 2;
+      if (!m_compare(entry.priority, m_heap[parent].priority)) {
+        break;
+      }
+      place(position, std::move(m_heap[parent]));
+      position = parent;
+    }
+    place(position, std::move(entry));
+  }
+
+  void sift_down(std::size_t position) {
+    Entry entry = std::move(m_heap[position]);
+    while (true) {
+      std::size_t child = 2 * position + 1;
+      if (child >= m_size) {
+        break;
+      }
+      if ((child + 1 < m_size) &&
+          m_compare(m_heap[child + 1].priority, m_heap[child].priority)) {
+        child++;
+      }
+      if (!m_compare(m_heap[child].priority, entry.priority)) {
+        break;
+      }
+      place(position, std::move(m_heap[child]));
+      position = child;
+    }
+    place(position, std::move(entry));
+  }
+
+  // Fills the hole at position with the last entry, which may need to move
+  // up or down from there
+  void remove_at(std::size_t position) {
+    m_position[m_heap[position].index] = NOT_QUEUED;
+    m_size--;
+    if (position == m_size) {
+      return;
+    }
+    const bool smaller =
+        m_compare(m_heap[m_size].priority, m_heap[position].priority);
+    m_heap[position] = std::move(m_heap[m_size]);
+    if (smaller) {
+      sift_up(position);
+    } else {
+      sift_down(position);
+    }
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_INDEXED_PRIORITY_QUEUE_H_
@@ -0,0 +1,66 @@
+#ifndef DITTO_INTRUSIVE_HOOK_H_
+#define DITTO_INTRUSIVE_HOOK_H_
+
+#include <memory>
+#include <type_traits>
+
+namespace Ditto {
+namespace detail {
+
+/**
+ * @brief Base of the hooks that link objects into intrusive containers.
+ *
+ * Containers record the object a hook is embedded in when they link it, and
+ * use it to go back from a hook to its object. Subtracting the offset of the
+ * hook member instead cannot be done in standard C++ from a pointer to member
+ * without an object to apply it to.
+ */
+class IntrusiveHookBase {
+ protected:
+  IntrusiveHookBase() = default;
+  // Copies of a hook start unlinked, so the owner is not copied
+  IntrusiveHookBase(const IntrusiveHookBase& /*unused*/) {}
+  auto operator=(const IntrusiveHookBase& /*unused*/) -> IntrusiveHookBase& {
+    return *this;
+  }
+  ~IntrusiveHookBase() = default;
+
+ private:
+  void* m_owner = nullptr;
+
+  template <class T, class Hook, Hook T::*HOOK>
+  friend struct IntrusiveMember;
+};
+
+/**
+ * @brief Converts between objects of type T and the hook they embed as the
+ * HOOK member.
+ */
+template <class T, class Hook, Hook T::*HOOK>
+struct IntrusiveMember {
+  static_assert(std::is_base_of_v<IntrusiveHookBase, Hook>,
+                "Hooks must derive from IntrusiveHookBase");
+
+  /**
+   * @brief Returns the hook of the object, recording the object as its owner.
+   * Containers call it when linking the object.
+   */
+  static auto hook_to_link(T& object) -> Hook* {
+    Hook* hook = &(object.*HOOK);
+    static_cast<IntrusiveHookBase*>(hook)->m_owner = std::addressof(object);
+    return hook;
+  }
+
+  /**
+   * @brief Returns the object a linked hook is embedded in.
+   */
+  static auto owner_of(const Hook* hook) -> T* {
+    const auto* base = static_cast<const IntrusiveHookBase*>(hook);
+    return static_cast<T*>(base->m_owner);
+  }
+};
+
+}  // namespace detail
+}  // namespace Ditto
+
+#endif  // DITTO_INTRUSIVE_HOOK_H_
@@ -0,0 +1,301 @@
+#ifndef DITTO_INTRUSIVE_LIST_H_
+#define DITTO_INTRUSIVE_LIST_H_
+
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+#include "ditto/intrusive_hook.h"
+
+namespace Ditto {
+
+/**
+ * @brief Links an object into a Ditto::IntrusiveList. Objects embed one hook
+ * for each list they can be in at the same time.
+ *
+ * Copying an object does not copy its links: the copy starts unlinked. An
+ * object must be removed from its list before it is destroyed.
+ */
+class IntrusiveListHook : public detail::IntrusiveHookBase {
+ public:
+  IntrusiveListHook() = default;
+  IntrusiveListHook(const IntrusiveListHook& /*unused*/)
+      : IntrusiveHookBase() {}
+  auto operator=(const IntrusiveListHook& /*unused*/) -> IntrusiveListHook& {
+    return *this;
+  }
+
+  ~IntrusiveListHook() { DITTO_VERIFY(!is_linked()); }
+
+  [[nodiscard]] auto is_linked() const -> bool { return m_next != nullptr; }
+
+ private:
+  IntrusiveListHook* m_prev = nullptr;
+  IntrusiveListHook* m_next = nullptr;
+
+  template <class T, IntrusiveListHook T::*HOOK>
+  friend class IntrusiveList;
+};
+
+/**
+ * @brief Doubly-linked list of objects that embed an IntrusiveListHook as the
+ * HOOK member.
+ *
+ * The list never allocates nor owns its elements: it links the objects
+ * themselves, so pushing and erasing are O(1) and cannot fail, and an element
+ * can be unlinked with remove() knowing only the object. The caller is
+ * responsible for keeping linked objects alive.
+ *
+ * Example:
+ *   struct Request {
+ *     int id;
+ *     Ditto::IntrusiveListHook hook;
+ *   };
+ *   Ditto::IntrusiveList<Request, &Request::hook> pending;
+ */
+template <class T, IntrusiveListHook T::*HOOK>
+class IntrusiveList {
+  template <bool CONST>
+  class Iterator {
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = std::conditional_t<CONST, const T*, T*>;
+    using reference = std::conditional_t<CONST, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    Iterator() = default;
+
+    template <bool OTHER_CONST,
+              std::enable_if_t<CONST && !OTHER_CONST, bool> = false>
+    Iterator(const Iterator<OTHER_CONST>& other) : m_hook(other.m_hook) {}
+
+    auto operator++() -> Iterator& {
+      m_hook = m_hook->m_next;
+      return *this;
+    }
+
+    auto operator++(int) -> Iterator {
+      Iterator current = *this;
+      ++*this;
+      return current;
+    }
+
+    auto operator--() -> Iterator& {
+      m_hook = m_hook->m_prev;
+      return *this;
+    }
+
+    auto operator--(int) -> Iterator {
+      Iterator current = *this;
+      --*this;
+      return current;
+    }
+
+    [[nodiscard]] auto operator*() const -> reference {
+      return *owner_of(m_hook);
+    }
+    [[nodiscard]] auto operator->() const -> pointer {
+      return owner_of(m_hook);
+    }
+
+    template <bool OTHER_CONST>
+    [[nodiscard]] auto operator==(const Iterator<OTHER_CONST>& other) const
+        -> bool {
+      return m_hook == other.m_hook;
+    }
+
+   private:
+    IntrusiveListHook* m_hook = nullptr;
+
+    explicit Iterator(IntrusiveListHook* hook) : m_hook(hook) {}
+
+    template <bool>
+    friend class Iterator;
+
+    friend IntrusiveList;
+  };
+
+ public:
+  using value_type = T;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using difference_type = std::ptrdiff_t;
+  using size_type = std::size_t;
+
+  IntrusiveList() { reset(); }
+
+  IntrusiveList(IntrusiveList&& other) noexcept { take(other); }
+
+  auto operator=(IntrusiveList&& other) noexcept -> IntrusiveList& {
+    if (this != &other) {
+      clear();
+      take(other);
+    }
+    return *this;
+  }
+
+  IntrusiveList(const IntrusiveList&) = delete;
+  auto operator=(const IntrusiveList&) -> IntrusiveList& = delete;
+
+  ~IntrusiveList() {
+    clear();
+    // The sentinel is linked to itself, unlink it before it is destroyed
+    m_root.m_prev = nullptr;
+    m_root.m_next = nullptr;
+  }
+
+  [[nodiscard]] auto begin() -> iterator { return iterator{m_root.m_next}; }
+  [[nodiscard]] auto end() -> iterator { return iterator{&m_root}; }
+  [[nodiscard]] auto begin() const -> const_iterator {
+    return const_iterator{m_root.m_next};
+  }
+  [[nodiscard]] auto end() const -> const_iterator {
+    return const_iterator{root()};
+  }
+  [[nodiscard]] auto cbegin() const -> const_iterator { return begin(); }
+  [[nodiscard]] auto cend() const -> const_iterator { return end(); }
+
+  [[nodiscard]] auto rbegin() -> reverse_iterator {
+    return reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
+  [[nodiscard]] auto rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  [[nodiscard]] auto front() -> reference { return *owner_of(m_root.m_next); }
+  [[nodiscard]] auto front() const -> const_reference {
+    return *owner_of(m_root.m_next);
+  }
+  [[nodiscard]] auto back() -> reference { return *owner_of(m_root.m_prev); }
+  [[nodiscard]] auto back() const -> const_reference {
+    return *owner_of(m_root.m_prev);
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> size_type { return m_size; }
+
+  /**
+   * @brief Returns an iterator to an element of this list.
+   */
+  [[nodiscard]] auto iterator_to(T& element) -> iterator {
+    DITTO_VERIFY((element.*HOOK).is_linked());
+    return iterator{&(element.*HOOK)};
+  }
+
+  // Links the element before the passed iterator and returns an iterator to it
+  auto insert(const_iterator pos, T& element) -> iterator {
+    DITTO_VERIFY(!(element.*HOOK).is_linked());
+    IntrusiveListHook* hook = Member::hook_to_link(element);
+    IntrusiveListHook* next = pos.m_hook;
+    hook->m_next = next;
+    hook->m_prev = next->m_prev;
+    next->m_prev->m_next = hook;
+    next->m_prev = hook;
+    m_size++;
+    return iterator{hook};
+  }
+
+  void push_back(T& element) { insert(end(), element); }
+  void push_front(T& element) { insert(begin(), element); }
+
+  void pop_back() {
+    if (!empty()) {
+      unlink(m_root.m_prev);
+    }
+  }
+
+  void pop_front() {
+    if (!empty()) {
+      unlink(m_root.m_next);
+    }
+  }
+
+  // Unlinks the element at the passed iterator and returns the next one
+  auto erase(const_iterator pos) -> iterator {
+    if (pos == cend()) {
+      return end();
+    }
+    IntrusiveListHook* next = pos.m_hook->m_next;
+    unlink(pos.m_hook);
+    return iterator{next};
+  }
+
+  /**
+   * @brief Unlinks an element of this list in O(1).
+   */
+  void remove(T& element) {
+    DITTO_VERIFY((element.*HOOK).is_linked());
+    unlink(&(element.*HOOK));
+  }
+
+  void clear() {
+    IntrusiveListHook* hook = m_root.m_next;
+    while (hook != &m_root) {
+      IntrusiveListHook* next = hook->m_next;
+      hook->m_prev = nullptr;
+      hook->m_next = nullptr;
+      hook = next;
+    }
+    reset();
+  }
+
+ private:
+  // Sentinel of the circular list, so that linking and unlinking need no
+  // special cases for the first and last elements
+  IntrusiveListHook m_root;
+  size_type m_size = 0;
+
+  [[nodiscard]] auto root() const -> IntrusiveListHook* {
+    return const_cast<IntrusiveListHook*>(&m_root);
+  }
+
+  using Member = detail::IntrusiveMember<T, IntrusiveListHook, HOOK>;
+
+  static auto owner_of(const IntrusiveListHook* hook) -> T* {
+    return Member::owner_of(hook);
+  }
+
+  void reset() {
+    m_root.m_prev = &m_root;
+    m_root.m_next = &m_root;
+    m_size = 0;
+  }
+
+  void unlink(IntrusiveListHook* hook) {
+    hook->m_prev->m_next = hook->m_next;
+    hook->m_next->m_prev = hook->m_prev;
+    hook->m_prev = nullptr;
+    hook->m_next = nullptr;
+    m_size--;
+  }
+
+  void take(IntrusiveList& other) {
+    if (other.empty()) {
+      reset();
+      return;
+    }
+    m_root.m_next = other.m_root.m_next;
+    m_root.m_prev = other.m_root.m_prev;
+    m_root.m_next->m_prev = &m_root;
+    m_root.m_prev->m_next = &m_root;
+    m_size = other.m_size;
+    other.reset();
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_INTRUSIVE_LIST_H_
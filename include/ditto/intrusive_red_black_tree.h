@@ -0,0 +1,403 @@
+#ifndef DITTO_INTRUSIVE_RED_BLACK_TREE_H_
+#define DITTO_INTRUSIVE_RED_BLACK_TREE_H_
+
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+#include "ditto/intrusive_hook.h"
+#include "ditto/red_black_tree_algorithms.h"
+
+namespace Ditto {
+
+/**
+ * @brief Links an object into a Ditto::IntrusiveRedBlackTree. Objects embed
+ * one hook for each tree they can be in at the same time.
+ *
+ * Copying an object does not copy its links: the copy starts unlinked. An
+ * object must be removed from its tree before it is destroyed.
+ */
+class IntrusiveRedBlackTreeHook : public detail::IntrusiveHookBase {
+ public:
+  IntrusiveRedBlackTreeHook() = default;
+  IntrusiveRedBlackTreeHook(const IntrusiveRedBlackTreeHook& /*unused*/)
+      : IntrusiveHookBase() {}
+  auto operator=(const IntrusiveRedBlackTreeHook& /*unused*/)
+      -> IntrusiveRedBlackTreeHook& {
+    return *this;
+  }
+
+  ~IntrusiveRedBlackTreeHook() { DITTO_VERIFY(!is_linked()); }
+
+  [[nodiscard]] auto is_linked() const -> bool {
+    return color_and_parent.pointer() != this;
+  }
+
+ private:
+  // Unlinked hooks are their own parent, since the root of a tree has none
+  PointerAndColor<IntrusiveRedBlackTreeHook> color_and_parent{this};
+  IntrusiveRedBlackTreeHook* left = nullptr;
+  IntrusiveRedBlackTreeHook* right = nullptr;
+
+  void reset() {
+    color_and_parent.set_pointer(this);
+    left = nullptr;
+    right = nullptr;
+  }
+
+  template <class Node>
+  friend struct detail::RedBlackTreeAlgorithms;
+
+  template <class T, IntrusiveRedBlackTreeHook T::*HOOK, class Compare>
+  friend class IntrusiveRedBlackTree;
+};
+
+/**
+ * @brief Red-black tree of objects that embed an IntrusiveRedBlackTreeHook as
+ * the HOOK member, ordered by Compare.
+ *
+ * The tree never allocates nor owns its elements: it links the objects
+ * themselves, so inserting and removing cannot fail, and an element can be
+ * removed in O(log N) knowing only the object. Elements that compare equal
+ * are kept in insertion order. The smallest element is tracked, so front()
+ * is O(1), which makes it a good fit for timer queues. The caller is
+ * responsible for keeping linked objects alive.
+ *
+ * Example:
+ *   struct Timer {
+ *     std::uint64_t deadline;
+ *     Ditto::IntrusiveRedBlackTreeHook hook;
+ *   };
+ *   struct ByDeadline {
+ *     auto operator()(const Timer& a, const Timer& b) const -> bool {
+ *       return a.deadline < b.deadline;
+ *     }
+ *   };
+ *   Ditto::IntrusiveRedBlackTree<Timer, &Timer::hook, ByDeadline> timers;
+ */
+template <class T, IntrusiveRedBlackTreeHook T::*HOOK,
+          class Compare = std::less<T>>
+class IntrusiveRedBlackTree {
+  using Hook = IntrusiveRedBlackTreeHook;
+  using Algorithms = detail::RedBlackTreeAlgorithms<Hook>;
+
+  template <bool CONST>
+  class Iterator {
+    using Tree = std::conditional_t<CONST, const IntrusiveRedBlackTree,
+                                    IntrusiveRedBlackTree>;
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = std::conditional_t<CONST, const T*, T*>;
+    using reference = std::conditional_t<CONST, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    Iterator() = default;
+
+    template <bool OTHER_CONST,
+              std::enable_if_t<CONST && !OTHER_CONST, bool> = false>
+    Iterator(const Iterator<OTHER_CONST>& other)
+        : m_tree(other.m_tree), m_hook(other.m_hook) {}
+
+    auto operator++() -> Iterator& {
+      m_hook = Algorithms::successor(m_hook);
+      return *this;
+    }
+
+    auto operator++(int) -> Iterator {
+      Iterator current = *this;
+      ++*this;
+      return current;
+    }
+
+    auto operator--() -> Iterator& {
+      if (m_hook == nullptr) {
+        // Decrementing end()
+        m_hook = Algorithms::rightmost(m_tree->m_root);
+      } else {
+        m_hook = Algorithms::predecessor(m_hook);
+      }
+      return *this;
+    }
+
+    auto operator--(int) -> Iterator {
+      Iterator current = *this;
+      --*this;
+      return current;
+    }
+
+    [[nodiscard]] auto operator*() const -> reference {
+      return *owner_of(m_hook);
+    }
+    [[nodiscard]] auto operator->() const -> pointer {
+      return owner_of(m_hook);
+    }
+
+    template <bool OTHER_CONST>
+    [[nodiscard]] auto operator==(const Iterator<OTHER_CONST>& other) const
+        -> bool {
+      return m_hook == other.m_hook;
+    }
+
+   private:
+    Tree* m_tree = nullptr;
+    Hook* m_hook = nullptr;
+
+    Iterator(Tree* tree, Hook* hook) : m_tree(tree), m_hook(hook) {}
+
+    template <bool>
+    friend class Iterator;
+
+    friend IntrusiveRedBlackTree;
+  };
+
+ public:
+  using value_type = T;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using difference_type = std::ptrdiff_t;
+  using size_type = std::size_t;
+
+  IntrusiveRedBlackTree() = default;
+  explicit IntrusiveRedBlackTree(const Compare& compare)
+      : m_compare(compare) {}
+
+  IntrusiveRedBlackTree(IntrusiveRedBlackTree&& other) noexcept
+      : m_compare(std::move(other.m_compare)),
+        m_root(std::exchange(other.m_root, nullptr)),
+        m_min(std::exchange(other.m_min, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  auto operator=(IntrusiveRedBlackTree&& other) noexcept
+      -> IntrusiveRedBlackTree& {
+    if (this != &other) {
+      clear();
+      m_compare = std::move(other.m_compare);
+      m_root = std::exchange(other.m_root, nullptr);
+      m_min = std::exchange(other.m_min, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+  }
+
+  IntrusiveRedBlackTree(const IntrusiveRedBlackTree&) = delete;
+  auto operator=(const IntrusiveRedBlackTree&)
+      -> IntrusiveRedBlackTree& = delete;
+
+  ~IntrusiveRedBlackTree() { clear(); }
+
+  [[nodiscard]] auto begin() -> iterator { return iterator{this, m_min}; }
+  [[nodiscard]] auto end() -> iterator { return iterator{this, nullptr}; }
+  [[nodiscard]] auto begin() const -> const_iterator {
+    return const_iterator{this, m_min};
+  }
+  [[nodiscard]] auto end() const -> const_iterator {
+    return const_iterator{this, nullptr};
+  }
+  [[nodiscard]] auto cbegin() const -> const_iterator { return begin(); }
+  [[nodiscard]] auto cend() const -> const_iterator { return end(); }
+
+  [[nodiscard]] auto rbegin() -> reverse_iterator {
+    return reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
+  [[nodiscard]] auto rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  /**
+   * @brief Returns the smallest element in O(1).
+   */
+  [[nodiscard]] auto front() -> reference { return *owner_of(m_min); }
+  [[nodiscard]] auto front() const -> const_reference {
+    return *owner_of(m_min);
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> size_type { return m_size; }
+
+  /**
+   * @brief Returns an iterator to an element of this tree.
+   */
+  [[nodiscard]] auto iterator_to(T& element) -> iterator {
+    DITTO_VERIFY((element.*HOOK).is_linked());
+    return iterator{this, &(element.*HOOK)};
+  }
+
+  /**
+   * @brief Links the element after the elements that compare equal to it and
+   * returns an iterator to it.
+   */
+  auto insert(T& element) -> iterator;
+
+  /**
+   * @brief Unlinks an element of this tree.
+   */
+  void remove(T& element) {
+    DITTO_VERIFY((element.*HOOK).is_linked());
+    unlink(&(element.*HOOK));
+  }
+
+  // Unlinks the element at the passed iterator and returns the next one
+  auto erase(const_iterator pos) -> iterator {
+    if (pos == cend()) {
+      return end();
+    }
+    Hook* next = Algorithms::successor(pos.m_hook);
+    unlink(pos.m_hook);
+    return iterator{this, next};
+  }
+
+  void pop_front() {
+    if (!empty()) {
+      unlink(m_min);
+    }
+  }
+
+  /**
+   * @brief Returns an iterator to the first element that does not compare
+   * less than value.
+   */
+  [[nodiscard]] auto lower_bound(const T& value) -> iterator {
+    return iterator{this, lower_bound_hook(value)};
+  }
+  [[nodiscard]] auto lower_bound(const T& value) const -> const_iterator {
+    return const_iterator{this, lower_bound_hook(value)};
+  }
+
+  /**
+   * @brief Returns an iterator to the first element that compares greater
+   * than value.
+   */
+  [[nodiscard]] auto upper_bound(const T& value) -> iterator {
+    return iterator{this, upper_bound_hook(value)};
+  }
+  [[nodiscard]] auto upper_bound(const T& value) const -> const_iterator {
+    return const_iterator{this, upper_bound_hook(value)};
+  }
+
+  void clear();
+
+ private:
+  [[no_unique_address]] Compare m_compare;
+  Hook* m_root = nullptr;
+  // Leftmost element, so that front() does not walk down the tree
+  Hook* m_min = nullptr;
+  size_type m_size = 0;
+
+  using Member = detail::IntrusiveMember<T, Hook, HOOK>;
+
+  static auto owner_of(const Hook* hook) -> T* {
+    return Member::owner_of(hook);
+  }
+
+  void unlink(Hook* hook) {
+    if (hook == m_min) {
+      m_min = Algorithms::successor(hook);
+    }
+    Algorithms::unlink(m_root, hook);
+    hook->reset();
+    m_size--;
+  }
+
+  [[nodiscard]] auto lower_bound_hook(const T& value) const -> Hook*;
+  [[nodiscard]] auto upper_bound_hook(const T& value) const -> Hook*;
+};
+
+template <class T, IntrusiveRedBlackTreeHook T::*HOOK, class Compare>
+auto IntrusiveRedBlackTree<T, HOOK, Compare>::insert(T& element) -> iterator {
+  DITTO_VERIFY(!(element.*HOOK).is_linked());
+  Hook* hook = Member::hook_to_link(element);
+
+  Hook* parent = nullptr;
+  Hook** link = &m_root;
+  bool is_leftmost = true;
+  while (*link != nullptr) {
+    parent = *link;
+    if (m_compare(element, *owner_of(parent))) {
+      link = &parent->left;
+    } else {
+      link = &parent->right;
+      is_leftmost = false;
+    }
+  }
+
+  hook->color_and_parent = PointerAndColor<Hook>{parent, NodeColor::RED};
+  *link = hook;
+  if (is_leftmost) {
+    m_min = hook;
+  }
+  Algorithms::fixup_insertion(m_root, hook);
+  m_size++;
+  return iterator{this, hook};
+}
+
+template <class T, IntrusiveRedBlackTreeHook T::*HOOK, class Compare>
+void IntrusiveRedBlackTree<T, HOOK, Compare>::clear() {
+  // Rotate left children up while unlinking the hooks left without one, so
+  // that the whole tree is visited without recursion nor an auxiliary stack
+  Hook* hook = std::exchange(m_root, nullptr);
+  while (hook != nullptr) {
+    if (hook->left != nullptr) {
+      Hook* left = hook->left;
+      hook->left = left->right;
+      left->right = hook;
+      hook = left;
+    } else {
+      Hook* right = hook->right;
+      hook->reset();
+      hook = right;
+    }
+  }
+  m_min = nullptr;
+  m_size = 0;
+}
+
+template <class T, IntrusiveRedBlackTreeHook T::*HOOK, class Compare>
+auto IntrusiveRedBlackTree<T, HOOK, Compare>::lower_bound_hook(
+    const T& value) const -> Hook* {
+  Hook* hook = m_root;
+  Hook* candidate = nullptr;
+  while (hook != nullptr) {
+    if (m_compare(*owner_of(hook), value)) {
+      hook = hook->right;
+    } else {
+      candidate = hook;
+      hook = hook->left;
+    }
+  }
+  return candidate;
+}
+
+template <class T, IntrusiveRedBlackTreeHook T::*HOOK, class Compare>
+auto IntrusiveRedBlackTree<T, HOOK, Compare>::upper_bound_hook(
+    const T& value) const -> Hook* {
+  Hook* hook = m_root;
+  Hook* candidate = nullptr;
+  while (hook != nullptr) {
+    if (m_compare(value, *owner_of(hook))) {
+      candidate = hook;
+      hook = hook->left;
+    } else {
+      hook = hook->right;
+    }
+  }
+  return candidate;
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_INTRUSIVE_RED_BLACK_TREE_H_
@@ -2,17 +2,20 @@
 #define DITTO_LINKED_LIST_H_
 
 #include <cstddef>
+#include <functional>
 #include <iterator>
 #include <memory>
 #include <type_traits>
 #include <utility>
 
+#include "ditto/assert.h"
+
 namespace Ditto {
 
 template <class T>
 struct LinkedListNode {
   T m_element;
-  std::unique_ptr<LinkedListNode> m_next;
+  LinkedListNode* m_next = nullptr;
   LinkedListNode* m_prev = nullptr;
 
  public:
@@ -108,7 +111,7 @@ class LinkedListIterator {
 
   auto move_to_next() {
     if (m_current) {
-      m_current = m_current->m_next.get();
+      m_current = m_current->m_next;
     }
   }
 
@@ -118,14 +121,21 @@ class LinkedListIterator {
     }
   }
 
-  template <class U>
+  template <class U, class Allocator>
   friend class LinkedList;
 
   template <class U, bool REV>
   friend class LinkedListIterator;
 };
 
-template <class T>
+/**
+ * @brief Doubly-linked list.
+ *
+ * Nodes are obtained from Allocator, rebound to the node type, so that the
+ * list can use a pool like Ditto::FixedPoolAllocator instead of the heap.
+ * Nodes are released iteratively, so destroying a long list does not recurse.
+ */
+template <class T, class Allocator = std::allocator<std::remove_const_t<T>>>
 class LinkedList {
  public:
   using value_type = T;
@@ -141,19 +151,52 @@ class LinkedList {
   // Node elements should not be constant so that they can always be used by
   // iterators and converted
   using Node = LinkedListNode<std::remove_const_t<T>>;
+  using allocator_type = Allocator;
 
   LinkedList() = default;
+  explicit LinkedList(const Allocator& allocator) : m_allocator(allocator) {}
+
+  LinkedList(LinkedList&& other) noexcept
+      : m_allocator(std::move(other.m_allocator)),
+        m_head(std::exchange(other.m_head, nullptr)),
+        m_tail(std::exchange(other.m_tail, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  auto operator=(LinkedList&& other) noexcept -> LinkedList& {
+    if (this != &other) {
+      clear();
+      if constexpr (NodeAllocatorTraits::
+                        propagate_on_container_move_assignment::value) {
+        m_allocator = std::move(other.m_allocator);
+      } else {
+        DITTO_VERIFY(m_allocator == other.m_allocator);
+      }
+      m_head = std::exchange(other.m_head, nullptr);
+      m_tail = std::exchange(other.m_tail, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+  }
+
+  LinkedList(const LinkedList&) = delete;
+  auto operator=(const LinkedList&) -> LinkedList& = delete;
+
+  ~LinkedList() { clear(); }
+
+  [[nodiscard]] auto get_allocator() const -> allocator_type {
+    return allocator_type{m_allocator};
+  }
 
-  [[nodiscard]] auto begin() -> iterator { return iterator{m_head.get()}; }
+  [[nodiscard]] auto begin() -> iterator { return iterator{m_head}; }
   [[nodiscard]] auto end() -> iterator { return iterator{nullptr}; }
   [[nodiscard]] auto begin() const -> const_iterator {
-    return const_iterator{m_head.get()};
+    return const_iterator{m_head};
   }
   [[nodiscard]] auto end() const -> const_iterator {
     return const_iterator{nullptr};
   }
   [[nodiscard]] auto cbegin() const -> const_iterator {
-    return const_iterator{m_head.get()};
+    return const_iterator{m_head};
   }
   [[nodiscard]] auto cend() const -> const_iterator {
     return const_iterator{nullptr};
@@ -187,9 +230,9 @@ class LinkedList {
     return m_tail->m_element;
   }
 
-  [[nodiscard]] auto front_iter() -> iterator { return iterator{m_head.get()}; }
+  [[nodiscard]] auto front_iter() -> iterator { return iterator{m_head}; }
   [[nodiscard]] auto front_iter() const -> const_iterator {
-    return const_iterator{m_head.get()};
+    return const_iterator{m_head};
   }
   [[nodiscard]] auto back_iter() -> iterator { return iterator{m_tail}; }
   [[nodiscard]] auto back_iter() const -> const_iterator {
@@ -200,59 +243,68 @@ class LinkedList {
   [[nodiscard]] auto size() const -> size_type { return m_size; }
 
   auto clear() {
-    m_head.reset();
+    Node* node = m_head;
+    while (node != nullptr) {
+      Node* next = node->m_next;
+      destroy_node(node);
+      node = next;
+    }
+    m_head = nullptr;
     m_tail = nullptr;
     m_size = 0;
   }
 
   // Inserts an element before the passed iterator and returns an iterator to it
   iterator insert(const_iterator iter, const T& value) {
-    return put_at(iter, std::make_unique<Node>(value));
+    return put_at(iter, create_node(value));
   }
 
   // Inserts an element before the passed iterator and returns an iterator to it
   template <class... Args>
   iterator emplace(const_iterator iter, Args&&... args) {
-    return put_at(iter, std::make_unique<Node>(std::forward<Args>(args)...));
+    return put_at(iter, create_node(std::forward<Args>(args)...));
   }
 
-  void push_back(T element) {
-    put_back(std::make_unique<Node>(std::move(element)));
-  }
+  void push_back(T element) { put_back(create_node(std::move(element))); }
 
-  void push_front(T element) { put_front(std::make_unique<Node>(element)); }
+  void push_front(T element) { put_front(create_node(std::move(element))); }
 
   template <class... Args>
   void emplace_back(Args&&... args) {
-    put_back(std::make_unique<Node>(std::forward<Args>(args)...));
+    put_back(create_node(std::forward<Args>(args)...));
   }
 
   template <class... Args>
   void emplace_front(Args&&... args) {
-    put_front(std::make_unique<Node>(std::forward<Args>(args)...));
+    put_front(create_node(std::forward<Args>(args)...));
   }
 
   void pop_back() {
     if (m_tail) {
-      if (Node* new_tail = m_tail->m_prev) {
-        m_tail = new_tail;
-        m_tail->m_next.reset();
+      Node* old_tail = m_tail;
+      m_tail = old_tail->m_prev;
+      if (m_tail) {
+        m_tail->m_next = nullptr;
       } else {
-        // There's only one element
-        m_head.reset();
-        m_tail = nullptr;
+        // There was only one element
+        m_head = nullptr;
       }
+      destroy_node(old_tail);
       m_size--;
     }
   }
 
   void pop_front() {
     if (m_head) {
-      auto new_head = std::move(m_head->m_next);
-      m_head = std::move(new_head);
+      Node* old_head = m_head;
+      m_head = old_head->m_next;
       if (m_head) {
         m_head->m_prev = nullptr;
+      } else {
+        // There was only one element
+        m_tail = nullptr;
       }
+      destroy_node(old_head);
       m_size--;
     }
   }
@@ -263,7 +315,7 @@ class LinkedList {
       return end();
     }
 
-    if (pos.m_current == m_head.get()) {
+    if (pos.m_current == m_head) {
       pop_front();
       return begin();
     }
@@ -273,63 +325,170 @@ class LinkedList {
       return end();
     }
 
-    auto deleted_element = std::move(pos.m_current->m_prev->m_next);
-    deleted_element->m_next->m_prev = deleted_element->m_prev;
-    deleted_element->m_prev->m_next = std::move(deleted_element->m_next);
+    Node* deleted_element = pos.m_current;
+    Node* next = deleted_element->m_next;
+    next->m_prev = deleted_element->m_prev;
+    deleted_element->m_prev->m_next = next;
+    destroy_node(deleted_element);
     m_size--;
-    return iterator{deleted_element->m_prev->m_next.get()};
+    return iterator{next};
+  }
+
+  /**
+   * @brief Moves all the elements of other before pos in O(1). Elements are
+   * relinked, not copied nor reallocated, so both lists must use allocators
+   * that compare equal.
+   */
+  void splice(const_iterator pos, LinkedList& other) {
+    if ((this == &other) || other.empty()) {
+      return;
+    }
+    DITTO_VERIFY(m_allocator == other.m_allocator);
+    Node* first = other.m_head;
+    Node* last = other.m_tail;
+    const size_type count = other.m_size;
+    other.unlink_range(first, last, count);
+    link_range(pos.m_current, first, last, count);
+  }
+
+  // Moves the element at iter from other before pos in O(1)
+  void splice(const_iterator pos, LinkedList& other, const_iterator iter) {
+    DITTO_VERIFY(m_allocator == other.m_allocator);
+    Node* node = iter.m_current;
+    if ((this == &other) &&
+        ((node == pos.m_current) || (node->m_next == pos.m_current))) {
+      // Already in place
+      return;
+    }
+    other.unlink_range(node, node, 1);
+    link_range(pos.m_current, node, node, 1);
+  }
+
+  /**
+   * @brief Moves the elements in [first, last) from other before pos, which
+   * must not be in that range. It is O(1) within the same list and linear in
+   * the number of elements moved otherwise, since they need to be counted.
+   */
+  void splice(const_iterator pos, LinkedList& other, const_iterator first,
+              const_iterator last) {
+    if (first == last) {
+      return;
+    }
+    DITTO_VERIFY(m_allocator == other.m_allocator);
+    Node* first_node = first.m_current;
+    Node* last_node = last.m_current ? last.m_current->m_prev : other.m_tail;
+    const size_type count =
+        (this == &other) ? 0
+                         : static_cast<size_type>(std::distance(first, last));
+    other.unlink_range(first_node, last_node, count);
+    link_range(pos.m_current, first_node, last_node, count);
+  }
+
+  /**
+   * @brief Merges other into this list. Both lists must be sorted according
+   * to comp, and so is the result. Nodes are relinked like in splice(), and
+   * the merge is stable: equivalent elements of this list go first.
+   */
+  template <class Compare = std::less<>>
+  void merge(LinkedList& other, Compare comp = {}) {
+    if (this == &other) {
+      return;
+    }
+    DITTO_VERIFY(m_allocator == other.m_allocator);
+
+    Node* current = m_head;
+    while (other.m_head != nullptr) {
+      while ((current != nullptr) &&
+             !comp(other.m_head->m_element, current->m_element)) {
+        current = current->m_next;
+      }
+      if (current == nullptr) {
+        splice(cend(), other);
+        return;
+      }
+
+      // Move the whole run of elements of other that go before current
+      Node* first = other.m_head;
+      Node* last = first;
+      size_type count = 1;
+      while ((last->m_next != nullptr) &&
+             comp(last->m_next->m_element, current->m_element)) {
+        last = last->m_next;
+        count++;
+      }
+      other.unlink_range(first, last, count);
+      link_range(current, first, last, count);
+    }
   }
 
  private:
-  std::unique_ptr<Node> m_head;
+  using NodeAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node>;
+  using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
+
+  [[no_unique_address]] NodeAllocator m_allocator;
+  Node* m_head = nullptr;
   Node* m_tail = nullptr;
   size_type m_size = 0;
 
-  void put_front(std::unique_ptr<Node> new_head) {
-    new_head->m_next = std::move(m_head);
-    if (new_head->m_next) {
-      new_head->m_next->m_prev = new_head.get();
+  template <class... Args>
+  auto create_node(Args&&... args) -> Node* {
+    Node* node = NodeAllocatorTraits::allocate(m_allocator, 1);
+    NodeAllocatorTraits::construct(m_allocator, node,
+                                   std::forward<Args>(args)...);
+    return node;
+  }
+
+  void destroy_node(Node* node) {
+    NodeAllocatorTraits::destroy(m_allocator, node);
+    NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+  }
+
+  void put_front(Node* new_head) { link_range(m_head, new_head, new_head, 1); }
+
+  void put_back(Node* node) { link_range(nullptr, node, node, 1); }
+
+  iterator put_at(const_iterator iter, Node* new_node) {
+    link_range(iter.m_current, new_node, new_node, 1);
+    return iterator{new_node};
+  }
+
+  // Links the chain of count nodes from first to last before pos, or at the
+  // end of the list if pos is nullptr
+  void link_range(Node* pos, Node* first, Node* last, size_type count) {
+    Node* prev = pos ? pos->m_prev : m_tail;
+    first->m_prev = prev;
+    last->m_next = pos;
+    if (prev) {
+      prev->m_next = first;
+    } else {
+      m_head = first;
     }
-    m_head = std::move(new_head);
-    if (m_tail == nullptr) {
-      m_tail = m_head.get();
+    if (pos) {
+      pos->m_prev = last;
+    } else {
+      m_tail = last;
     }
-    m_size++;
+    m_size += count;
   }
 
-  void put_back(std::unique_ptr<Node> node) {
-    node->m_prev = m_tail;
-    if (m_tail) {
-      m_tail->m_next = std::move(node);
-      m_tail = m_tail->m_next.get();
+  // Detaches the chain of count nodes from first to last from the list
+  void unlink_range(Node* first, Node* last, size_type count) {
+    Node* prev = first->m_prev;
+    Node* next = last->m_next;
+    if (prev) {
+      prev->m_next = next;
     } else {
-      m_head = std::move(node);
-      m_tail = m_head.get();
+      m_head = next;
     }
-    m_size++;
-  }
-
-  iterator put_at(const_iterator iter, std::unique_ptr<Node> new_node) {
-    Node* current = iter.m_current;
-    if (current) {
-      if (Node* prev = current->m_prev) {
-        new_node->m_next = std::move(prev->m_next);
-        new_node->m_prev = prev;
-        if (new_node->m_next) {
-          current->m_prev = new_node.get();
-        }
-        prev->m_next = std::move(new_node);
-        m_size++;
-        return iterator{prev->m_next.get()};
-      } else {
-        put_front(std::move(new_node));
-        return begin();
-      }
+    if (next) {
+      next->m_prev = prev;
     } else {
-      // We are at the beginning of the list already
-      put_back(std::move(new_node));
-      return iterator{m_tail};
+      m_tail = prev;
     }
+    first->m_prev = nullptr;
+    last->m_next = nullptr;
+    m_size -= count;
   }
 };
 
@@ -0,0 +1,425 @@
+#ifndef DITTO_LOCK_PROFILING_H_
+#define DITTO_LOCK_PROFILING_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+
+#include "ditto/histogram.h"
+#include "ditto/resource_lock.h"
+#include "ditto/stack_trace.h"
+
+namespace Ditto {
+
+namespace detail {
+
+template <class M>
+concept TryLockable = requires(M m) {
+  { m.try_lock() } -> std::convertible_to<bool>;
+};
+
+template <class M>
+concept TrySharedLockable = requires(M m) {
+  m.lock_shared();
+  { m.try_lock_shared() } -> std::convertible_to<bool>;
+  m.unlock_shared();
+};
+
+}  // namespace detail
+
+/**
+ * @brief Contention statistics of a single lock, registered in a global
+ * registry for as long as the lock exists.
+ *
+ * Acquisition counters are updated atomically, since shared lockers update
+ * them concurrently. Hold times are only measured for exclusive locks. They
+ * are guarded by a mutex of their own, so that they can be read while the
+ * lock is in use.
+ */
+class LockProfile {
+ public:
+  static constexpr std::size_t MAX_CALLERS = 4;
+  using HoldTimeHistogram = Log2Histogram<32>;
+
+  LockProfile() { registry().add(this); }
+  ~LockProfile() { registry().remove(this); }
+
+  LockProfile(const LockProfile&) = delete;
+  LockProfile(LockProfile&&) = delete;
+  auto operator=(const LockProfile&) -> LockProfile& = delete;
+  auto operator=(LockProfile&&) -> LockProfile& = delete;
+
+  [[nodiscard]] auto acquisitions() const -> std::uint64_t {
+    return m_acquisitions.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Returns how many acquisitions found the lock already taken.
+   */
+  [[nodiscard]] auto contended_acquisitions() const -> std::uint64_t {
+    return m_contended_acquisitions.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] auto total_wait_time() const -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{
+        m_total_wait_ns.load(std::memory_order_relaxed)};
+  }
+
+  /**
+   * @brief Distribution of the time the lock was held exclusively, in
+   * nanoseconds.
+   */
+  [[nodiscard]] auto hold_times() const -> HoldTimeHistogram {
+    return hold_stats().hold_times;
+  }
+
+  [[nodiscard]] auto longest_hold() const -> std::chrono::nanoseconds {
+    return std::chrono::nanoseconds{hold_stats().longest_hold_ns};
+  }
+
+  /**
+   * @brief Return addresses of the innermost stack frames outside of the lock
+   * at the point where the longest hold was released, which identify the code
+   * that held the lock. Unused entries are nullptr.
+   */
+  [[nodiscard]] auto longest_hold_callers() const
+      -> std::array<const void*, MAX_CALLERS> {
+    return hold_stats().longest_hold_callers;
+  }
+
+  void record_acquisition(std::chrono::nanoseconds wait_time, bool contended) {
+    m_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    if (contended) {
+      m_contended_acquisitions.fetch_add(1, std::memory_order_relaxed);
+      m_total_wait_ns.fetch_add(wait_time.count(), std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * @brief Records a hold of the lock. The callers are taken from the stack
+   * frames starting at holder_frame, which must be a frame of the current
+   * stack, so that the frames of the lock itself are skipped.
+   */
+  void record_hold(std::chrono::nanoseconds hold_time,
+                   const void* holder_frame) {
+    const std::uint64_t hold_ns = hold_time.count();
+    std::scoped_lock<std::mutex> lock{m_hold_mutex};
+    m_hold_stats.hold_times.record(
+        static_cast<std::uint32_t>(std::min<std::uint64_t>(
+            hold_ns, std::numeric_limits<std::uint32_t>::max())));
+
+    if (hold_ns > m_hold_stats.longest_hold_ns) {
+      m_hold_stats.longest_hold_ns = hold_ns;
+      auto& callers = m_hold_stats.longest_hold_callers;
+      callers = {};
+      std::size_t i = 0;
+      // The stack grows downwards, so inner frames are at lower addresses
+      walk_stack_trace([&](const StackFrame& frame) {
+        if (std::less<const void*>{}(&frame, holder_frame)) {
+          return true;
+        }
+        callers[i++] = frame.return_address;
+        return i < MAX_CALLERS;
+      });
+    }
+  }
+
+  /**
+   * @brief Calls the callable with every live LockProfile. Locks must not be
+   * created nor destroyed from the callable.
+   */
+  template <CallableWithT<const LockProfile&> C>
+  static void for_each(C callable) {
+    Registry& reg = registry();
+    std::scoped_lock<std::mutex> lock{reg.mutex};
+    for (const LockProfile* profile = reg.head; profile != nullptr;
+         profile = profile->m_next) {
+      callable(*profile);
+    }
+  }
+
+  /**
+   * @brief Prints the statistics of every lock that was acquired at least
+   * once.
+   */
+  static void dump() {
+    printf("Lock profile:\n");
+    for_each([](const LockProfile& profile) {
+      const std::uint64_t acquisitions = profile.acquisitions();
+      if (acquisitions == 0) {
+        return;
+      }
+
+      printf("  %p: %" PRIu64 " acquisitions, %" PRIu64
+             " contended, %" PRIu64 " ns waiting\n",
+             static_cast<const void*>(&profile), acquisitions,
+             profile.contended_acquisitions(),
+             static_cast<std::uint64_t>(profile.total_wait_time().count()));
+
+      // Taken at once, so that the longest hold matches its callers
+      const HoldStats stats = profile.hold_stats();
+      const HoldTimeHistogram& hold_times = stats.hold_times;
+      printf("    hold time: %" PRIu64 " ns total, longest %" PRIu64
+             " ns released from",
+             hold_times.total(), stats.longest_hold_ns);
+      for (const void* caller : stats.longest_hold_callers) {
+        if (caller != nullptr) {
+          printf(" %p", caller);
+        }
+      }
+      printf("\n");
+
+      for (std::size_t i = 0; i < hold_times.num_buckets(); i++) {
+        if (hold_times.bucket(i) != 0) {
+          printf("    >= %" PRIu64 " ns: %" PRIu32 "\n",
+                 HoldTimeHistogram::bucket_lower_bound(i),
+                 hold_times.bucket(i));
+        }
+      }
+    });
+  }
+
+ private:
+  struct HoldStats {
+    HoldTimeHistogram hold_times;
+    std::uint64_t longest_hold_ns = 0;
+    std::array<const void*, MAX_CALLERS> longest_hold_callers{};
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    LockProfile* head = nullptr;
+
+    void add(LockProfile* profile) {
+      std::scoped_lock<std::mutex> lock{mutex};
+      profile->m_next = head;
+      if (head != nullptr) {
+        head->m_prev = profile;
+      }
+      head = profile;
+    }
+
+    void remove(LockProfile* profile) {
+      std::scoped_lock<std::mutex> lock{mutex};
+      if (profile->m_prev != nullptr) {
+        profile->m_prev->m_next = profile->m_next;
+      } else {
+        head = profile->m_next;
+      }
+      if (profile->m_next != nullptr) {
+        profile->m_next->m_prev = profile->m_prev;
+      }
+    }
+  };
+
+  static auto registry() -> Registry& {
+    static Registry s_registry;
+    return s_registry;
+  }
+
+  LockProfile* m_prev = nullptr;
+  LockProfile* m_next = nullptr;
+
+  std::atomic<std::uint64_t> m_acquisitions{0};
+  std::atomic<std::uint64_t> m_contended_acquisitions{0};
+  std::atomic<std::uint64_t> m_total_wait_ns{0};
+
+  mutable std::mutex m_hold_mutex;
+  HoldStats m_hold_stats;
+
+  [[nodiscard]] auto hold_stats() const -> HoldStats {
+    std::scoped_lock<std::mutex> lock{m_hold_mutex};
+    return m_hold_stats;
+  }
+};
+
+/**
+ * @brief Wraps a mutex of type M and records its contention statistics in a
+ * LockProfile.
+ *
+ * It has the same interface as M, including shared and timed locking if M
+ * supports them, so it can be used as the mutex of Ditto::ResourceLock or
+ * Ditto::ReadWriteLock. Contention is detected with M::try_lock() when it is
+ * available. Otherwise every acquisition is counted as uncontended.
+ *
+ * The callers of the longest hold start at the frame that called unlock(),
+ * or at the one given to set_holder_frame() after locking, which is how
+ * Ditto::ResourceLock and Ditto::ReadWriteLock leave their own frames out.
+ *
+ * Use it through Ditto::ProfiledLock, so that profiling is only compiled in
+ * when DITTO_LOCK_PROFILING is defined.
+ */
+template <class M>
+class ProfiledMutex {
+  using Clock = std::chrono::steady_clock;
+
+ public:
+  ProfiledMutex() = default;
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  ProfiledMutex(ProfiledMutex&&) = delete;
+  auto operator=(const ProfiledMutex&) -> ProfiledMutex& = delete;
+  auto operator=(ProfiledMutex&&) -> ProfiledMutex& = delete;
+
+  void lock() {
+    bool contended = false;
+    std::chrono::nanoseconds wait_time{};
+    if constexpr (detail::TryLockable<M>) {
+      if (!m_mutex.try_lock()) {
+        contended = true;
+        const auto start = Clock::now();
+        m_mutex.lock();
+        wait_time = elapsed_since(start);
+      }
+    } else {
+      m_mutex.lock();
+    }
+    m_profile.record_acquisition(wait_time, contended);
+    m_locked_at = Clock::now();
+  }
+
+  [[nodiscard]] auto try_lock() -> bool requires detail::TryLockable<M> {
+    if (!m_mutex.try_lock()) {
+      return false;
+    }
+    m_profile.record_acquisition({}, false);
+    m_locked_at = Clock::now();
+    return true;
+  }
+
+  template <class Rep, class Period>
+  requires TimedLockable<M> && detail::TryLockable<M>
+  [[nodiscard]] auto try_lock_for(
+      const std::chrono::duration<Rep, Period>& timeout) -> bool {
+    return lock_timed([&] { return m_mutex.try_lock_for(timeout); });
+  }
+
+  template <class DeadlineClock, class Duration>
+  requires TimedLockable<M> && detail::TryLockable<M>
+  [[nodiscard]] auto try_lock_until(
+      const std::chrono::time_point<DeadlineClock, Duration>& deadline)
+      -> bool {
+    return lock_timed([&] { return m_mutex.try_lock_until(deadline); });
+  }
+
+  /**
+   * @brief Makes the callers of this hold start at the given stack frame.
+   * Must be called while holding the lock exclusively.
+   */
+  void set_holder_frame(const void* frame) { m_holder_frame = frame; }
+
+  // Not inlined, so that it has a frame of its own to start the callers from
+  [[gnu::noinline]] void unlock() {
+    const void* holder_frame = std::exchange(m_holder_frame, nullptr);
+    if (holder_frame == nullptr) {
+      holder_frame = __builtin_frame_address(0);
+    }
+    m_profile.record_hold(elapsed_since(m_locked_at), holder_frame);
+    m_mutex.unlock();
+  }
+
+  void lock_shared() requires detail::TrySharedLockable<M> {
+    bool contended = false;
+    std::chrono::nanoseconds wait_time{};
+    if (!m_mutex.try_lock_shared()) {
+      contended = true;
+      const auto start = Clock::now();
+      m_mutex.lock_shared();
+      wait_time = elapsed_since(start);
+    }
+    m_profile.record_acquisition(wait_time, contended);
+  }
+
+  [[nodiscard]] auto try_lock_shared() -> bool
+      requires detail::TrySharedLockable<M> {
+    if (!m_mutex.try_lock_shared()) {
+      return false;
+    }
+    m_profile.record_acquisition({}, false);
+    return true;
+  }
+
+  template <class Rep, class Period>
+  requires SharedTimedLockable<M> && detail::TrySharedLockable<M>
+  [[nodiscard]] auto try_lock_shared_for(
+      const std::chrono::duration<Rep, Period>& timeout) -> bool {
+    return acquire_timed([this] { return m_mutex.try_lock_shared(); },
+                         [&] { return m_mutex.try_lock_shared_for(timeout); });
+  }
+
+  template <class DeadlineClock, class Duration>
+  requires SharedTimedLockable<M> && detail::TrySharedLockable<M>
+  [[nodiscard]] auto try_lock_shared_until(
+      const std::chrono::time_point<DeadlineClock, Duration>& deadline)
+      -> bool {
+    return acquire_timed(
+        [this] { return m_mutex.try_lock_shared(); },
+        [&] { return m_mutex.try_lock_shared_until(deadline); });
+  }
+
+  void unlock_shared() requires detail::TrySharedLockable<M> {
+    m_mutex.unlock_shared();
+  }
+
+  [[nodiscard]] auto profile() const -> const LockProfile& {
+    return m_profile;
+  }
+
+ private:
+  M m_mutex;
+  LockProfile m_profile;
+  Clock::time_point m_locked_at;
+  const void* m_holder_frame = nullptr;
+
+  // Counts the acquisition as contended when the mutex cannot be taken right
+  // away, like lock(), but gives up if the timed lock fails
+  template <class TryLock, class TimedLock>
+  auto acquire_timed(TryLock try_lock, TimedLock timed_lock) -> bool {
+    if (try_lock()) {
+      m_profile.record_acquisition({}, false);
+      return true;
+    }
+    const auto start = Clock::now();
+    if (!timed_lock()) {
+      return false;
+    }
+    m_profile.record_acquisition(elapsed_since(start), true);
+    return true;
+  }
+
+  template <class TimedLock>
+  auto lock_timed(TimedLock timed_lock) -> bool {
+    if (!acquire_timed([this] { return m_mutex.try_lock(); }, timed_lock)) {
+      return false;
+    }
+    m_locked_at = Clock::now();
+    return true;
+  }
+
+  static auto elapsed_since(Clock::time_point start)
+      -> std::chrono::nanoseconds {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                                start);
+  }
+};
+
+#if defined(DITTO_LOCK_PROFILING)
+template <class M>
+using ProfiledLock = ProfiledMutex<M>;
+#else
+template <class M>
+using ProfiledLock = M;
+#endif
+
+}  // namespace Ditto
+
+#endif  // DITTO_LOCK_PROFILING_H_
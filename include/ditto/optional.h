@@ -29,14 +29,14 @@ class [[nodiscard]] optional {
   constexpr optional(const optional& other) noexcept
       : m_valid(false), m_dummy(false) {
     if (other.has_value()) {
-      m_member = T{other.m_member};
+      new (&m_member) T{other.m_member};
       m_valid = true;
     }
   }
   constexpr optional(optional&& other) noexcept
       : m_valid(false), m_dummy(false) {
     if (other.has_value()) {
-      m_member = T{std::move(other).value()};
+      new (&m_member) T{std::move(other).value()};
       m_valid = true;
     }
   }
@@ -45,8 +45,8 @@ class [[nodiscard]] optional {
   constexpr explicit optional(const optional<U>& other)
       : m_valid(false), m_dummy(false) {
     if (other.has_value()) {
+      new (&m_member) T{other.value()};
       m_valid = true;
-      m_member = T{other.value()};
     }
   }
 
@@ -54,8 +54,8 @@ class [[nodiscard]] optional {
   constexpr explicit optional(optional<U>&& other)
       : m_valid(false), m_dummy(false) {
     if (other.has_value()) {
+      new (&m_member) T{std::move(other).value()};
       m_valid = true;
-      m_member = T{std::move(other).value()};
     }
   }
 
@@ -94,7 +94,7 @@ class [[nodiscard]] optional {
                                     bool>::type = false>
   constexpr optional& operator=(U&& value) noexcept {
     reset();
-    m_member = T{value};
+    new (&m_member) T{std::forward<U>(value)};
     m_valid = true;
     return *this;
   }
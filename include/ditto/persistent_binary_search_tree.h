@@ -0,0 +1,277 @@
+#ifndef DITTO_PERSISTENT_BINARY_SEARCH_TREE_H_
+#define DITTO_PERSISTENT_BINARY_SEARCH_TREE_H_
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "ditto/non_null_ptr.h"
+#include "ditto/optional.h"
+#include "ditto/pair.h"
+
+namespace Ditto {
+
+/**
+ * @brief Immutable AVL tree. Modifying it returns a new version of the tree
+ * and leaves the original untouched.
+ *
+ * A new version only copies the O(log N) nodes on the path to the modified
+ * key and shares all the others with the previous version (path copying), so
+ * copies are O(1) snapshots and old versions are cheap to keep around.
+ *
+ * Nodes are reference counted with std::shared_ptr and never modified after
+ * being created, so any number of threads can read a version while others
+ * derive new versions from it. Handing the latest version over to readers
+ * still needs synchronization, like holding it in a Ditto::RcuResource.
+ */
+template <class K, class V, class Allocator = std::allocator<Pair<K, V>>>
+class PersistentBinarySearchTree {
+ public:
+  using allocator_type = Allocator;
+
+  PersistentBinarySearchTree() = default;
+  explicit PersistentBinarySearchTree(const Allocator& allocator)
+      : m_allocator(allocator) {}
+
+  [[nodiscard]] auto get_allocator() const -> allocator_type {
+    return m_allocator;
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+  [[nodiscard]] auto depth() const -> std::uint32_t { return height(m_root); }
+
+  /**
+   * @brief Returns a version of the tree with the key mapped to value.
+   */
+  [[nodiscard]] auto insert(const K& key, const V& value) const
+      -> PersistentBinarySearchTree;
+
+  /**
+   * @brief Returns a version of the tree without the key. If the key is not
+   * in the tree, the new version shares all of its nodes.
+   */
+  [[nodiscard]] auto erase(const K& key) const -> PersistentBinarySearchTree;
+
+  [[nodiscard]] auto lookup(const K& key) const
+      -> Ditto::optional<Ditto::NonNullPtr<const V>>;
+
+  /**
+   * @brief Calls action(key, value) in order for every element.
+   */
+  template <std::invocable<const K&, const V&> Action>
+  void for_each(Action action) const {
+    for_each_node(m_root.get(), action);
+  }
+
+ private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node {
+    NodePtr left;
+    NodePtr right;
+    K key;
+    V value;
+    std::uint8_t height;
+
+    Node(NodePtr left, const K& key, const V& value, NodePtr right)
+        : left(std::move(left)),
+          right(std::move(right)),
+          key(key),
+          value(value),
+          height(static_cast<std::uint8_t>(
+              1 + std::max(PersistentBinarySearchTree::height(this->left),
+                           PersistentBinarySearchTree::height(this->right)))) {
+    }
+  };
+
+  [[no_unique_address]] Allocator m_allocator;
+  NodePtr m_root;
+  std::size_t m_size = 0;
+
+  PersistentBinarySearchTree(const Allocator& allocator, NodePtr root,
+                             std::size_t size)
+      : m_allocator(allocator), m_root(std::move(root)), m_size(size) {}
+
+  static auto height(const NodePtr& node) -> std::uint8_t {
+    return (node != nullptr) ? node->height : 0;
+  }
+
+  auto make_node(NodePtr left, const K& key, const V& value,
+                 NodePtr right) const -> NodePtr {
+    return std::allocate_shared<Node>(m_allocator, std::move(left), key, value,
+                                      std::move(right));
+  }
+
+  auto balance(NodePtr left, const K& key, const V& value,
+               NodePtr right) const -> NodePtr;
+  auto insert_into(const NodePtr& node, const K& key, const V& value,
+                   bool& inserted) const -> NodePtr;
+  auto erase_from(const NodePtr& node, const K& key, bool& erased) const
+      -> NodePtr;
+  auto erase_min(const NodePtr& node) const -> NodePtr;
+
+  // These recurse as deep as the tree, which is at most 1.44 * log2(N + 2)
+  // levels deep
+  template <class Action>
+  static void for_each_node(const Node* node, Action& action);
+};
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::insert(const K& key,
+                                                         const V& value) const
+    -> PersistentBinarySearchTree {
+  bool inserted = false;
+  NodePtr root = insert_into(m_root, key, value, inserted);
+  return PersistentBinarySearchTree{m_allocator, std::move(root),
+                                    m_size + (inserted ? 1 : 0)};
+}
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::erase(const K& key) const
+    -> PersistentBinarySearchTree {
+  bool erased = false;
+  NodePtr root = erase_from(m_root, key, erased);
+  if (!erased) {
+    return *this;
+  }
+  return PersistentBinarySearchTree{m_allocator, std::move(root), m_size - 1};
+}
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::lookup(const K& key) const
+    -> Ditto::optional<Ditto::NonNullPtr<const V>> {
+  const Node* node = m_root.get();
+
+  while (node != nullptr) {
+    if (node->key == key) {
+      return Ditto::optional<Ditto::NonNullPtr<const V>>{
+          Ditto::NonNullPtr<const V>{&node->value}};
+    } else if (key < node->key) {
+      node = node->left.get();
+    } else {
+      node = node->right.get();
+    }
+  }
+  return {};
+}
+
+// Makes a node from subtrees whose heights differ at most by two, rotating
+// them if they differ by two. Rotations create new nodes instead of relinking
+// the existing ones, which may be shared with other versions.
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::balance(
+    NodePtr left, const K& key, const V& value, NodePtr right) const
+    -> NodePtr {
+  if (height(left) > height(right) + 1) {
+    const Node& l = *left;
+    if (height(l.left) >= height(l.right)) {
+      return make_node(l.left, l.key, l.value,
+                       make_node(l.right, key, value, std::move(right)));
+    }
+    const Node& lr = *l.right;
+    return make_node(make_node(l.left, l.key, l.value, lr.left), lr.key,
+                     lr.value,
+                     make_node(lr.right, key, value, std::move(right)));
+  }
+
+  if (height(right) > height(left) + 1) {
+    const Node& r = *right;
+    if (height(r.right) >= height(r.left)) {
+      return make_node(make_node(std::move(left), key, value, r.left), r.key,
+                       r.value, r.right);
+    }
+    const Node& rl = *r.left;
+    return make_node(make_node(std::move(left), key, value, rl.left), rl.key,
+                     rl.value, make_node(rl.right, r.key, r.value, r.right));
+  }
+
+  return make_node(std::move(left), key, value, std::move(right));
+}
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::insert_into(
+    const NodePtr& node, const K& key, const V& value, bool& inserted) const
+    -> NodePtr {
+  if (node == nullptr) {
+    inserted = true;
+    return make_node(nullptr, key, value, nullptr);
+  }
+
+  if (node->key == key) {
+    return make_node(node->left, key, value, node->right);
+  }
+  if (key < node->key) {
+    return balance(insert_into(node->left, key, value, inserted), node->key,
+                   node->value, node->right);
+  }
+  return balance(node->left, node->key, node->value,
+                 insert_into(node->right, key, value, inserted));
+}
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::erase_from(
+    const NodePtr& node, const K& key, bool& erased) const -> NodePtr {
+  if (node == nullptr) {
+    return nullptr;
+  }
+
+  if (node->key == key) {
+    erased = true;
+    if (node->left == nullptr) {
+      return node->right;
+    }
+    if (node->right == nullptr) {
+      return node->left;
+    }
+    // Take the place of the node with its successor
+    const Node* successor = node->right.get();
+    while (successor->left != nullptr) {
+      successor = successor->left.get();
+    }
+    return balance(node->left, successor->key, successor->value,
+                   erase_min(node->right));
+  }
+
+  if (key < node->key) {
+    NodePtr left = erase_from(node->left, key, erased);
+    if (!erased) {
+      return node;
+    }
+    return balance(std::move(left), node->key, node->value, node->right);
+  }
+  NodePtr right = erase_from(node->right, key, erased);
+  if (!erased) {
+    return node;
+  }
+  return balance(node->left, node->key, node->value, std::move(right));
+}
+
+template <class K, class V, class Allocator>
+auto PersistentBinarySearchTree<K, V, Allocator>::erase_min(
+    const NodePtr& node) const -> NodePtr {
+  if (node->left == nullptr) {
+    return node->right;
+  }
+  return balance(erase_min(node->left), node->key, node->value, node->right);
+}
+
+template <class K, class V, class Allocator>
+template <class Action>
+void PersistentBinarySearchTree<K, V, Allocator>::for_each_node(
+    const Node* node, Action& action) {
+  if (node == nullptr) {
+    return;
+  }
+  for_each_node(node->left.get(), action);
+  action(node->key, node->value);
+  for_each_node(node->right.get(), action);
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_PERSISTENT_BINARY_SEARCH_TREE_H_
@@ -0,0 +1,376 @@
+#ifndef DITTO_POOL_ALLOCATOR_H_
+#define DITTO_POOL_ALLOCATOR_H_
+
+#include <algorithm>
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <forward_list>
+#include <memory>
+#include <new>
+#include <type_traits>
+
+#include "ditto/assert.h"
+
+namespace Ditto {
+
+/**
+ * @brief Allocator handing out single objects from a statically allocated
+ * pool of CAPACITY slots, with O(1) allocation and deallocation through a free
+ * list.
+ *
+ * It is meant for node-based containers like Ditto::LinkedList: when rebound
+ * to the node type of the container, the pool holds CAPACITY nodes. Running
+ * out of slots is a fatal error.
+ *
+ * Like Ditto::TaskFramePool, the storage is shared by every instance of the
+ * same FixedPoolAllocator type, so all of them compare equal and containers
+ * using it can be freely moved. Use a different Tag to give a container its
+ * own pool. The pool is not thread safe.
+ */
+template <class T, std::size_t CAPACITY, class Tag = void>
+class FixedPoolAllocator {
+  static_assert(CAPACITY > 0, "The pool needs at least one slot");
+
+ public:
+  using value_type = T;
+
+  template <class U>
+  struct rebind {
+    using other = FixedPoolAllocator<U, CAPACITY, Tag>;
+  };
+
+  FixedPoolAllocator() = default;
+
+  template <class U>
+  explicit FixedPoolAllocator(
+      const FixedPoolAllocator<U, CAPACITY, Tag>& /*unused*/) noexcept {}
+
+  [[nodiscard]] auto allocate(std::size_t n) -> T* {
+    DITTO_VERIFY(n == 1);
+
+    Slot* slot = nullptr;
+    if (s_free_list != nullptr) {
+      slot = s_free_list;
+      s_free_list = slot->next;
+    } else if (s_num_untouched_slots < CAPACITY) {
+      slot = &s_slots[s_num_untouched_slots++];
+    }
+    DITTO_VERIFY(slot != nullptr);
+    s_num_allocated++;
+    return reinterpret_cast<T*>(slot->storage);
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    DITTO_VERIFY(n == 1);
+    auto* slot = reinterpret_cast<Slot*>(ptr);
+    DITTO_VERIFY((slot >= s_slots.data()) &&
+                 (slot < s_slots.data() + CAPACITY));
+    slot->next = s_free_list;
+    s_free_list = slot;
+    s_num_allocated--;
+  }
+
+  /**
+   * @brief Returns how many more objects can be allocated from the pool.
+   */
+  [[nodiscard]] static auto available() -> std::size_t {
+    return CAPACITY - s_num_allocated;
+  }
+
+  template <class U>
+  [[nodiscard]] auto operator==(
+      const FixedPoolAllocator<U, CAPACITY, Tag>& /*unused*/) const -> bool {
+    return true;
+  }
+
+ private:
+  union Slot {
+    Slot* next;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  static inline std::array<Slot, CAPACITY> s_slots;
+  static inline Slot* s_free_list = nullptr;
+  static inline std::size_t s_num_untouched_slots = 0;
+  static inline std::size_t s_num_allocated = 0;
+};
+
+/**
+ * @brief Allocators that can release every object they handed out at once.
+ *
+ * deallocate_all() returns false, releasing nothing, when the allocator cannot
+ * tell that the caller is the only user of the objects. Containers use it to
+ * clear trivially destructible elements without visiting them.
+ */
+template <class A>
+concept BulkDeallocatable = requires(A allocator) {
+  { allocator.deallocate_all() } -> std::convertible_to<bool>;
+};
+
+namespace detail {
+
+/**
+ * @brief Slabs of Ditto::SlabAllocator for objects of one size class. Slots
+ * are carved sequentially out of slabs of slots_per_slab slots, and freed
+ * slots are kept in a free list.
+ */
+class SlabArena {
+ public:
+  SlabArena(std::size_t slots_per_slab, std::size_t slot_size,
+            std::size_t slot_alignment)
+      : m_slots_per_slab(slots_per_slab),
+        m_slot_size(slot_size),
+        m_slot_alignment(slot_alignment) {}
+
+  SlabArena(const SlabArena&) = delete;
+  SlabArena(SlabArena&&) = delete;
+  auto operator=(const SlabArena&) -> SlabArena& = delete;
+  auto operator=(SlabArena&&) -> SlabArena& = delete;
+
+  ~SlabArena() {
+    Slab* slab = m_first;
+    while (slab != nullptr) {
+      Slab* next = slab->next;
+      ::operator delete(slab, std::align_val_t{m_slot_alignment});
+      slab = next;
+    }
+  }
+
+  /**
+   * @brief Size and alignment of the slots holding objects of the given size
+   * and alignment. Objects with the same slot layout share an arena.
+   */
+  static constexpr auto slot_alignment_for(std::size_t alignment)
+      -> std::size_t {
+    return std::max(alignment, alignof(FreeSlot));
+  }
+  static constexpr auto slot_size_for(std::size_t size, std::size_t alignment)
+      -> std::size_t {
+    return round_up(std::max(size, sizeof(FreeSlot)),
+                    slot_alignment_for(alignment));
+  }
+
+  [[nodiscard]] auto slot_size() const -> std::size_t { return m_slot_size; }
+  [[nodiscard]] auto slot_alignment() const -> std::size_t {
+    return m_slot_alignment;
+  }
+
+  [[nodiscard]] auto allocate() -> void* {
+    if (m_free_list != nullptr) {
+      FreeSlot* slot = m_free_list;
+      m_free_list = slot->next;
+      return slot;
+    }
+
+    if (m_cursor == m_cursor_end) {
+      next_slab();
+    }
+    void* slot = m_cursor;
+    m_cursor += m_slot_size;
+    return slot;
+  }
+
+  void deallocate(void* ptr) {
+    auto* slot = static_cast<FreeSlot*>(ptr);
+    slot->next = m_free_list;
+    m_free_list = slot;
+  }
+
+  // Makes every slot available again, keeping the slabs for reuse
+  void reset() {
+    m_free_list = nullptr;
+    m_current = nullptr;
+    m_cursor = nullptr;
+    m_cursor_end = nullptr;
+  }
+
+ private:
+  struct Slab {
+    Slab* next;
+  };
+
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+
+  std::size_t m_slots_per_slab;
+  std::size_t m_slot_size;
+  std::size_t m_slot_alignment;
+
+  // Slabs are kept in allocation order, so that a reset arena refills them
+  // from the first one
+  Slab* m_first = nullptr;
+  Slab* m_last = nullptr;
+  Slab* m_current = nullptr;
+  std::byte* m_cursor = nullptr;
+  std::byte* m_cursor_end = nullptr;
+  FreeSlot* m_free_list = nullptr;
+
+  static constexpr auto round_up(std::size_t size, std::size_t alignment)
+      -> std::size_t {
+    return (size + alignment - 1) / alignment * alignment;
+  }
+
+  void next_slab() {
+    Slab* slab = (m_current != nullptr) ? m_current->next : m_first;
+    const std::size_t header_size = round_up(sizeof(Slab), m_slot_alignment);
+    if (slab == nullptr) {
+      void* memory =
+          ::operator new(header_size + m_slot_size * m_slots_per_slab,
+                         std::align_val_t{m_slot_alignment});
+      slab = new (memory) Slab{nullptr};
+      if (m_last != nullptr) {
+        m_last->next = slab;
+      } else {
+        m_first = slab;
+      }
+      m_last = slab;
+    }
+
+    m_current = slab;
+    m_cursor = reinterpret_cast<std::byte*>(slab) + header_size;
+    m_cursor_end = m_cursor + m_slot_size * m_slots_per_slab;
+  }
+};
+
+/**
+ * @brief Arenas shared by all the copies of a Ditto::SlabAllocator, including
+ * the ones rebound to other types. Each slot layout gets its own arena, so
+ * containers sharing an allocator never get slots sized for another node type.
+ */
+class SlabArenas {
+ public:
+  explicit SlabArenas(std::size_t slots_per_slab)
+      : m_slots_per_slab(slots_per_slab) {}
+
+  SlabArenas(const SlabArenas&) = delete;
+  SlabArenas(SlabArenas&&) = delete;
+  auto operator=(const SlabArenas&) -> SlabArenas& = delete;
+  auto operator=(SlabArenas&&) -> SlabArenas& = delete;
+
+  // Looked up once per allocator, when it is constructed or rebound
+  auto arena_for(std::size_t size, std::size_t alignment) -> SlabArena& {
+    const std::size_t slot_size = SlabArena::slot_size_for(size, alignment);
+    const std::size_t slot_alignment =
+        SlabArena::slot_alignment_for(alignment);
+    for (SlabArena& arena : m_arenas) {
+      if ((arena.slot_size() == slot_size) &&
+          (arena.slot_alignment() == slot_alignment)) {
+        return arena;
+      }
+    }
+    return m_arenas.emplace_front(m_slots_per_slab, slot_size,
+                                  slot_alignment);
+  }
+
+  void reset() {
+    for (SlabArena& arena : m_arenas) {
+      arena.reset();
+    }
+  }
+
+ private:
+  std::size_t m_slots_per_slab;
+  std::forward_list<SlabArena> m_arenas;
+};
+
+}  // namespace detail
+
+/**
+ * @brief Allocator handing out single objects from heap-allocated slabs of
+ * SLOTS_PER_SLAB slots, with O(1) allocation and deallocation through a free
+ * list.
+ *
+ * Nodes allocated one after the other are contiguous in memory, which makes
+ * node-based containers like Ditto::RedBlackTree friendlier to the cache, and
+ * the heap is only hit once per slab. Copies of an allocator, rebound or not,
+ * share the same slabs, which are freed when the last copy is destroyed. Slabs
+ * are kept per slot size, so an allocator can be shared by containers with
+ * different node types.
+ *
+ * deallocate_all() returns every slot to the arena in O(1) when this is the
+ * only copy of the allocator, so a container that default-constructs its
+ * allocator can be cleared without visiting its nodes.
+ */
+template <class T, std::size_t SLOTS_PER_SLAB = 64>
+class SlabAllocator {
+  static_assert(SLOTS_PER_SLAB > 0, "Slabs need at least one slot");
+
+ public:
+  using value_type = T;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  template <class U>
+  struct rebind {
+    using other = SlabAllocator<U, SLOTS_PER_SLAB>;
+  };
+
+  SlabAllocator()
+      : m_arenas(std::make_shared<detail::SlabArenas>(SLOTS_PER_SLAB)),
+        m_arena(&arena_for(*m_arenas)) {}
+
+  template <class U>
+  explicit SlabAllocator(const SlabAllocator<U, SLOTS_PER_SLAB>& other)
+      : m_arenas(other.m_arenas), m_arena(&arena_for(*m_arenas)) {}
+
+  // Moving an allocator must not leave the source without an arena, so moves
+  // are copies
+  SlabAllocator(const SlabAllocator&) = default;
+  auto operator=(const SlabAllocator&) -> SlabAllocator& = default;
+
+  /**
+   * @brief Takes a slot from the slabs. Arrays do not fit in a slot and are
+   * taken from the heap instead, and are not released by deallocate_all().
+   */
+  [[nodiscard]] auto allocate(std::size_t n) -> T* {
+    if (n != 1) {
+      return static_cast<T*>(
+          ::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+    }
+    return static_cast<T*>(m_arena->allocate());
+  }
+
+  void deallocate(T* ptr, std::size_t n) noexcept {
+    if (n != 1) {
+      ::operator delete(ptr, std::align_val_t{alignof(T)});
+      return;
+    }
+    m_arena->deallocate(ptr);
+  }
+
+  /**
+   * @brief Releases every object allocated from the arenas, without
+   * destroying them. Does nothing and returns false if the arenas are shared
+   * with other copies of the allocator.
+   */
+  auto deallocate_all() -> bool {
+    if (m_arenas.use_count() != 1) {
+      return false;
+    }
+    m_arenas->reset();
+    return true;
+  }
+
+  template <class U>
+  [[nodiscard]] auto operator==(
+      const SlabAllocator<U, SLOTS_PER_SLAB>& other) const -> bool {
+    return m_arenas == other.m_arenas;
+  }
+
+ private:
+  std::shared_ptr<detail::SlabArenas> m_arenas;
+  detail::SlabArena* m_arena;
+
+  static auto arena_for(detail::SlabArenas& arenas) -> detail::SlabArena& {
+    return arenas.arena_for(sizeof(T), alignof(T));
+  }
+
+  template <class U, std::size_t>
+  friend class SlabAllocator;
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_POOL_ALLOCATOR_H_
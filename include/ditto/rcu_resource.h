@@ -0,0 +1,92 @@
+#ifndef DITTO_RCU_RESOURCE_H_
+#define DITTO_RCU_RESOURCE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/epoch.h"
+#include "ditto/type_traits.h"
+
+namespace Ditto {
+
+/**
+ * @brief Wraps a read-mostly resource using read-copy-update.
+ *
+ * Readers get wait-free access to an immutable snapshot of the resource: they
+ * register in an EpochDomain and load the current version, without ever
+ * waiting for writers. update() copies the current version, runs the action
+ * on the copy and publishes it. The previous version is reclaimed once all
+ * readers that could still be using it have left, so update() blocks for a
+ * grace period. Updates are serialized among themselves.
+ *
+ * This is a good fit for data that is read on every request and replaced
+ * rarely, such as routing tables or configuration.
+ */
+template <class T, std::size_t NUM_READER_SLOTS = 32>
+class RcuResource {
+ public:
+  template <class... Args>
+  explicit RcuResource(Args... args)
+      : m_current(new T(std::forward<Args>(args)...)) {}
+
+  ~RcuResource() { delete m_current.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief Runs the action on the current snapshot of the resource. The
+   * snapshot stays valid until the action returns.
+   */
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, const T&>, bool> =
+                false>
+  inline auto read_lock(Action action) {
+    auto guard = m_domain.read_lock();
+    const T* snapshot = m_current.load(std::memory_order_seq_cst);
+    return action(*snapshot);
+  }
+
+  /**
+   * @brief Runs the action on a copy of the resource and publishes it. Must
+   * not be called from within read_lock().
+   */
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  inline auto update(Action action) {
+    std::scoped_lock<std::mutex> lock{m_update_mutex};
+    auto next =
+        std::make_unique<T>(*m_current.load(std::memory_order_relaxed));
+
+    if constexpr (Ditto::returns_void_v<Action, T&>) {
+      action(*next);
+      publish(std::move(next));
+    } else {
+      auto retval = action(*next);
+      publish(std::move(next));
+      return retval;
+    }
+  }
+
+  RcuResource(const RcuResource&) = delete;
+  RcuResource(RcuResource&&) = delete;
+  auto operator=(const RcuResource&) -> RcuResource& = delete;
+  auto operator=(RcuResource&&) -> RcuResource& = delete;
+
+ private:
+  std::atomic<T*> m_current;
+  EpochDomain<NUM_READER_SLOTS> m_domain;
+  std::mutex m_update_mutex;
+
+  void publish(std::unique_ptr<T> next) {
+    std::unique_ptr<T> previous{
+        m_current.exchange(next.release(), std::memory_order_seq_cst)};
+    // Wait until no reader can be using the previous version
+    m_domain.synchronize();
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_RCU_RESOURCE_H_
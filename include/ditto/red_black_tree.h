@@ -2,107 +2,384 @@
 #define DITTO_RED_BLACK_TREE_H_
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <functional>
+#include <iterator>
 #include <memory>
+#include <type_traits>
 #include <utility>
 
 #include "ditto/assert.h"
-#include "ditto/linked_list.h"
 #include "ditto/non_null_ptr.h"
 #include "ditto/optional.h"
+#include "ditto/pair.h"
+#include "ditto/pool_allocator.h"
+#include "ditto/red_black_tree_algorithms.h"
+#include "ditto/span.h"
 
 namespace Ditto {
 
-template <class K, class V>
+template <class K, class V, class Allocator = std::allocator<Pair<K, V>>>
 class RedBlackTree {
- public:
-  void insert(const K& key, const V& value);
-  auto lookup(const K& key) -> Ditto::optional<Ditto::NonNullPtr<V>>;
-
-  auto erase(const K& key) -> Ditto::optional<V>;
-
-  [[nodiscard]] auto depth() const -> std::uint32_t;
-
-  void print() const;
+  struct Node;
+
+  /**
+   * @brief What iterators point to: references to the key and the value of an
+   * element, which can be used with structured bindings.
+   */
+  template <bool CONST>
+  struct EntryRef {
+    const K& key;
+    std::conditional_t<CONST, const V&, V&> value;
+  };
 
- private:
-  enum class Color { RED = 0x00, BLACK = 0x01 };
+  /**
+   * @brief In-order iterator. It walks the tree through the parent pointers of
+   * the nodes, so it needs no auxiliary stack. Erasing an element only
+   * invalidates the iterators to that element.
+   */
+  template <bool CONST>
+  class Iterator {
+    using Tree = std::conditional_t<CONST, const RedBlackTree, RedBlackTree>;
 
-  template <class T>
-  class PointerAndColor {
    public:
-    PointerAndColor(T* node, Color color = Color::RED) {
-      // The node pointer must be aligned to 4 bytes
-      const uintptr_t node_ptr = reinterpret_cast<std::uintptr_t>(node);
-      DITTO_VERIFY((node_ptr & COLOR_MASK) == 0);
+    using difference_type = std::ptrdiff_t;
+    using value_type = EntryRef<CONST>;
+    using reference = EntryRef<CONST>;
+    using pointer = void;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    Iterator() = default;
+
+    template <bool OTHER_CONST,
+              std::enable_if_t<CONST && !OTHER_CONST, bool> = false>
+    Iterator(const Iterator<OTHER_CONST>& other)
+        : m_tree(other.m_tree), m_node(other.m_node) {}
+
+    auto operator++() -> Iterator& {
+      m_node = Algorithms::successor(m_node);
+      return *this;
+    }
 
-      m_value = node_ptr | static_cast<std::uintptr_t>(color);
+    auto operator++(int) -> Iterator {
+      Iterator current = *this;
+      ++*this;
+      return current;
     }
 
-    Color color() const { return static_cast<Color>(m_value & 0x3); }
-    T* pointer() const { return reinterpret_cast<T*>(m_value & PTR_MASK); }
+    auto operator--() -> Iterator& {
+      if (m_node == nullptr) {
+        // Decrementing end()
+        m_node = Algorithms::rightmost(m_tree->m_root);
+      } else {
+        m_node = Algorithms::predecessor(m_node);
+      }
+      return *this;
+    }
 
-    void set_pointer(T* node) {
-      const auto ptr = reinterpret_cast<std::uintptr_t>(node);
-      DITTO_VERIFY((ptr & COLOR_MASK) == 0);
-      m_value &= COLOR_MASK;
-      m_value |= ptr;
+    auto operator--(int) -> Iterator {
+      Iterator current = *this;
+      --*this;
+      return current;
     }
 
-    void set_color(Color color) {
-      const auto color_val = static_cast<std::uintptr_t>(color);
-      m_value &= PTR_MASK;
-      m_value |= color_val;
+    [[nodiscard]] auto operator*() const -> reference {
+      return reference{m_node->key, m_node->value};
     }
 
-    void swap_color() {
-      if (color() == Color::BLACK) {
-        set_color(Color::RED);
-      } else {
-        set_color(Color::BLACK);
-      }
+    template <bool OTHER_CONST>
+    [[nodiscard]] auto operator==(const Iterator<OTHER_CONST>& other) const
+        -> bool {
+      return m_node == other.m_node;
     }
 
    private:
-    std::uintptr_t m_value;
-    constexpr static std::uintptr_t COLOR_MASK = std::uintptr_t{0x03};
-    constexpr static std::uintptr_t PTR_MASK = ~COLOR_MASK;
+    Tree* m_tree = nullptr;
+    Node* m_node = nullptr;
+
+    Iterator(Tree* tree, Node* node) : m_tree(tree), m_node(node) {}
+
+    template <bool>
+    friend class Iterator;
+
+    friend RedBlackTree;
   };
 
+ public:
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using allocator_type = Allocator;
+
+  RedBlackTree() = default;
+  explicit RedBlackTree(const Allocator& allocator)
+      : m_allocator(allocator) {}
+
+  /**
+   * @brief Builds a perfectly balanced tree from entries sorted by strictly
+   * increasing keys in O(N), without comparing nor rotating.
+   *
+   * All nodes are taken from a single allocation of N nodes, laid out in key
+   * order, so the allocator must support allocating several nodes at once, as
+   * std::allocator does. The block is released when the tree is cleared, so
+   * the memory of erased elements is not reclaimed until then.
+   */
+  [[nodiscard]] static auto from_sorted(
+      Ditto::span<const Pair<K, V>> sorted_entries,
+      const Allocator& allocator = Allocator()) -> RedBlackTree;
+
+  RedBlackTree(RedBlackTree&& other) noexcept
+      : m_allocator(std::move(other.m_allocator)),
+        m_root(std::exchange(other.m_root, nullptr)),
+        m_size(std::exchange(other.m_size, 0)),
+        m_block(std::exchange(other.m_block, nullptr)),
+        m_block_size(std::exchange(other.m_block_size, 0)) {}
+
+  auto operator=(RedBlackTree&& other) noexcept -> RedBlackTree& {
+    if (this != &other) {
+      clear();
+      if constexpr (NodeAllocatorTraits::
+                        propagate_on_container_move_assignment::value) {
+        m_allocator = std::move(other.m_allocator);
+      } else {
+        DITTO_VERIFY(m_allocator == other.m_allocator);
+      }
+      m_root = std::exchange(other.m_root, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+      m_block = std::exchange(other.m_block, nullptr);
+      m_block_size = std::exchange(other.m_block_size, 0);
+    }
+    return *this;
+  }
+
+  RedBlackTree(const RedBlackTree&) = delete;
+  auto operator=(const RedBlackTree&) -> RedBlackTree& = delete;
+
+  ~RedBlackTree() { clear(); }
+
+  [[nodiscard]] auto get_allocator() const -> allocator_type {
+    return allocator_type{m_allocator};
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> std::size_t { return m_size; }
+
+  /**
+   * @brief Destroys all elements. If they are trivially destructible and the
+   * allocator can release all of its nodes at once, like a
+   * Ditto::SlabAllocator that is not shared, this is O(1).
+   */
+  void clear();
+
+  void insert(const K& key, const V& value);
+  auto lookup(const K& key) -> Ditto::optional<Ditto::NonNullPtr<V>>;
+
+  auto erase(const K& key) -> Ditto::optional<V>;
+
+  /**
+   * @brief Erases the element at pos and returns an iterator to the element
+   * that followed it.
+   */
+  auto erase(const_iterator pos) -> iterator;
+
+  [[nodiscard]] auto begin() -> iterator {
+    return iterator{this, Algorithms::leftmost(m_root)};
+  }
+  [[nodiscard]] auto end() -> iterator { return iterator{this, nullptr}; }
+  [[nodiscard]] auto begin() const -> const_iterator {
+    return const_iterator{this, Algorithms::leftmost(m_root)};
+  }
+  [[nodiscard]] auto end() const -> const_iterator {
+    return const_iterator{this, nullptr};
+  }
+  [[nodiscard]] auto cbegin() const -> const_iterator { return begin(); }
+  [[nodiscard]] auto cend() const -> const_iterator { return end(); }
+
+  /**
+   * @brief Returns an iterator to the first element whose key is not less than
+   * the given key.
+   */
+  [[nodiscard]] auto lower_bound(const K& key) -> iterator {
+    return iterator{this, lower_bound_node(key)};
+  }
+  [[nodiscard]] auto lower_bound(const K& key) const -> const_iterator {
+    return const_iterator{this, lower_bound_node(key)};
+  }
+
+  /**
+   * @brief Returns an iterator to the first element whose key is greater than
+   * the given key.
+   */
+  [[nodiscard]] auto upper_bound(const K& key) -> iterator {
+    return iterator{this, upper_bound_node(key)};
+  }
+  [[nodiscard]] auto upper_bound(const K& key) const -> const_iterator {
+    return const_iterator{this, upper_bound_node(key)};
+  }
+
+  /**
+   * @brief Calls action(key, value) in order for every element whose key is
+   * in the range [first, last).
+   */
+  template <std::invocable<const K&, V&> Action>
+  void for_each_in_range(const K& first, const K& last, Action action);
+  template <std::invocable<const K&, const V&> Action>
+  void for_each_in_range(const K& first, const K& last, Action action) const;
+
+  /**
+   * @brief Calls action(key, value) in order for every element. The action
+   * must not insert nor erase elements.
+   */
+  template <std::invocable<const K&, V&> Action>
+  void for_each(Action action);
+  template <std::invocable<const K&, const V&> Action>
+  void for_each(Action action) const;
+
+  /**
+   * @brief Calls visitor(key, value, depth) for every element, level by level
+   * from the root and from left to right within a level. The root is at depth
+   * 0.
+   *
+   * Every level is walked from the root with a stack-allocated cursor instead
+   * of keeping a queue of the next level, so it never allocates and takes
+   * O(N log N) time.
+   */
+  template <std::invocable<const K&, const V&, std::uint32_t> Visitor>
+  void visit_level_order(Visitor visitor) const;
+
+  /**
+   * @brief Returns the number of levels of the tree. Walks the whole tree
+   * without recursion.
+   */
+  [[nodiscard]] auto depth() const -> std::uint32_t;
+
+  /**
+   * @brief Checks the red-black properties and the parent links of every node
+   * in O(N). Meant for debugging and tests.
+   */
+  [[nodiscard]] auto satisfies_invariants() const -> bool {
+    if ((m_root != nullptr) && (Algorithms::parent_of(m_root) != nullptr)) {
+      return false;
+    }
+    return Algorithms::black_height(m_root) >= 0;
+  }
+
+  void print() const;
+
+ private:
+  using Color = NodeColor;
+  using Algorithms = detail::RedBlackTreeAlgorithms<Node>;
+
   struct Node {
     PointerAndColor<Node> color_and_parent;
     K key;
     V value;
-    std::unique_ptr<Node> left;
-    std::unique_ptr<Node> right;
+    Node* left = nullptr;
+    Node* right = nullptr;
 
     Node(const K& key, const V& value, Node* parent)
-        : key(key), value(value), color_and_parent(parent, Color::RED) {}
+        : color_and_parent(parent, Color::RED), key(key), value(value) {}
+  };
+
+  // A red-black tree of N nodes is at most 2 * log2(N + 1) levels deep, and
+  // there cannot be more nodes than fit in the address space
+  static constexpr std::size_t MAX_HEIGHT =
+      2 * std::bit_width(SIZE_MAX / sizeof(Node));
+
+  struct Cursor {
+    Node* node;
+    std::uint32_t depth;
+  };
+
+  // Stack of the traversals, sized for the tallest possible tree so that it
+  // can live on the call stack. A pre-order walk keeps at most one pending
+  // sibling per level plus the current node.
+  class TraversalStack {
+   public:
+    void push(Node* node, std::uint32_t depth) {
+      DITTO_VERIFY(m_size < m_cursors.size());
+      m_cursors[m_size++] = Cursor{node, depth};
+    }
+    auto pop() -> Cursor { return m_cursors[--m_size]; }
+    [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+
+   private:
+    std::array<Cursor, MAX_HEIGHT + 1> m_cursors;
+    std::size_t m_size = 0;
   };
 
-  std::unique_ptr<Node> m_root;
+  using NodeAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Node>;
+  using NodeAllocatorTraits = std::allocator_traits<NodeAllocator>;
+
+  [[no_unique_address]] NodeAllocator m_allocator;
+  Node* m_root = nullptr;
+  std::size_t m_size = 0;
+  // Nodes created by from_sorted(), which are only released by clear()
+  Node* m_block = nullptr;
+  std::size_t m_block_size = 0;
+
+  template <class... Args>
+  auto create_node(Args&&... args) -> Node* {
+    Node* node = NodeAllocatorTraits::allocate(m_allocator, 1);
+    NodeAllocatorTraits::construct(m_allocator, node,
+                                   std::forward<Args>(args)...);
+    return node;
+  }
+
+  void destroy_node(Node* node) {
+    NodeAllocatorTraits::destroy(m_allocator, node);
+    if (!in_block(node)) {
+      NodeAllocatorTraits::deallocate(m_allocator, node, 1);
+    }
+  }
+
+  [[nodiscard]] auto in_block(Node* node) const -> bool {
+    return std::less_equal<Node*>{}(m_block, node) &&
+           std::less<Node*>{}(node, m_block + m_block_size);
+  }
+
+  void free_block() {
+    if (m_block != nullptr) {
+      NodeAllocatorTraits::deallocate(m_allocator,
+                                      std::exchange(m_block, nullptr),
+                                      std::exchange(m_block_size, 0));
+    }
+  }
 
-  void fixup_insertion(Ditto::NonNullPtr<Node> node);
-  void rotate_right(Ditto::NonNullPtr<Node> node);
-  void rotate_left(Ditto::NonNullPtr<Node> node);
-  static auto depth_from_node(Node* node, std::uint32_t current_depth)
-      -> std::uint32_t;
+  [[nodiscard]] auto lower_bound_node(const K& key) const -> Node*;
+  [[nodiscard]] auto upper_bound_node(const K& key) const -> Node*;
+
+  static auto link_sorted(Node* nodes, std::size_t first, std::size_t last,
+                          Node* parent, std::uint32_t depth,
+                          std::uint32_t red_depth) -> Node*;
+  template <class Action>
+  static void for_each_node(Node* root, Action action);
+  template <class Visitor>
+  static void for_each_node_preorder(Node* root, std::uint32_t max_depth,
+                                     Visitor visitor);
+  template <class Visitor>
+  static void for_each_node_level_order(Node* root, Visitor visitor);
 };  // namespace Ditto
 
-template <class K, class V>
-inline void RedBlackTree<K, V>::insert(const K& key, const V& value) {
-  Ditto::NonNullPtr<std::unique_ptr<Node>> node_double_ptr = &m_root;
+template <class K, class V, class Allocator>
+inline void RedBlackTree<K, V, Allocator>::insert(const K& key,
+                                                  const V& value) {
+  Ditto::NonNullPtr<Node*> node_double_ptr = &m_root;
   Node* parent = nullptr;
 
   while (*node_double_ptr) {
-    std::unique_ptr<Node>& node_ptr = *node_double_ptr;
+    Node*& node_ptr = *node_double_ptr;
     if (node_ptr->key == key) {
       node_ptr->value = value;
       return;
     }
 
-    parent = node_ptr.get();
+    parent = node_ptr;
     if (key < node_ptr->key) {
       node_double_ptr = &node_ptr->left;
     } else {
@@ -110,209 +387,309 @@ inline void RedBlackTree<K, V>::insert(const K& key, const V& value) {
     }
   }
 
-  *node_double_ptr = std::make_unique<Node>(key, value, parent);
+  *node_double_ptr = create_node(key, value, parent);
+  m_size++;
 
   // Restructure nodes
-  fixup_insertion(node_double_ptr->get());
+  Algorithms::fixup_insertion(m_root, *node_double_ptr);
 }
 
-template <class K, class V>
-inline auto RedBlackTree<K, V>::lookup(const K& key)
+template <class K, class V, class Allocator>
+inline auto RedBlackTree<K, V, Allocator>::lookup(const K& key)
     -> Ditto::optional<Ditto::NonNullPtr<V>> {
-  Node* node = m_root.get();
+  Node* node = m_root;
 
   while (node != nullptr) {
     if (node->key == key) {
       return Ditto::optional<Ditto::NonNullPtr<V>>{
           Ditto::NonNullPtr<V>{&node->value}};
     } else if (key < node->key) {
-      node = node->left.get();
+      node = node->left;
     } else {
-      node = node->right.get();
+      node = node->right;
     }
   }
   return {};
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::fixup_insertion(Ditto::NonNullPtr<Node> node) {
-  auto parent = node->color_and_parent.pointer();
-  if (parent == nullptr) {
-    // This is the root, which should always be black
-    node->color_and_parent.set_color(Color::BLACK);
-  } else if (parent->color_and_parent.color() == Color::BLACK) {
-    // Already good, since parent is black!
-    return;
-  } else {
-    auto grandparent = parent->color_and_parent.pointer();
-    if (grandparent->left.get() == parent) {
-      auto uncle = grandparent->right.get();
-      if (uncle && (uncle->color_and_parent.color() == Color::RED)) {
-        uncle->color_and_parent.swap_color();
-        parent->color_and_parent.swap_color();
-        grandparent->color_and_parent.swap_color();
-        fixup_insertion(grandparent);
-      } else {
-        // Parent is left and uncle is black
-        if (parent->right.get() == node.get()) {
-          rotate_left(parent);
-        }
-        rotate_right(grandparent);
-        Color parent_color = parent->color_and_parent.color();
-        Color grandparent_color = grandparent->color_and_parent.color();
-        grandparent->color_and_parent.set_color(parent_color);
-        parent->color_and_parent.set_color(grandparent_color);
-      }
+template <class K, class V, class Allocator>
+void RedBlackTree<K, V, Allocator>::clear() {
+  // The block of a bulk-loaded tree may or may not come from the storage
+  // released by deallocate_all(), and it cannot be freed beforehand in case
+  // deallocate_all() fails, so bulk-loaded trees are cleared node by node
+  if constexpr (std::is_trivially_destructible_v<Node> &&
+                BulkDeallocatable<NodeAllocator>) {
+    if ((m_block == nullptr) && m_allocator.deallocate_all()) {
+      m_root = nullptr;
+      m_size = 0;
+      return;
+    }
+  }
+
+  // Rotate left children up while freeing the nodes left without one, so that
+  // the whole tree is freed without recursion nor an auxiliary stack
+  Node* node = std::exchange(m_root, nullptr);
+  m_size = 0;
+  while (node != nullptr) {
+    if (node->left != nullptr) {
+      Node* left = node->left;
+      node->left = left->right;
+      left->right = node;
+      node = left;
     } else {
-      auto uncle = grandparent->left.get();
-      if (uncle && (uncle->color_and_parent.color() == Color::RED)) {
-        uncle->color_and_parent.swap_color();
-        parent->color_and_parent.swap_color();
-        grandparent->color_and_parent.swap_color();
-        fixup_insertion(grandparent);
-      } else {
-        // Parent is right and uncle is black
-        if (parent->left.get() == node.get()) {
-          rotate_right(parent);
-        }
-        rotate_left(grandparent);
-        Color parent_color = parent->color_and_parent.color();
-        Color grandparent_color = grandparent->color_and_parent.color();
-        grandparent->color_and_parent.set_color(parent_color);
-        parent->color_and_parent.set_color(grandparent_color);
-      }
+      Node* right = node->right;
+      destroy_node(node);
+      node = right;
     }
   }
+
+  free_block();
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::rotate_right(Ditto::NonNullPtr<Node> node) {
-  auto parent = node->color_and_parent.pointer();
-  std::unique_ptr<Node> new_node = std::move(node->left);
-  std::unique_ptr<Node> prev_right = std::move(new_node->right);
-
-  std::unique_ptr<Node>* parent_ref = nullptr;
-  if (parent == nullptr) {
-    parent_ref = &m_root;
-  } else if (parent->right.get() == node.get()) {
-    parent_ref = &parent->right;
-  } else {
-    parent_ref = &parent->left;
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::from_sorted(
+    Ditto::span<const Pair<K, V>> sorted_entries, const Allocator& allocator)
+    -> RedBlackTree {
+  RedBlackTree tree{allocator};
+  const std::size_t num_entries = sorted_entries.size();
+  if (num_entries == 0) {
+    return tree;
+  }
+  const Pair<K, V>* entries = sorted_entries.data();
+
+  Node* block = NodeAllocatorTraits::allocate(tree.m_allocator, num_entries);
+  for (std::size_t i = 0; i < num_entries; i++) {
+    DITTO_VERIFY((i == 0) || (entries[i - 1].left() < entries[i].left()));
+    NodeAllocatorTraits::construct(tree.m_allocator, &block[i],
+                                   entries[i].left(), entries[i].right(),
+                                   nullptr);
   }
 
-  node->color_and_parent.set_pointer(new_node.get());
-  new_node->right = std::move(*parent_ref);
-
-  new_node->color_and_parent.set_pointer(parent);
-  *parent_ref = std::move(new_node);
+  // Splitting the entries in halves leaves all null children at the last two
+  // levels. Only the last level can be incomplete, so making it red and the
+  // rest black keeps the same number of black nodes on every path.
+  const auto height = static_cast<std::uint32_t>(std::bit_width(num_entries));
+  const std::uint32_t red_depth = (height > 1) ? height - 1 : UINT32_MAX;
+  tree.m_root = link_sorted(block, 0, num_entries, nullptr, 0, red_depth);
+  tree.m_size = num_entries;
+  tree.m_block = block;
+  tree.m_block_size = num_entries;
+  return tree;
+}
 
-  node->left = std::move(prev_right);
-  if (node->left) {
-    node->left->color_and_parent.set_pointer(node.get());
+// Recurses as deep as the resulting tree, which is log2(N) levels
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::link_sorted(Node* nodes, std::size_t first,
+                                                std::size_t last, Node* parent,
+                                                std::uint32_t depth,
+                                                std::uint32_t red_depth)
+    -> Node* {
+  if (first == last) {
+    return nullptr;
   }
+  const std::size_t middle = first + (last - first) / 2;
+  Node* node = &nodes[middle];
+  node->color_and_parent.set_pointer(parent);
+  node->color_and_parent.set_color((depth == red_depth) ? Color::RED
+                                                        : Color::BLACK);
+  node->left = link_sorted(nodes, first, middle, node, depth + 1, red_depth);
+  node->right =
+      link_sorted(nodes, middle + 1, last, node, depth + 1, red_depth);
+  return node;
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::rotate_left(Ditto::NonNullPtr<Node> node) {
-  auto parent = node->color_and_parent.pointer();
-  std::unique_ptr<Node> new_node = std::move(node->right);
-  std::unique_ptr<Node> prev_left = std::move(new_node->left);
-
-  std::unique_ptr<Node>* parent_ref = nullptr;
-  if (parent == nullptr) {
-    parent_ref = &m_root;
-  } else if (parent->right.get() == node.get()) {
-    parent_ref = &parent->right;
-  } else {
-    parent_ref = &parent->left;
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::erase(const K& key) -> Ditto::optional<V> {
+  Node* node = lower_bound_node(key);
+  if ((node == nullptr) || !(node->key == key)) {
+    return {};
   }
+  Algorithms::unlink(m_root, node);
+  Ditto::optional<V> value{std::move(node->value)};
+  destroy_node(node);
+  m_size--;
+  return value;
+}
 
-  node->color_and_parent.set_pointer(new_node.get());
-  new_node->left = std::move(*parent_ref);
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::erase(const_iterator pos) -> iterator {
+  if (pos == cend()) {
+    return end();
+  }
+  // Nodes are relinked rather than having their contents swapped, so the
+  // successor is still valid after erasing
+  Node* next = Algorithms::successor(pos.m_node);
+  Algorithms::unlink(m_root, pos.m_node);
+  destroy_node(pos.m_node);
+  m_size--;
+  return iterator{this, next};
+}
 
-  new_node->color_and_parent.set_pointer(parent);
-  *parent_ref = std::move(new_node);
+template <class K, class V, class Allocator>
+template <std::invocable<const K&, V&> Action>
+void RedBlackTree<K, V, Allocator>::for_each_in_range(const K& first,
+                                                      const K& last,
+                                                      Action action) {
+  for (Node* node = lower_bound_node(first);
+       (node != nullptr) && (node->key < last);
+       node = Algorithms::successor(node)) {
+    action(node->key, node->value);
+  }
+}
 
-  node->right = std::move(prev_left);
-  if (node->right) {
-    node->right->color_and_parent.set_pointer(node.get());
+template <class K, class V, class Allocator>
+template <std::invocable<const K&, const V&> Action>
+void RedBlackTree<K, V, Allocator>::for_each_in_range(const K& first,
+                                                      const K& last,
+                                                      Action action) const {
+  for (Node* node = lower_bound_node(first);
+       (node != nullptr) && (node->key < last);
+       node = Algorithms::successor(node)) {
+    action(node->key, node->value);
   }
 }
 
-template <class K, class V>
-auto RedBlackTree<K, V>::depth_from_node(Node* node, uint32_t current_depth)
-    -> std::uint32_t {
-  if (!node) return current_depth;
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::lower_bound_node(const K& key) const
+    -> Node* {
+  Node* node = m_root;
+  Node* candidate = nullptr;
+  while (node != nullptr) {
+    if (node->key < key) {
+      node = node->right;
+    } else {
+      candidate = node;
+      node = node->left;
+    }
+  }
+  return candidate;
+}
 
-  if (node->left && node->right) {
-    return std::max(depth_from_node(node->left.get(), current_depth + 1),
-                    depth_from_node(node->right.get(), current_depth + 1));
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::upper_bound_node(const K& key) const
+    -> Node* {
+  Node* node = m_root;
+  Node* candidate = nullptr;
+  while (node != nullptr) {
+    if (key < node->key) {
+      candidate = node;
+      node = node->left;
+    } else {
+      node = node->right;
+    }
   }
+  return candidate;
+}
 
-  if (node->left) {
-    return depth_from_node(node->left.get(), current_depth + 1);
+template <class K, class V, class Allocator>
+template <class Action>
+void RedBlackTree<K, V, Allocator>::for_each_node(Node* root, Action action) {
+  TraversalStack stack;
+  Node* node = root;
+  while ((node != nullptr) || !stack.empty()) {
+    while (node != nullptr) {
+      stack.push(node, 0);
+      node = node->left;
+    }
+    node = stack.pop().node;
+    action(node);
+    node = node->right;
   }
+}
 
-  if (node->right) {
-    return depth_from_node(node->right.get(), current_depth + 1);
+template <class K, class V, class Allocator>
+template <class Visitor>
+void RedBlackTree<K, V, Allocator>::for_each_node_preorder(
+    Node* root, std::uint32_t max_depth, Visitor visitor) {
+  if (root == nullptr) {
+    return;
   }
 
-  return current_depth + 1;
+  TraversalStack stack;
+  stack.push(root, 0);
+  while (!stack.empty()) {
+    const Cursor cursor = stack.pop();
+    visitor(cursor.node, cursor.depth);
+    if (cursor.depth == max_depth) {
+      continue;
+    }
+    // The right child is pushed first so that the left one is visited first
+    if (cursor.node->right) {
+      stack.push(cursor.node->right, cursor.depth + 1);
+    }
+    if (cursor.node->left) {
+      stack.push(cursor.node->left, cursor.depth + 1);
+    }
+  }
 }
 
-template <class K, class V>
-auto RedBlackTree<K, V>::depth() const -> std::uint32_t {
-  return depth_from_node(m_root.get(), 0);
+template <class K, class V, class Allocator>
+template <class Visitor>
+void RedBlackTree<K, V, Allocator>::for_each_node_level_order(Node* root,
+                                                              Visitor visitor) {
+  // Walk the tree down to each level in turn, until a level has no nodes
+  for (std::uint32_t level = 0;; level++) {
+    bool found = false;
+    for_each_node_preorder(root, level, [&](Node* node, std::uint32_t depth) {
+      if (depth == level) {
+        found = true;
+        visitor(node, depth);
+      }
+    });
+    if (!found) {
+      return;
+    }
+  }
 }
 
-template <class K, class V>
-void RedBlackTree<K, V>::print() const {
-  if (!m_root) return;
+template <class K, class V, class Allocator>
+template <std::invocable<const K&, V&> Action>
+void RedBlackTree<K, V, Allocator>::for_each(Action action) {
+  for_each_node(m_root, [&](Node* node) { action(node->key, node->value); });
+}
 
-  std::uint32_t tree_depth = depth();
+template <class K, class V, class Allocator>
+template <std::invocable<const K&, const V&> Action>
+void RedBlackTree<K, V, Allocator>::for_each(Action action) const {
+  for_each_node(m_root, [&](const Node* node) {
+    action(node->key, node->value);
+  });
+}
 
-  Ditto::LinkedList<Node*> nodes;
-  nodes.push_back(m_root.get());
+template <class K, class V, class Allocator>
+template <std::invocable<const K&, const V&, std::uint32_t> Visitor>
+void RedBlackTree<K, V, Allocator>::visit_level_order(Visitor visitor) const {
+  for_each_node_level_order(m_root, [&](const Node* node, std::uint32_t depth) {
+    visitor(node->key, node->value, depth);
+  });
+}
 
-  uint32_t current_depth = 0;
-  uint32_t node_count = 0;
-  bool empty_level = true;
+template <class K, class V, class Allocator>
+auto RedBlackTree<K, V, Allocator>::depth() const -> std::uint32_t {
+  std::uint32_t tree_depth = 0;
+  for_each_node_preorder(m_root, UINT32_MAX,
+                         [&](Node* /*unused*/, std::uint32_t depth) {
+                           tree_depth = std::max(tree_depth, depth + 1);
+                         });
+  return tree_depth;
+}
 
-  while (true) {
-    Node* node = nodes.front();
-    if (node == nullptr) {
-      printf("             ");
-      // dummy children (just to make sure the spacing is kept)
-      nodes.push_back(nullptr);
-      nodes.push_back(nullptr);
-    } else {
-      empty_level = false;  // the level is not empty, should scan next
-      const auto node_idx = (node_count + 1) % (1 << current_depth);
-      if (node->color_and_parent.color() == Color::RED) {
-        // Color RED
-        printf("\u001b[31m");
-      }
-      printf("%4d:%4d    \u001b[0m", node_idx, node->key);
-      // Push children to the list
-      nodes.push_back(node->left.get());
-      nodes.push_back(node->right.get());
-    }
+template <class K, class V, class Allocator>
+void RedBlackTree<K, V, Allocator>::print() const {
+  if (!m_root) return;
 
-    node_count++;
-    const auto max_node_count_at_depth = 2 * (1 << current_depth) - 1;
-    if (node_count >= max_node_count_at_depth) {
-      // Go to next level
+  // One line per level, with red nodes printed in red
+  std::uint32_t current_depth = 0;
+  for_each_node_level_order(m_root, [&](Node* node, std::uint32_t depth) {
+    if (depth != current_depth) {
       printf("\n");
-      current_depth++;
-      if (empty_level) {
-        // Done!
-        return;
-      }
-      empty_level = true;
+      current_depth = depth;
     }
-
-    nodes.pop_front();
-  }
+    if (node->color_and_parent.color() == Color::RED) {
+      printf("\u001b[31m");
+    }
+    printf("%4d    \u001b[0m", node->key);
+  });
   printf("\n");
 }
 
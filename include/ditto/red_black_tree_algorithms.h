@@ -0,0 +1,412 @@
+#ifndef DITTO_RED_BLACK_TREE_ALGORITHMS_H_
+#define DITTO_RED_BLACK_TREE_ALGORITHMS_H_
+
+#include <cstdint>
+#include <initializer_list>
+#include <utility>
+
+#include "ditto/assert.h"
+#include "ditto/non_null_ptr.h"
+
+namespace Ditto {
+
+enum class NodeColor { RED = 0x00, BLACK = 0x01 };
+
+/**
+ * @brief Pointer to the parent of a red-black tree node, with the color of the
+ * node packed in its lowest bits, which are always zero for nodes aligned to
+ * 4 bytes.
+ */
+template <class T>
+class PointerAndColor {
+ public:
+  PointerAndColor(T* node, NodeColor color = NodeColor::RED) {
+    // The node pointer must be aligned to 4 bytes
+    const uintptr_t node_ptr = reinterpret_cast<std::uintptr_t>(node);
+    DITTO_VERIFY((node_ptr & COLOR_MASK) == 0);
+
+    m_value = node_ptr | static_cast<std::uintptr_t>(color);
+  }
+
+  NodeColor color() const { return static_cast<NodeColor>(m_value & 0x3); }
+  T* pointer() const { return reinterpret_cast<T*>(m_value & PTR_MASK); }
+
+  void set_pointer(T* node) {
+    const auto ptr = reinterpret_cast<std::uintptr_t>(node);
+    DITTO_VERIFY((ptr & COLOR_MASK) == 0);
+    m_value &= COLOR_MASK;
+    m_value |= ptr;
+  }
+
+  void set_color(NodeColor color) {
+    const auto color_val = static_cast<std::uintptr_t>(color);
+    m_value &= PTR_MASK;
+    m_value |= color_val;
+  }
+
+  void swap_color() {
+    if (color() == NodeColor::BLACK) {
+      set_color(NodeColor::RED);
+    } else {
+      set_color(NodeColor::BLACK);
+    }
+  }
+
+ private:
+  std::uintptr_t m_value;
+  constexpr static std::uintptr_t COLOR_MASK = std::uintptr_t{0x03};
+  constexpr static std::uintptr_t PTR_MASK = ~COLOR_MASK;
+};
+
+namespace detail {
+
+/**
+ * @brief Navigation and rebalancing of red-black trees, shared by
+ * Ditto::RedBlackTree and Ditto::IntrusiveRedBlackTree.
+ *
+ * Nodes have a PointerAndColor<Node> color_and_parent member and Node* left
+ * and right members. Functions that may change the root of the tree take a
+ * reference to the pointer to it.
+ */
+template <class Node>
+struct RedBlackTreeAlgorithms {
+  static auto parent_of(Node* node) -> Node* {
+    return node->color_and_parent.pointer();
+  }
+  // Null leaves are black
+  static auto is_black(Node* node) -> bool {
+    return (node == nullptr) ||
+           (node->color_and_parent.color() == NodeColor::BLACK);
+  }
+  static auto leftmost(Node* node) -> Node*;
+  static auto rightmost(Node* node) -> Node*;
+  static auto successor(Node* node) -> Node*;
+  static auto predecessor(Node* node) -> Node*;
+
+  // Returns the link that points to the node, either from its parent or root
+  static auto owner_of(Node*& root, Ditto::NonNullPtr<Node> node) -> Node*&;
+
+  // Rebalances the tree after linking a new red node as a leaf
+  static void fixup_insertion(Node*& root, Ditto::NonNullPtr<Node> node);
+
+  // Removes the node from the tree, leaving the rest of the nodes in place
+  static void unlink(Node*& root, Ditto::NonNullPtr<Node> node);
+
+  static void swap_with_successor(Node*& root, Ditto::NonNullPtr<Node> node);
+  static void fixup_erasure(Node*& root, Ditto::NonNullPtr<Node> node);
+  static void rotate_right(Node*& root, Ditto::NonNullPtr<Node> node);
+  static void rotate_left(Node*& root, Ditto::NonNullPtr<Node> node);
+
+  // Returns the number of black nodes on every path from the node down to a
+  // leaf, or -1 if paths differ, a red node has a red child or a child does
+  // not point back to its parent. Recurses as deep as the subtree.
+  static auto black_height(Node* node) -> std::int32_t;
+};
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::leftmost(Node* node) -> Node* {
+  if (node != nullptr) {
+    while (node->left) {
+      node = node->left;
+    }
+  }
+  return node;
+}
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::rightmost(Node* node) -> Node* {
+  if (node != nullptr) {
+    while (node->right) {
+      node = node->right;
+    }
+  }
+  return node;
+}
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::successor(Node* node) -> Node* {
+  if (node->right) {
+    return leftmost(node->right);
+  }
+  // Climb until we come from a left subtree
+  Node* parent = parent_of(node);
+  while ((parent != nullptr) && (parent->right == node)) {
+    node = parent;
+    parent = parent_of(node);
+  }
+  return parent;
+}
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::predecessor(Node* node) -> Node* {
+  if (node->left) {
+    return rightmost(node->left);
+  }
+  // Climb until we come from a right subtree
+  Node* parent = parent_of(node);
+  while ((parent != nullptr) && (parent->left == node)) {
+    node = parent;
+    parent = parent_of(node);
+  }
+  return parent;
+}
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::owner_of(
+    Node*& root, Ditto::NonNullPtr<Node> node) -> Node*& {
+  Node* parent = parent_of(node.get());
+  if (parent == nullptr) {
+    return root;
+  }
+  if (parent->left == node.get()) {
+    return parent->left;
+  }
+  return parent->right;
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::unlink(Node*& root,
+                                          Ditto::NonNullPtr<Node> node) {
+  if (node->left && node->right) {
+    // Move the node to the position of its successor, which has no left
+    // child, so that it is left with at most one child
+    swap_with_successor(root, node);
+  }
+
+  Node* child = node->left ? node->left : node->right;
+  if (is_black(node.get())) {
+    if (!is_black(child)) {
+      child->color_and_parent.set_color(NodeColor::BLACK);
+    } else {
+      // A black node with a single child always has a red child, so this is a
+      // black leaf. Removing it would shorten the black height of its path,
+      // so rebalance while it is still in place, acting as the missing leaf
+      fixup_erasure(root, node);
+    }
+  }
+
+  Node* replacement = node->left ? node->left : node->right;
+  if (replacement != nullptr) {
+    replacement->color_and_parent.set_pointer(parent_of(node.get()));
+  }
+  owner_of(root, node) = replacement;
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::swap_with_successor(
+    Node*& root, Ditto::NonNullPtr<Node> node) {
+  Node* successor = leftmost(node->right);
+  Node* parent = parent_of(node.get());
+  Node*& owner = owner_of(root, node);
+
+  if (node->right == successor) {
+    node->right = successor->right;
+    successor->right = node.get();
+  } else {
+    Node* successor_parent = parent_of(successor);
+    successor_parent->left = node.get();
+    std::swap(node->right, successor->right);
+    node->color_and_parent.set_pointer(successor_parent);
+  }
+  successor->left = std::exchange(node->left, nullptr);
+  owner = successor;
+
+  successor->color_and_parent.set_pointer(parent);
+  for (Node* reparented : {node.get(), successor}) {
+    if (reparented->left) {
+      reparented->left->color_and_parent.set_pointer(reparented);
+    }
+    if (reparented->right) {
+      reparented->right->color_and_parent.set_pointer(reparented);
+    }
+  }
+
+  const NodeColor node_color = node->color_and_parent.color();
+  node->color_and_parent.set_color(successor->color_and_parent.color());
+  successor->color_and_parent.set_color(node_color);
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::fixup_erasure(
+    Node*& root, Ditto::NonNullPtr<Node> node) {
+  // The path through node is one black node short
+  Node* current = node.get();
+  while ((parent_of(current) != nullptr) && is_black(current)) {
+    Node* parent = parent_of(current);
+    if (parent->left == current) {
+      Node* sibling = parent->right;
+      if (!is_black(sibling)) {
+        sibling->color_and_parent.set_color(NodeColor::BLACK);
+        parent->color_and_parent.set_color(NodeColor::RED);
+        rotate_left(root, parent);
+        sibling = parent->right;
+      }
+      if (is_black(sibling->left) && is_black(sibling->right)) {
+        // Move the missing black node up
+        sibling->color_and_parent.set_color(NodeColor::RED);
+        current = parent;
+        continue;
+      }
+      if (is_black(sibling->right)) {
+        sibling->left->color_and_parent.set_color(NodeColor::BLACK);
+        sibling->color_and_parent.set_color(NodeColor::RED);
+        rotate_right(root, sibling);
+        sibling = parent->right;
+      }
+      sibling->color_and_parent.set_color(parent->color_and_parent.color());
+      parent->color_and_parent.set_color(NodeColor::BLACK);
+      sibling->right->color_and_parent.set_color(NodeColor::BLACK);
+      rotate_left(root, parent);
+    } else {
+      Node* sibling = parent->left;
+      if (!is_black(sibling)) {
+        sibling->color_and_parent.set_color(NodeColor::BLACK);
+        parent->color_and_parent.set_color(NodeColor::RED);
+        rotate_right(root, parent);
+        sibling = parent->left;
+      }
+      if (is_black(sibling->left) && is_black(sibling->right)) {
+        // Move the missing black node up
+        sibling->color_and_parent.set_color(NodeColor::RED);
+        current = parent;
+        continue;
+      }
+      if (is_black(sibling->left)) {
+        sibling->right->color_and_parent.set_color(NodeColor::BLACK);
+        sibling->color_and_parent.set_color(NodeColor::RED);
+        rotate_left(root, sibling);
+        sibling = parent->left;
+      }
+      sibling->color_and_parent.set_color(parent->color_and_parent.color());
+      parent->color_and_parent.set_color(NodeColor::BLACK);
+      sibling->left->color_and_parent.set_color(NodeColor::BLACK);
+      rotate_right(root, parent);
+    }
+    // The tree is balanced again
+    return;
+  }
+  current->color_and_parent.set_color(NodeColor::BLACK);
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::fixup_insertion(
+    Node*& root, Ditto::NonNullPtr<Node> node) {
+  auto parent = node->color_and_parent.pointer();
+  if (parent == nullptr) {
+    // This is the root, which should always be black
+    node->color_and_parent.set_color(NodeColor::BLACK);
+  } else if (parent->color_and_parent.color() == NodeColor::BLACK) {
+    // Already good, since parent is black!
+    return;
+  } else {
+    auto grandparent = parent->color_and_parent.pointer();
+    if (grandparent->left == parent) {
+      auto uncle = grandparent->right;
+      if (uncle && (uncle->color_and_parent.color() == NodeColor::RED)) {
+        uncle->color_and_parent.swap_color();
+        parent->color_and_parent.swap_color();
+        grandparent->color_and_parent.swap_color();
+        fixup_insertion(root, grandparent);
+      } else {
+        // Parent is left and uncle is black
+        if (parent->right == node.get()) {
+          rotate_left(root, parent);
+          // The node took the place of its parent
+          parent = node.get();
+        }
+        rotate_right(root, grandparent);
+        NodeColor parent_color = parent->color_and_parent.color();
+        NodeColor grandparent_color = grandparent->color_and_parent.color();
+        grandparent->color_and_parent.set_color(parent_color);
+        parent->color_and_parent.set_color(grandparent_color);
+      }
+    } else {
+      auto uncle = grandparent->left;
+      if (uncle && (uncle->color_and_parent.color() == NodeColor::RED)) {
+        uncle->color_and_parent.swap_color();
+        parent->color_and_parent.swap_color();
+        grandparent->color_and_parent.swap_color();
+        fixup_insertion(root, grandparent);
+      } else {
+        // Parent is right and uncle is black
+        if (parent->left == node.get()) {
+          rotate_right(root, parent);
+          // The node took the place of its parent
+          parent = node.get();
+        }
+        rotate_left(root, grandparent);
+        NodeColor parent_color = parent->color_and_parent.color();
+        NodeColor grandparent_color = grandparent->color_and_parent.color();
+        grandparent->color_and_parent.set_color(parent_color);
+        parent->color_and_parent.set_color(grandparent_color);
+      }
+    }
+  }
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::rotate_right(Node*& root,
+                                               Ditto::NonNullPtr<Node> node) {
+  auto parent = node->color_and_parent.pointer();
+  Node*& parent_ref = owner_of(root, node);
+  Node* new_node = node->left;
+
+  node->left = new_node->right;
+  if (node->left) {
+    node->left->color_and_parent.set_pointer(node.get());
+  }
+
+  new_node->right = node.get();
+  node->color_and_parent.set_pointer(new_node);
+
+  new_node->color_and_parent.set_pointer(parent);
+  parent_ref = new_node;
+}
+
+template <class Node>
+void RedBlackTreeAlgorithms<Node>::rotate_left(Node*& root,
+                                               Ditto::NonNullPtr<Node> node) {
+  auto parent = node->color_and_parent.pointer();
+  Node*& parent_ref = owner_of(root, node);
+  Node* new_node = node->right;
+
+  node->right = new_node->left;
+  if (node->right) {
+    node->right->color_and_parent.set_pointer(node.get());
+  }
+
+  new_node->left = node.get();
+  node->color_and_parent.set_pointer(new_node);
+
+  new_node->color_and_parent.set_pointer(parent);
+  parent_ref = new_node;
+}
+
+template <class Node>
+auto RedBlackTreeAlgorithms<Node>::black_height(Node* node) -> std::int32_t {
+  if (node == nullptr) {
+    return 0;
+  }
+
+  for (Node* child : {node->left, node->right}) {
+    if (child == nullptr) {
+      continue;
+    }
+    if ((parent_of(child) != node) || (!is_black(node) && !is_black(child))) {
+      return -1;
+    }
+  }
+
+  const std::int32_t left = black_height(node->left);
+  const std::int32_t right = black_height(node->right);
+  if ((left < 0) || (left != right)) {
+    return -1;
+  }
+  return left + (is_black(node) ? 1 : 0);
+}
+
+}  // namespace detail
+
+}  // namespace Ditto
+
+#endif  // DITTO_RED_BLACK_TREE_ALGORITHMS_H_
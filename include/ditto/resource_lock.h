@@ -3,14 +3,162 @@
 
 #include <stdint.h>
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
 #include <mutex>
+#include <shared_mutex>
 #include <type_traits>
 #include <utility>
 
+#include "ditto/assert.h"
+#include "ditto/optional.h"
 #include "ditto/type_traits.h"
 
 namespace Ditto {
 
+/**
+ * @brief Mutex types that can be locked with a timeout, like std::timed_mutex.
+ */
+template <class M>
+concept TimedLockable =
+    requires(M m, std::chrono::milliseconds timeout,
+             std::chrono::steady_clock::time_point deadline) {
+  { m.try_lock_for(timeout) } -> std::convertible_to<bool>;
+  { m.try_lock_until(deadline) } -> std::convertible_to<bool>;
+};
+
+namespace detail {
+
+/**
+ * @brief Mutex types that can be told which stack frame holds them, like
+ * Ditto::ProfiledMutex.
+ */
+template <class M>
+concept HolderTracking = requires(M m, const void* frame) {
+  m.set_holder_frame(frame);
+};
+
+/**
+ * @brief Tells a mutex held exclusively which frame holds it, so that it can
+ * leave the frames of the lock types out of what it records.
+ */
+template <class M>
+inline void set_holder_frame(M& mutex, const void* frame) {
+  if constexpr (HolderTracking<M>) {
+    mutex.set_holder_frame(frame);
+  }
+}
+
+/**
+ * @brief Runs the action only if the lock was acquired. Returns whether the
+ * action ran or, if the action returns a value, an optional holding it.
+ */
+template <class Lock, class Action, class Resource>
+inline auto invoke_if_owned(const Lock& lock, Action& action,
+                            Resource& resource) {
+  if constexpr (Ditto::returns_void_v<Action&, Resource&>) {
+    if (!lock.owns_lock()) {
+      return false;
+    }
+    action(resource);
+    return true;
+  } else {
+    using Value = std::decay_t<std::invoke_result_t<Action&, Resource&>>;
+    if (!lock.owns_lock()) {
+      return Ditto::optional<Value>{};
+    }
+    return Ditto::optional<Value>{action(resource)};
+  }
+}
+
+/**
+ * @brief Mutex of any type, locked and unlocked through function pointers.
+ */
+struct ErasedMutex {
+  void* mutex;
+  void (*lock)(void*);
+  void (*unlock)(void*);
+};
+
+template <class M>
+auto erase_mutex(M& mutex) -> ErasedMutex {
+  return {
+      &mutex,
+      [](void* ptr) { static_cast<M*>(ptr)->lock(); },
+      [](void* ptr) { static_cast<M*>(ptr)->unlock(); },
+  };
+}
+
+/**
+ * @brief Locks a set of mutexes, possibly of different types, in order of
+ * increasing address and unlocks them in reverse order when destroyed.
+ *
+ * As long as every thread that needs more than one of them goes through this
+ * class, they all acquire them in the same global order and cannot deadlock.
+ * Unlike std::scoped_lock, it does not need try_lock() nor retries.
+ */
+template <std::size_t N>
+class OrderedMultiLock {
+ public:
+  explicit OrderedMultiLock(std::array<ErasedMutex, N> mutexes)
+      : m_mutexes(mutexes) {
+    std::sort(m_mutexes.begin(), m_mutexes.end(),
+              [](const ErasedMutex& a, const ErasedMutex& b) {
+                return std::less<void*>{}(a.mutex, b.mutex);
+              });
+    for (std::size_t i = 1; i < N; i++) {
+      // Locking the same mutex twice would deadlock
+      DITTO_VERIFY(m_mutexes[i - 1].mutex != m_mutexes[i].mutex);
+    }
+
+    for (const ErasedMutex& mutex : m_mutexes) {
+      mutex.lock(mutex.mutex);
+    }
+  }
+
+  ~OrderedMultiLock() {
+    for (auto it = m_mutexes.rbegin(); it != m_mutexes.rend(); ++it) {
+      it->unlock(it->mutex);
+    }
+  }
+
+  OrderedMultiLock(const OrderedMultiLock&) = delete;
+  OrderedMultiLock(OrderedMultiLock&&) = delete;
+  auto operator=(const OrderedMultiLock&) -> OrderedMultiLock& = delete;
+  auto operator=(OrderedMultiLock&&) -> OrderedMultiLock& = delete;
+
+ private:
+  std::array<ErasedMutex, N> m_mutexes;
+};
+
+}  // namespace detail
+
+template <class T, class M>
+class ResourceLock;
+
+/**
+ * @brief Locks all the given resources and runs the action with all of them.
+ *
+ * The mutexes are always acquired in the same global order, so concurrent
+ * calls over overlapping sets of resources cannot deadlock regardless of the
+ * order in which the resources are passed. Each resource can only be passed
+ * once.
+ */
+template <class Action, class... Ts, class... Ms>
+auto lock_all(Action action, ResourceLock<Ts, Ms>&... resources);
+
+/**
+ * @brief Wraps a resource so that it can only be accessed with its mutex
+ * locked.
+ *
+ * Copying or moving a ResourceLock locks the source while its resource is
+ * copied or moved out, and assigning to one also locks the destination. The
+ * two mutexes are never held at the same time, so concurrent assignments in
+ * opposite directions cannot deadlock.
+ */
 template <class T, class M>
 class ResourceLock {
  public:
@@ -18,103 +166,318 @@ class ResourceLock {
   constexpr explicit ResourceLock(Args... args)
       : m_resource(std::forward<Args>(args)...) {}
 
+  ResourceLock(const ResourceLock& other) : m_resource(other.copy_resource()) {}
+
+  ResourceLock(ResourceLock&& other) : m_resource(other.take_resource()) {}
+
+  auto operator=(const ResourceLock& other) -> ResourceLock& {
+    T resource = other.copy_resource();
+    lock([&](T& res) { res = std::move(resource); });
+    return *this;
+  }
+
+  auto operator=(ResourceLock&& other) -> ResourceLock& {
+    T resource = other.take_resource();
+    lock([&](T& res) { res = std::move(resource); });
+    return *this;
+  }
+
   template <class Action,
             std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
   inline auto lock(Action action) {
     std::scoped_lock<M> lock{m_mutex};
+    detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
     return action(m_resource);
   }
 
-  // TODO(javier-varez): Handle copy and move constructors and assignment
-  // operators to also lock the object when reading from it. For now these two
-  // operations are disallowed
-  ResourceLock(const ResourceLock&) = delete;
-  ResourceLock(ResourceLock&&) = delete;
-  auto operator=(const ResourceLock&) -> ResourceLock& = delete;
-  auto operator=(ResourceLock&&) -> ResourceLock& = delete;
+  /**
+   * @brief Runs the action only if the mutex can be locked without blocking.
+   * Returns true if a void action ran, or an optional with the result of the
+   * action, which is empty if the mutex was contended.
+   */
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  inline auto try_lock(Action action) {
+    std::unique_lock<M> lock{m_mutex, std::try_to_lock};
+    if (lock.owns_lock()) {
+      detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
+    }
+    return detail::invoke_if_owned(lock, action, m_resource);
+  }
+
+  /**
+   * @brief Like try_lock(), but waits up to the given timeout for the mutex.
+   */
+  template <class Rep, class Period, class Action,
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  requires TimedLockable<M>
+  inline auto try_lock_for(const std::chrono::duration<Rep, Period>& timeout,
+                           Action action) {
+    std::unique_lock<M> lock{m_mutex, timeout};
+    if (lock.owns_lock()) {
+      detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
+    }
+    return detail::invoke_if_owned(lock, action, m_resource);
+  }
 
  private:
-  M m_mutex;
+  mutable M m_mutex;
   T m_resource;
+
+  template <class Action, class... Ts, class... Ms>
+  friend auto lock_all(Action action, ResourceLock<Ts, Ms>&... resources);
+
+  auto copy_resource() const -> T {
+    std::scoped_lock<M> lock{m_mutex};
+    return m_resource;
+  }
+
+  auto take_resource() -> T {
+    std::scoped_lock<M> lock{m_mutex};
+    return std::move(m_resource);
+  }
 };
 
+template <class Action, class... Ts, class... Ms>
+auto lock_all(Action action, ResourceLock<Ts, Ms>&... resources) {
+  static_assert(sizeof...(resources) > 0, "At least one resource is needed");
+  static_assert(std::is_invocable_v<Action, Ts&...>,
+                "The action must take a reference to every resource");
+
+  detail::OrderedMultiLock<sizeof...(resources)> lock{
+      {detail::erase_mutex(resources.m_mutex)...}};
+  return action(resources.m_resource...);
+}
+
+/**
+ * @brief Mutex types that can also be locked in shared mode, like
+ * std::shared_mutex or Ditto::SharedMutex.
+ */
+template <class M>
+concept SharedLockable = requires(M m) {
+  m.lock();
+  m.unlock();
+  m.lock_shared();
+  m.unlock_shared();
+};
+
+/**
+ * @brief Shared mutex types that can also be locked in shared mode with a
+ * timeout, like std::shared_timed_mutex.
+ */
+template <class M>
+concept SharedTimedLockable =
+    SharedLockable<M> && TimedLockable<M> &&
+    requires(M m, std::chrono::milliseconds timeout,
+             std::chrono::steady_clock::time_point deadline) {
+  { m.try_lock_shared_for(timeout) } -> std::convertible_to<bool>;
+  { m.try_lock_shared_until(deadline) } -> std::convertible_to<bool>;
+};
+
+namespace detail {
+
+/**
+ * @brief Adds shared locking on top of a plain mutex type. The first reader
+ * takes the global mutex and the last one releases it, while a second mutex
+ * guards the count of readers.
+ */
+template <class M>
+class ReaderCountingMutex {
+ public:
+  void lock() { m_global_mutex.lock(); }
+  auto try_lock() -> bool { return m_global_mutex.try_lock(); }
+  void unlock() { m_global_mutex.unlock(); }
+
+  void set_holder_frame(const void* frame) requires HolderTracking<M> {
+    m_global_mutex.set_holder_frame(frame);
+  }
+
+  template <class Rep, class Period>
+  requires TimedLockable<M>
+  auto try_lock_for(const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return m_global_mutex.try_lock_for(timeout);
+  }
+
+  template <class Clock, class Duration>
+  requires TimedLockable<M>
+  auto try_lock_until(const std::chrono::time_point<Clock, Duration>& deadline)
+      -> bool {
+    return m_global_mutex.try_lock_until(deadline);
+  }
+
+  void lock_shared() {
+    std::scoped_lock<M> r_lock{m_read_mutex};
+    m_num_readers++;
+    if (m_num_readers == 1) {
+      m_global_mutex.lock();
+    }
+  }
+
+  auto try_lock_shared() -> bool {
+    // The first reader holds the read mutex while it waits for a writer, so
+    // it must not be waited for either
+    std::unique_lock<M> r_lock{m_read_mutex, std::try_to_lock};
+    if (!r_lock.owns_lock()) {
+      return false;
+    }
+    return add_reader([this] { return m_global_mutex.try_lock(); });
+  }
+
+  template <class Rep, class Period>
+  requires TimedLockable<M>
+  auto try_lock_shared_for(const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return try_lock_shared_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <class Clock, class Duration>
+  requires TimedLockable<M>
+  auto try_lock_shared_until(
+      const std::chrono::time_point<Clock, Duration>& deadline) -> bool {
+    std::unique_lock<M> r_lock{m_read_mutex, deadline};
+    if (!r_lock.owns_lock()) {
+      return false;
+    }
+    return add_reader([&] { return m_global_mutex.try_lock_until(deadline); });
+  }
+
+  void unlock_shared() {
+    std::scoped_lock<M> r_lock{m_read_mutex};
+    m_num_readers--;
+    if (m_num_readers == 0) {
+      m_global_mutex.unlock();
+    }
+  }
+
+ private:
+  std::uint32_t m_num_readers = 0;
+  M m_read_mutex;
+  M m_global_mutex;
+
+  // Must be called with the read mutex held
+  template <class TryLockGlobal>
+  auto add_reader(TryLockGlobal try_lock_global) -> bool {
+    if ((m_num_readers == 0) && !try_lock_global()) {
+      return false;
+    }
+    m_num_readers++;
+    return true;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @brief Wraps a resource that can be accessed by many readers at the same
+ * time or by a single writer.
+ *
+ * If M is SharedLockable (e.g.: Ditto::SharedMutex) it is used directly.
+ * Otherwise, shared locking is emulated with two instances of M.
+ *
+ * Copying or moving follows the same rules as Ditto::ResourceLock, with the
+ * source only being locked for reading when it is copied.
+ */
 template <class T, class M>
 class ReadWriteLock {
+  using Mutex = std::conditional_t<SharedLockable<M>, M,
+                                   detail::ReaderCountingMutex<M>>;
+
  public:
   template <class... Args>
   constexpr explicit ReadWriteLock(Args... args)
       : m_resource(std::forward<Args>(args)...) {}
 
+  ReadWriteLock(const ReadWriteLock& other)
+      : m_resource(other.copy_resource()) {}
+
+  ReadWriteLock(ReadWriteLock&& other) : m_resource(other.take_resource()) {}
+
+  auto operator=(const ReadWriteLock& other) -> ReadWriteLock& {
+    T resource = other.copy_resource();
+    write_lock([&](T& res) { res = std::move(resource); });
+    return *this;
+  }
+
+  auto operator=(ReadWriteLock&& other) -> ReadWriteLock& {
+    T resource = other.take_resource();
+    write_lock([&](T& res) { res = std::move(resource); });
+    return *this;
+  }
+
   template <class Action,
             std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
   inline auto write_lock(Action action) {
-    std::scoped_lock<M> lock{m_global_mutex};
+    std::scoped_lock<Mutex> lock{m_mutex};
+    detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
     return action(m_resource);
   }
 
   template <class Action,
-            std::enable_if_t<std::is_invocable_v<Action, const T&> &&
-                                 !Ditto::returns_void_v<Action, const T&>,
-                             bool> = false>
-  inline auto read_lock(Action action) {
-    {
-      std::scoped_lock<M> r_lock{m_read_mutex};
-      m_num_readers++;
-      if (m_num_readers == 1) {
-        m_global_mutex.lock();
-      }
-    }
-
-    auto retval = action(static_cast<const T>(m_resource));
-
-    {
-      std::scoped_lock<M> r_lock{m_read_mutex};
-      m_num_readers--;
-      if (m_num_readers == 0) {
-        m_global_mutex.unlock();
-      }
-    }
-
-    return retval;
+            std::enable_if_t<std::is_invocable_v<Action, const T&>, bool> =
+                false>
+  inline auto read_lock(Action action) const {
+    std::shared_lock<Mutex> lock{m_mutex};
+    return action(m_resource);
   }
 
+  /**
+   * @brief Runs the action only if the lock can be acquired without blocking.
+   * Returns the same as Ditto::ResourceLock::try_lock().
+   */
   template <class Action,
-            std::enable_if_t<std::is_invocable_v<Action, const T&> &&
-                                 Ditto::returns_void_v<Action, const T&>,
-                             bool> = false>
-  inline void read_lock(Action action) {
-    {
-      std::scoped_lock<M> r_lock{m_read_mutex};
-      m_num_readers++;
-      if (m_num_readers == 1) {
-        m_global_mutex.lock();
-      }
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  inline auto try_write_lock(Action action) {
+    std::unique_lock<Mutex> lock{m_mutex, std::try_to_lock};
+    if (lock.owns_lock()) {
+      detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
     }
+    return detail::invoke_if_owned(lock, action, m_resource);
+  }
 
-    action(static_cast<const T>(m_resource));
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, const T&>, bool> =
+                false>
+  inline auto try_read_lock(Action action) const {
+    std::shared_lock<Mutex> lock{m_mutex, std::try_to_lock};
+    return detail::invoke_if_owned(lock, action, m_resource);
+  }
 
-    {
-      std::scoped_lock<M> r_lock{m_read_mutex};
-      m_num_readers--;
-      if (m_num_readers == 0) {
-        m_global_mutex.unlock();
-      }
+  template <class Rep, class Period, class Action,
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  requires TimedLockable<Mutex>
+  inline auto try_write_lock_for(
+      const std::chrono::duration<Rep, Period>& timeout, Action action) {
+    std::unique_lock<Mutex> lock{m_mutex, timeout};
+    if (lock.owns_lock()) {
+      detail::set_holder_frame(m_mutex, __builtin_frame_address(0));
     }
+    return detail::invoke_if_owned(lock, action, m_resource);
   }
 
-  // TODO(javier-varez): Handle copy and move constructors and assignment
-  // operators to also lock the object when reading from it. For now these two
-  // operations are disallowed
-  ReadWriteLock(const ReadWriteLock&) = delete;
-  ReadWriteLock(ReadWriteLock&&) = delete;
-  auto operator=(const ReadWriteLock&) -> ReadWriteLock& = delete;
-  auto operator=(ReadWriteLock&&) -> ReadWriteLock& = delete;
+  template <class Rep, class Period, class Action,
+            std::enable_if_t<std::is_invocable_v<Action, const T&>, bool> =
+                false>
+  requires SharedTimedLockable<Mutex>
+  inline auto try_read_lock_for(
+      const std::chrono::duration<Rep, Period>& timeout, Action action) const {
+    std::shared_lock<Mutex> lock{m_mutex, timeout};
+    return detail::invoke_if_owned(lock, action, m_resource);
+  }
 
  private:
-  std::uint32_t m_num_readers = 0;
-  M m_read_mutex;
-  M m_global_mutex;
+  mutable Mutex m_mutex;
   T m_resource;
+
+  auto copy_resource() const -> T {
+    std::shared_lock<Mutex> lock{m_mutex};
+    return m_resource;
+  }
+
+  auto take_resource() -> T {
+    std::scoped_lock<Mutex> lock{m_mutex};
+    return std::move(m_resource);
+  }
 };
 
 }  // namespace Ditto
@@ -0,0 +1,150 @@
+#ifndef DITTO_SEQ_LOCK_H_
+#define DITTO_SEQ_LOCK_H_
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/type_traits.h"
+
+namespace Ditto {
+
+/**
+ * @brief Wraps a small trivially copyable resource (statistics, settings...)
+ * behind a sequence lock.
+ *
+ * Readers copy the value and retry if a writer modified it in the meantime,
+ * detected because the sequence number changed. Reads therefore never write
+ * shared memory and never block the writer, at the cost of working on a copy.
+ * Writers are serialized among themselves and bump the sequence number before
+ * and after updating the value.
+ *
+ * The value is stored as an array of atomic words so that the concurrent
+ * accesses of readers and writers are well defined.
+ */
+template <class T>
+class SeqLock {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "SeqLock can only hold trivially copyable types");
+
+ public:
+  template <class... Args>
+  explicit SeqLock(Args... args) {
+    write_words(T{std::forward<Args>(args)...});
+  }
+
+  /**
+   * @brief Runs the action with exclusive access to the resource. Readers
+   * running at the same time will retry.
+   */
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, T&>, bool> = false>
+  inline auto lock(Action action) {
+    const std::uint32_t sequence = begin_write();
+    T value = read_words();
+
+    if constexpr (Ditto::returns_void_v<Action, T&>) {
+      action(value);
+      end_write(sequence, value);
+    } else {
+      auto retval = action(value);
+      end_write(sequence, value);
+      return retval;
+    }
+  }
+
+  /**
+   * @brief Runs the action on a consistent snapshot of the resource.
+   */
+  template <class Action,
+            std::enable_if_t<std::is_invocable_v<Action, const T&>, bool> =
+                false>
+  inline auto read_lock(Action action) const {
+    const T snapshot = load();
+    return action(snapshot);
+  }
+
+  /**
+   * @brief Returns a consistent snapshot of the resource.
+   */
+  [[nodiscard]] auto load() const -> T {
+    while (true) {
+      const std::uint32_t sequence =
+          m_sequence.load(std::memory_order_acquire);
+      if ((sequence & 1) != 0) {
+        // A write is in progress
+        continue;
+      }
+
+      const T value = read_words();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (m_sequence.load(std::memory_order_relaxed) == sequence) {
+        return value;
+      }
+    }
+  }
+
+  void store(const T& value) {
+    const std::uint32_t sequence = begin_write();
+    end_write(sequence, value);
+  }
+
+  SeqLock(const SeqLock&) = delete;
+  SeqLock(SeqLock&&) = delete;
+  auto operator=(const SeqLock&) -> SeqLock& = delete;
+  auto operator=(SeqLock&&) -> SeqLock& = delete;
+
+ private:
+  using Word = std::uintptr_t;
+  static constexpr std::size_t NUM_WORDS =
+      (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  // Even while stable, odd while a write is in progress
+  std::atomic<std::uint32_t> m_sequence{0};
+  std::array<std::atomic<Word>, NUM_WORDS> m_words;
+
+  auto begin_write() -> std::uint32_t {
+    std::uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    while (((sequence & 1) != 0) ||
+           !m_sequence.compare_exchange_weak(sequence, sequence + 1,
+                                             std::memory_order_acquire,
+                                             std::memory_order_relaxed)) {
+      sequence = m_sequence.load(std::memory_order_relaxed);
+    }
+    // Readers must not see the new value before the odd sequence number
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence;
+  }
+
+  void end_write(std::uint32_t sequence, const T& value) {
+    write_words(value);
+    m_sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  auto read_words() const -> T {
+    std::array<Word, NUM_WORDS> words;
+    for (std::size_t i = 0; i < NUM_WORDS; i++) {
+      words[i] = m_words[i].load(std::memory_order_relaxed);
+    }
+    std::array<std::byte, sizeof(T)> bytes;
+    std::memcpy(bytes.data(), words.data(), sizeof(T));
+    return std::bit_cast<T>(bytes);
+  }
+
+  void write_words(const T& value) {
+    std::array<Word, NUM_WORDS> words{};
+    std::memcpy(words.data(), &value, sizeof(T));
+    for (std::size_t i = 0; i < NUM_WORDS; i++) {
+      m_words[i].store(words[i], std::memory_order_relaxed);
+    }
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_SEQ_LOCK_H_
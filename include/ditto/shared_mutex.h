@@ -0,0 +1,288 @@
+#ifndef DITTO_SHARED_MUTEX_H_
+#define DITTO_SHARED_MUTEX_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "ditto/thread_slot.h"
+
+namespace Ditto {
+
+/**
+ * @brief Writer-preferring reader-writer mutex built on a single atomic word.
+ *
+ * When no writer is around, acquiring and releasing a shared lock costs one
+ * atomic read-modify-write each. Once a writer announces itself, new readers
+ * back off until it is done, so writers cannot starve under a read-heavy load.
+ * Blocked threads sleep with std::atomic::wait (a futex on Linux).
+ *
+ * It satisfies the SharedMutex requirements of the standard library, so it can
+ * be used with std::shared_lock or as the mutex of a Ditto::ReadWriteLock.
+ * Because of the writer preference, a thread that already holds a shared lock
+ * must not try to acquire it again while a writer may be waiting.
+ *
+ * The timed variants poll the state instead of sleeping, since
+ * std::atomic::wait does not take a timeout. They are meant for callers that
+ * would rather give up than block, not for long waits.
+ */
+class SharedMutex {
+ public:
+  SharedMutex() = default;
+  SharedMutex(const SharedMutex&) = delete;
+  SharedMutex(SharedMutex&&) = delete;
+  auto operator=(const SharedMutex&) -> SharedMutex& = delete;
+  auto operator=(SharedMutex&&) -> SharedMutex& = delete;
+
+  void lock() {
+    // Announce the writer first. This stops new readers from coming in
+    std::uint32_t state = m_state.load(std::memory_order_relaxed);
+    while (true) {
+      if ((state & WRITER) != 0) {
+        m_state.wait(state, std::memory_order_relaxed);
+        state = m_state.load(std::memory_order_relaxed);
+      } else if (m_state.compare_exchange_weak(state, state | WRITER,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed)) {
+        state |= WRITER;
+        break;
+      }
+    }
+
+    // Then wait for the readers that were already in to leave
+    while (state != WRITER) {
+      m_state.wait(state, std::memory_order_acquire);
+      state = m_state.load(std::memory_order_acquire);
+    }
+  }
+
+  [[nodiscard]] auto try_lock() -> bool {
+    std::uint32_t expected = 0;
+    return m_state.compare_exchange_strong(expected, WRITER,
+                                           std::memory_order_acquire,
+                                           std::memory_order_relaxed);
+  }
+
+  template <class Rep, class Period>
+  [[nodiscard]] auto try_lock_for(
+      const std::chrono::duration<Rep, Period>& timeout) -> bool {
+    return try_lock_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <class Clock, class Duration>
+  [[nodiscard]] auto try_lock_until(
+      const std::chrono::time_point<Clock, Duration>& deadline) -> bool {
+    std::uint32_t state = m_state.load(std::memory_order_relaxed);
+    while (true) {
+      if ((state & WRITER) != 0) {
+        if (Clock::now() >= deadline) {
+          return false;
+        }
+        std::this_thread::yield();
+        state = m_state.load(std::memory_order_relaxed);
+      } else if (m_state.compare_exchange_weak(state, state | WRITER,
+                                               std::memory_order_acquire,
+                                               std::memory_order_relaxed)) {
+        state |= WRITER;
+        break;
+      }
+    }
+
+    while (state != WRITER) {
+      if (Clock::now() >= deadline) {
+        // Give up and let the readers that backed off in again
+        unlock();
+        return false;
+      }
+      std::this_thread::yield();
+      state = m_state.load(std::memory_order_acquire);
+    }
+    return true;
+  }
+
+  void unlock() {
+    // Readers backing off may still be adjusting the reader count, so only
+    // the writer flag is cleared
+    m_state.fetch_and(~WRITER, std::memory_order_release);
+    m_state.notify_all();
+  }
+
+  void lock_shared() {
+    std::uint32_t state = m_state.fetch_add(1, std::memory_order_acquire);
+    while ((state & WRITER) != 0) {
+      // A writer is waiting or holds the lock. Back off and wait for it
+      state = m_state.fetch_sub(1, std::memory_order_relaxed) - 1;
+      if (state == WRITER) {
+        m_state.notify_all();
+      }
+      while ((state & WRITER) != 0) {
+        m_state.wait(state, std::memory_order_relaxed);
+        state = m_state.load(std::memory_order_relaxed);
+      }
+      state = m_state.fetch_add(1, std::memory_order_acquire);
+    }
+  }
+
+  [[nodiscard]] auto try_lock_shared() -> bool {
+    std::uint32_t state = m_state.load(std::memory_order_relaxed);
+    while ((state & WRITER) == 0) {
+      if (m_state.compare_exchange_weak(state, state + 1,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <class Rep, class Period>
+  [[nodiscard]] auto try_lock_shared_for(
+      const std::chrono::duration<Rep, Period>& timeout) -> bool {
+    return try_lock_shared_until(std::chrono::steady_clock::now() + timeout);
+  }
+
+  template <class Clock, class Duration>
+  [[nodiscard]] auto try_lock_shared_until(
+      const std::chrono::time_point<Clock, Duration>& deadline) -> bool {
+    while (!try_lock_shared()) {
+      if (Clock::now() >= deadline) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    return true;
+  }
+
+  void unlock_shared() {
+    const std::uint32_t previous =
+        m_state.fetch_sub(1, std::memory_order_release);
+    if (previous == (WRITER | 1)) {
+      // Last reader out, wake up the waiting writer
+      m_state.notify_all();
+    }
+  }
+
+ private:
+  static constexpr std::uint32_t WRITER = std::uint32_t{1} << 31;
+
+  // Writer flag in the most significant bit, number of readers in the rest
+  std::atomic<std::uint32_t> m_state{0};
+};
+
+/**
+ * @brief Reader-writer mutex with distributed reader counters, also known as
+ * a big-reader lock.
+ *
+ * Each thread is mapped to one of NUM_SLOTS reader counters, and each of them
+ * sits in its own cache line. Readers only touch their own slot and a flag
+ * that is only written by writers, so when writes are rare the read side
+ * scales linearly with the number of cores instead of bouncing a shared cache
+ * line between them. Writers pay for it: they have to scan all slots waiting
+ * for the readers to leave. Threads are assigned to slots in a round-robin
+ * fashion, so NUM_SLOTS should be at least the number of reading threads.
+ *
+ * Like Ditto::SharedMutex it prefers writers, so a thread that holds a shared
+ * lock must not try to acquire it again while a writer may be waiting.
+ */
+template <std::size_t NUM_SLOTS = 32>
+class DistributedSharedMutex {
+  static_assert(NUM_SLOTS > 0, "At least one reader slot is required");
+
+ public:
+  DistributedSharedMutex() = default;
+  DistributedSharedMutex(const DistributedSharedMutex&) = delete;
+  DistributedSharedMutex(DistributedSharedMutex&&) = delete;
+  auto operator=(const DistributedSharedMutex&)
+      -> DistributedSharedMutex& = delete;
+  auto operator=(DistributedSharedMutex&&) -> DistributedSharedMutex& = delete;
+
+  void lock() {
+    bool expected = false;
+    while (!m_writer.compare_exchange_weak(expected, true,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed)) {
+      m_writer.wait(true, std::memory_order_relaxed);
+      expected = false;
+    }
+
+    for (Slot& slot : m_slots) {
+      std::uint32_t readers = slot.readers.load(std::memory_order_seq_cst);
+      while (readers != 0) {
+        slot.readers.wait(readers, std::memory_order_acquire);
+        readers = slot.readers.load(std::memory_order_acquire);
+      }
+    }
+  }
+
+  [[nodiscard]] auto try_lock() -> bool {
+    bool expected = false;
+    if (!m_writer.compare_exchange_strong(expected, true,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+      return false;
+    }
+
+    for (Slot& slot : m_slots) {
+      if (slot.readers.load(std::memory_order_seq_cst) != 0) {
+        unlock();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() {
+    m_writer.store(false, std::memory_order_release);
+    m_writer.notify_all();
+  }
+
+  void lock_shared() {
+    Slot& slot = current_slot();
+    while (!enter(slot)) {
+      m_writer.wait(true, std::memory_order_relaxed);
+    }
+  }
+
+  [[nodiscard]] auto try_lock_shared() -> bool { return enter(current_slot()); }
+
+  void unlock_shared() { leave(current_slot()); }
+
+ private:
+  struct alignas(CACHE_LINE_SIZE) Slot {
+    std::atomic<std::uint32_t> readers{0};
+  };
+
+  std::array<Slot, NUM_SLOTS> m_slots;
+  alignas(CACHE_LINE_SIZE) std::atomic_bool m_writer{false};
+
+  auto current_slot() -> Slot& {
+    return m_slots[this_thread_index() % NUM_SLOTS];
+  }
+
+  auto enter(Slot& slot) -> bool {
+    // Both the increment and the check of the writer flag need to be
+    // sequentially consistent, pairing with the writer setting its flag and
+    // then scanning the slots
+    slot.readers.fetch_add(1, std::memory_order_seq_cst);
+    if (!m_writer.load(std::memory_order_seq_cst)) {
+      return true;
+    }
+    leave(slot);
+    return false;
+  }
+
+  void leave(Slot& slot) {
+    const std::uint32_t previous =
+        slot.readers.fetch_sub(1, std::memory_order_seq_cst);
+    if ((previous == 1) && m_writer.load(std::memory_order_seq_cst)) {
+      slot.readers.notify_all();
+    }
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_SHARED_MUTEX_H_
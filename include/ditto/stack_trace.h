@@ -2,6 +2,7 @@
 #define DITTO_STACK_TRACE_H
 
 #include <cstdint>
+#include <type_traits>
 
 #include "ditto/arch.h"
 
@@ -17,14 +18,35 @@ concept CallableWithT = requires(C c, T t) {
   {c(t)};
 };
 
+/**
+ * @brief Calls the callable with every frame of the current stack, starting
+ * with the innermost one. If the callable returns a bool, returning false
+ * stops the walk.
+ *
+ * Code built without frame pointers leaves anything in the frame pointer
+ * register, so the walk also stops at the first frame that is misaligned or
+ * not above the previous one, since the stack grows downwards.
+ */
 template <CallableWithT<const StackFrame&> C>
 void walk_stack_trace(C callable) {
   uintptr_t frame_ptr = Ditto::arch::get_frame_pointer();
   auto* stack_frame = reinterpret_cast<const StackFrame*>(frame_ptr);
 
   while (stack_frame != nullptr) {
-    callable(*stack_frame);
-    stack_frame = stack_frame->prev;
+    if constexpr (std::is_same_v<decltype(callable(*stack_frame)), bool>) {
+      if (!callable(*stack_frame)) {
+        return;
+      }
+    } else {
+      callable(*stack_frame);
+    }
+    const StackFrame* prev = stack_frame->prev;
+    if ((reinterpret_cast<uintptr_t>(prev) <=
+         reinterpret_cast<uintptr_t>(stack_frame)) ||
+        (reinterpret_cast<uintptr_t>(prev) % alignof(StackFrame) != 0)) {
+      return;
+    }
+    stack_frame = prev;
   }
 }
 
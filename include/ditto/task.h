@@ -0,0 +1,249 @@
+#ifndef DITTO_TASK_H_
+#define DITTO_TASK_H_
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+
+namespace Ditto {
+
+/**
+ * @brief Statically allocated pool of coroutine frames. It holds NUM_FRAMES
+ * frames of up to FRAME_SIZE bytes each, so that coroutines never touch the
+ * heap.
+ *
+ * Every instantiation of the pool owns its own storage. The pool is not thread
+ * safe, coroutines using it are expected to be created from a single thread
+ * (typically the thread running the EventLoop).
+ */
+template <std::size_t FRAME_SIZE, std::size_t NUM_FRAMES>
+class TaskFramePool {
+ public:
+  /**
+   * @brief Returns a free frame, or nullptr if the pool is exhausted or the
+   * requested size does not fit in a frame.
+   */
+  [[nodiscard]] static auto allocate(std::size_t size) noexcept -> void* {
+    if (size > FRAME_SIZE) {
+      return nullptr;
+    }
+
+    if (s_free_list != nullptr) {
+      FreeFrame* frame = s_free_list;
+      s_free_list = frame->next;
+      return frame;
+    }
+
+    if (s_num_untouched_frames < NUM_FRAMES) {
+      return &s_frames[s_num_untouched_frames++];
+    }
+    return nullptr;
+  }
+
+  static void deallocate(void* ptr) noexcept {
+    DITTO_VERIFY((ptr >= s_frames.data()) &&
+                 (ptr < s_frames.data() + NUM_FRAMES));
+    auto* frame = new (ptr) FreeFrame{s_free_list};
+    s_free_list = frame;
+  }
+
+ private:
+  struct FreeFrame {
+    FreeFrame* next;
+  };
+
+  using Frame =
+      std::aligned_storage_t<std::max(FRAME_SIZE, sizeof(FreeFrame)),
+                             alignof(std::max_align_t)>;
+
+  static inline std::array<Frame, NUM_FRAMES> s_frames;
+  static inline FreeFrame* s_free_list = nullptr;
+  static inline std::size_t s_num_untouched_frames = 0;
+};
+
+using DefaultTaskFramePool = TaskFramePool<512, 8>;
+
+namespace detail {
+
+template <class T>
+class TaskPromiseResult {
+ public:
+  template <class U>
+  void return_value(U&& value) {
+    m_value.emplace(std::forward<U>(value));
+  }
+
+  auto result() -> T& { return m_value.value(); }
+
+ private:
+  std::optional<T> m_value;
+};
+
+template <>
+class TaskPromiseResult<void> {
+ public:
+  void return_void() {}
+  void result() {}
+};
+
+}  // namespace detail
+
+/**
+ * @brief Lazily started coroutine returning a value of type T.
+ *
+ * Coroutine frames are taken from the given Pool. If the pool is exhausted the
+ * returned Task is not valid() and the coroutine body never runs. Awaiting an
+ * invalid Task terminates the program.
+ *
+ * A Task starts executing when it is awaited from another Task or when start()
+ * is called on it. When it finishes, the awaiting coroutine is resumed.
+ * Together with the awaiters exposed by Ditto::EventLoop, this allows writing
+ * multi-step flows that suspend until an event is dispatched or a timer fires.
+ * Destroying a Task suspended on one of those awaiters cancels the wait.
+ */
+template <class T = void, class Pool = DefaultTaskFramePool>
+class [[nodiscard]] Task {
+ public:
+  class promise_type : public detail::TaskPromiseResult<T> {
+   public:
+    [[nodiscard]] static auto operator new(std::size_t size) noexcept
+        -> void* {
+      return Pool::allocate(size);
+    }
+
+    static void operator delete(void* ptr) noexcept { Pool::deallocate(ptr); }
+
+    static auto get_return_object_on_allocation_failure() noexcept -> Task {
+      return Task{};
+    }
+
+    auto get_return_object() noexcept -> Task {
+      return Task{Handle::from_promise(*this)};
+    }
+
+    auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+
+    auto final_suspend() noexcept {
+      struct FinalAwaiter {
+        auto await_ready() noexcept -> bool { return false; }
+        auto await_suspend(Handle handle) noexcept -> std::coroutine_handle<> {
+          auto continuation = handle.promise().m_continuation;
+          if (continuation) {
+            return continuation;
+          }
+          return std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+      };
+      return FinalAwaiter{};
+    }
+
+    void unhandled_exception() noexcept { std::terminate(); }
+
+   private:
+    std::coroutine_handle<> m_continuation;
+
+    friend Task;
+  };
+
+  using Handle = std::coroutine_handle<promise_type>;
+
+  Task() = default;
+
+  Task(Task&& other) noexcept
+      : m_handle(std::exchange(other.m_handle, {})),
+        m_started(std::exchange(other.m_started, false)) {}
+
+  auto operator=(Task&& other) noexcept -> Task& {
+    if (this != &other) {
+      reset();
+      m_handle = std::exchange(other.m_handle, {});
+      m_started = std::exchange(other.m_started, false);
+    }
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  auto operator=(const Task&) -> Task& = delete;
+
+  ~Task() { reset(); }
+
+  /**
+   * @brief Returns false if the coroutine frame could not be allocated.
+   */
+  [[nodiscard]] auto valid() const -> bool {
+    return static_cast<bool>(m_handle);
+  }
+
+  [[nodiscard]] auto done() const -> bool { return valid() && m_handle.done(); }
+
+  /**
+   * @brief Runs the coroutine until its first suspension point. Must only be
+   * called once, and not on tasks that are awaited by another coroutine.
+   */
+  void start() {
+    DITTO_VERIFY(valid() && !m_started);
+    m_started = true;
+    m_handle.resume();
+  }
+
+  /**
+   * @brief Returns the value produced by the coroutine. Only valid once done()
+   * returns true.
+   */
+  auto result() -> decltype(auto) {
+    DITTO_VERIFY(done());
+    return m_handle.promise().result();
+  }
+
+  auto operator co_await() && noexcept {
+    struct Awaiter {
+      Handle handle;
+
+      auto await_ready() noexcept -> bool { return handle.done(); }
+      auto await_suspend(std::coroutine_handle<> awaiting) noexcept
+          -> std::coroutine_handle<> {
+        handle.promise().m_continuation = awaiting;
+        return handle;
+      }
+      auto await_resume() -> T {
+        if constexpr (!std::is_void_v<T>) {
+          return std::move(handle.promise().result());
+        }
+      }
+    };
+    // An invalid task has no coroutine to run nor result to return, so
+    // awaiting it fails even if assertions are compiled out
+    if (!valid()) {
+      std::terminate();
+    }
+    DITTO_VERIFY(!m_started);
+    m_started = true;
+    return Awaiter{m_handle};
+  }
+
+ private:
+  Handle m_handle;
+  bool m_started = false;
+
+  explicit Task(Handle handle) : m_handle(handle) {}
+
+  void reset() {
+    if (m_handle) {
+      m_handle.destroy();
+      m_handle = {};
+    }
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_TASK_H_
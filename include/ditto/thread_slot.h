@@ -0,0 +1,29 @@
+#ifndef DITTO_THREAD_SLOT_H_
+#define DITTO_THREAD_SLOT_H_
+
+#include <atomic>
+#include <cstddef>
+
+namespace Ditto {
+
+/**
+ * @brief Size used to pad per-thread data so that two threads never write to
+ * the same cache line.
+ */
+inline constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief Returns a small number identifying the calling thread. Threads are
+ * numbered in the order in which they first call this function, which makes
+ * it suitable to pick a slot in a fixed array of per-thread data.
+ */
+inline auto this_thread_index() -> std::size_t {
+  static std::atomic<std::size_t> s_next_index{0};
+  thread_local const std::size_t index =
+      s_next_index.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+}  // namespace Ditto
+
+#endif  // DITTO_THREAD_SLOT_H_
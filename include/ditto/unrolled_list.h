@@ -0,0 +1,362 @@
+#ifndef DITTO_UNROLLED_LIST_H_
+#define DITTO_UNROLLED_LIST_H_
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "ditto/assert.h"
+
+namespace Ditto {
+
+/**
+ * @brief Doubly-linked list of chunks holding up to CHUNK_SIZE elements each,
+ * also known as an unrolled linked list.
+ *
+ * Elements are stored contiguously within a chunk, so traversing the list
+ * only takes a cache miss every few elements, and a node allocation is only
+ * needed every CHUNK_SIZE pushes. Pushing and popping at both ends is O(1),
+ * which makes it a good fit for queues. Erasing from the middle shifts the
+ * rest of the elements of the chunk.
+ *
+ * Pushing and popping elements does not invalidate references to other
+ * elements, but erasing does invalidate references to elements of the same
+ * chunk.
+ */
+template <class T, std::size_t CHUNK_SIZE = 32,
+          class Allocator = std::allocator<T>>
+class UnrolledList {
+  static_assert(CHUNK_SIZE > 0, "Chunks must hold at least one element");
+  static_assert(!std::is_const_v<T>, "Elements must not be const");
+
+  struct Chunk {
+    // User-provided, so that the storage is not zeroed when creating a chunk
+    explicit Chunk(std::size_t first_slot)
+        : begin(first_slot), end(first_slot) {}
+
+    Chunk* prev = nullptr;
+    Chunk* next = nullptr;
+    // Elements live in the slots [begin, end)
+    std::size_t begin;
+    std::size_t end;
+    alignas(T) std::byte storage[sizeof(T) * CHUNK_SIZE];
+
+    auto element(std::size_t index) -> T* {
+      return std::launder(reinterpret_cast<T*>(storage) + index);
+    }
+  };
+
+  template <bool CONST>
+  class Iterator {
+    using List = std::conditional_t<CONST, const UnrolledList, UnrolledList>;
+
+   public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using pointer = std::conditional_t<CONST, const T*, T*>;
+    using reference = std::conditional_t<CONST, const T&, T&>;
+    using iterator_category = std::bidirectional_iterator_tag;
+
+    Iterator() = default;
+
+    template <bool OTHER_CONST,
+              std::enable_if_t<CONST && !OTHER_CONST, bool> = false>
+    Iterator(const Iterator<OTHER_CONST>& other)
+        : m_list(other.m_list),
+          m_chunk(other.m_chunk),
+          m_index(other.m_index) {}
+
+    auto operator++() -> Iterator& {
+      m_index++;
+      if (m_index == m_chunk->end) {
+        m_chunk = m_chunk->next;
+        m_index = (m_chunk != nullptr) ? m_chunk->begin : 0;
+      }
+      return *this;
+    }
+
+    auto operator++(int) -> Iterator {
+      Iterator current = *this;
+      ++*this;
+      return current;
+    }
+
+    auto operator--() -> Iterator& {
+      if (m_chunk == nullptr) {
+        // Decrementing end()
+        m_chunk = m_list->m_tail;
+        m_index = m_chunk->end - 1;
+      } else if (m_index == m_chunk->begin) {
+        m_chunk = m_chunk->prev;
+        m_index = m_chunk->end - 1;
+      } else {
+        m_index--;
+      }
+      return *this;
+    }
+
+    auto operator--(int) -> Iterator {
+      Iterator current = *this;
+      --*this;
+      return current;
+    }
+
+    [[nodiscard]] auto operator*() const -> reference {
+      return *m_chunk->element(m_index);
+    }
+    [[nodiscard]] auto operator->() const -> pointer {
+      return m_chunk->element(m_index);
+    }
+
+    template <bool OTHER_CONST>
+    [[nodiscard]] auto operator==(const Iterator<OTHER_CONST>& other) const
+        -> bool {
+      return (m_chunk == other.m_chunk) && (m_index == other.m_index);
+    }
+
+   private:
+    List* m_list = nullptr;
+    Chunk* m_chunk = nullptr;
+    std::size_t m_index = 0;
+
+    Iterator(List* list, Chunk* chunk, std::size_t index)
+        : m_list(list), m_chunk(chunk), m_index(index) {}
+
+    template <bool>
+    friend class Iterator;
+
+    friend UnrolledList;
+  };
+
+ public:
+  using value_type = T;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+  using reverse_iterator = std::reverse_iterator<iterator>;
+  using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+  using difference_type = std::ptrdiff_t;
+  using size_type = std::size_t;
+  using allocator_type = Allocator;
+
+  UnrolledList() = default;
+  explicit UnrolledList(const Allocator& allocator) : m_allocator(allocator) {}
+
+  UnrolledList(UnrolledList&& other) noexcept
+      : m_allocator(std::move(other.m_allocator)),
+        m_head(std::exchange(other.m_head, nullptr)),
+        m_tail(std::exchange(other.m_tail, nullptr)),
+        m_size(std::exchange(other.m_size, 0)) {}
+
+  auto operator=(UnrolledList&& other) noexcept -> UnrolledList& {
+    if (this != &other) {
+      clear();
+      if constexpr (ChunkAllocatorTraits::
+                        propagate_on_container_move_assignment::value) {
+        m_allocator = std::move(other.m_allocator);
+      } else {
+        DITTO_VERIFY(m_allocator == other.m_allocator);
+      }
+      m_head = std::exchange(other.m_head, nullptr);
+      m_tail = std::exchange(other.m_tail, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+  }
+
+  UnrolledList(const UnrolledList&) = delete;
+  auto operator=(const UnrolledList&) -> UnrolledList& = delete;
+
+  ~UnrolledList() { clear(); }
+
+  [[nodiscard]] auto begin() -> iterator {
+    return iterator{this, m_head, first_index()};
+  }
+  [[nodiscard]] auto end() -> iterator { return iterator{this, nullptr, 0}; }
+  [[nodiscard]] auto begin() const -> const_iterator {
+    return const_iterator{this, m_head, first_index()};
+  }
+  [[nodiscard]] auto end() const -> const_iterator {
+    return const_iterator{this, nullptr, 0};
+  }
+  [[nodiscard]] auto cbegin() const -> const_iterator { return begin(); }
+  [[nodiscard]] auto cend() const -> const_iterator { return end(); }
+
+  [[nodiscard]] auto rbegin() -> reverse_iterator {
+    return reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() -> reverse_iterator {
+    return reverse_iterator{begin()};
+  }
+  [[nodiscard]] auto rbegin() const -> const_reverse_iterator {
+    return const_reverse_iterator{end()};
+  }
+  [[nodiscard]] auto rend() const -> const_reverse_iterator {
+    return const_reverse_iterator{begin()};
+  }
+
+  [[nodiscard]] auto front() -> reference {
+    return *m_head->element(m_head->begin);
+  }
+  [[nodiscard]] auto front() const -> const_reference {
+    return *m_head->element(m_head->begin);
+  }
+  [[nodiscard]] auto back() -> reference {
+    return *m_tail->element(m_tail->end - 1);
+  }
+  [[nodiscard]] auto back() const -> const_reference {
+    return *m_tail->element(m_tail->end - 1);
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return m_size == 0; }
+  [[nodiscard]] auto size() const -> size_type { return m_size; }
+
+  void clear() {
+    while (m_head != nullptr) {
+      Chunk* next = m_head->next;
+      for (std::size_t i = m_head->begin; i < m_head->end; i++) {
+        std::destroy_at(m_head->element(i));
+      }
+      destroy_chunk(m_head);
+      m_head = next;
+    }
+    m_tail = nullptr;
+    m_size = 0;
+  }
+
+  void push_back(T element) { emplace_back(std::move(element)); }
+  void push_front(T element) { emplace_front(std::move(element)); }
+
+  template <class... Args>
+  auto emplace_back(Args&&... args) -> reference {
+    if ((m_tail == nullptr) || (m_tail->end == CHUNK_SIZE)) {
+      link_chunk(m_tail, nullptr, create_chunk(0));
+    }
+    T* element = std::construct_at(m_tail->element(m_tail->end),
+                                   std::forward<Args>(args)...);
+    m_tail->end++;
+    m_size++;
+    return *element;
+  }
+
+  template <class... Args>
+  auto emplace_front(Args&&... args) -> reference {
+    if ((m_head == nullptr) || (m_head->begin == 0)) {
+      link_chunk(nullptr, m_head, create_chunk(CHUNK_SIZE));
+    }
+    T* element = std::construct_at(m_head->element(m_head->begin - 1),
+                                   std::forward<Args>(args)...);
+    m_head->begin--;
+    m_size++;
+    return *element;
+  }
+
+  void pop_back() {
+    if (m_tail != nullptr) {
+      m_tail->end--;
+      std::destroy_at(m_tail->element(m_tail->end));
+      m_size--;
+      release_if_empty(m_tail);
+    }
+  }
+
+  void pop_front() {
+    if (m_head != nullptr) {
+      std::destroy_at(m_head->element(m_head->begin));
+      m_head->begin++;
+      m_size--;
+      release_if_empty(m_head);
+    }
+  }
+
+  /**
+   * @brief Erases the element at pos by shifting the ones after it within its
+   * chunk. Returns an iterator to the element that followed it.
+   */
+  auto erase(const_iterator pos) -> iterator {
+    if (pos == cend()) {
+      return end();
+    }
+
+    Chunk* chunk = pos.m_chunk;
+    for (std::size_t i = pos.m_index; i + 1 < chunk->end; i++) {
+      *chunk->element(i) = std::move(*chunk->element(i + 1));
+    }
+    chunk->end--;
+    std::destroy_at(chunk->element(chunk->end));
+    m_size--;
+
+    if (pos.m_index < chunk->end) {
+      return iterator{this, chunk, pos.m_index};
+    }
+    Chunk* next = chunk->next;
+    release_if_empty(chunk);
+    return iterator{this, next, (next != nullptr) ? next->begin : 0};
+  }
+
+ private:
+  using ChunkAllocator = typename std::allocator_traits<
+      Allocator>::template rebind_alloc<Chunk>;
+  using ChunkAllocatorTraits = std::allocator_traits<ChunkAllocator>;
+
+  [[no_unique_address]] ChunkAllocator m_allocator;
+  Chunk* m_head = nullptr;
+  Chunk* m_tail = nullptr;
+  size_type m_size = 0;
+
+  [[nodiscard]] auto first_index() const -> std::size_t {
+    return (m_head != nullptr) ? m_head->begin : 0;
+  }
+
+  // Creates an empty chunk whose elements will start at the given slot
+  auto create_chunk(std::size_t first_slot) -> Chunk* {
+    Chunk* chunk = ChunkAllocatorTraits::allocate(m_allocator, 1);
+    ChunkAllocatorTraits::construct(m_allocator, chunk, first_slot);
+    return chunk;
+  }
+
+  void destroy_chunk(Chunk* chunk) {
+    ChunkAllocatorTraits::destroy(m_allocator, chunk);
+    ChunkAllocatorTraits::deallocate(m_allocator, chunk, 1);
+  }
+
+  void link_chunk(Chunk* prev, Chunk* next, Chunk* chunk) {
+    chunk->prev = prev;
+    chunk->next = next;
+    if (prev != nullptr) {
+      prev->next = chunk;
+    } else {
+      m_head = chunk;
+    }
+    if (next != nullptr) {
+      next->prev = chunk;
+    } else {
+      m_tail = chunk;
+    }
+  }
+
+  void release_if_empty(Chunk* chunk) {
+    if (chunk->begin != chunk->end) {
+      return;
+    }
+    if (chunk->prev != nullptr) {
+      chunk->prev->next = chunk->next;
+    } else {
+      m_head = chunk->next;
+    }
+    if (chunk->next != nullptr) {
+      chunk->next->prev = chunk->prev;
+    } else {
+      m_tail = chunk->prev;
+    }
+    destroy_chunk(chunk);
+  }
+};
+
+}  // namespace Ditto
+
+#endif  // DITTO_UNROLLED_LIST_H_
@@ -5,7 +5,9 @@
 namespace Ditto::arch {
 
 __attribute__((naked)) uintptr_t get_frame_pointer() {
-  asm volatile("mov x0, x29\n");
+  asm volatile(
+      "mov x0, x29\n"
+      "ret\n");
 }
 
 }  // namespace Ditto::arch
@@ -5,7 +5,9 @@
 namespace Ditto::arch {
 
 __attribute__((naked)) uintptr_t get_frame_pointer() {
-  asm volatile("mov r0, r11\n");
+  asm volatile(
+      "mov r0, r11\n"
+      "bx lr\n");
 }
 
 }  // namespace Ditto::arch
@@ -4,7 +4,9 @@
 namespace Ditto::arch {
 
 __attribute__((naked)) uintptr_t get_frame_pointer() {
-  asm volatile("movq %rbp, %rax\n");
+  asm volatile(
+      "movq %rbp, %rax\n"
+      "ret\n");
 }
 
 }  // namespace Ditto::arch
@@ -0,0 +1,105 @@
+#include "ditto/adaptive_mutex.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ditto/resource_lock.h"
+
+TEST(AdaptiveMutexTest, TryLockFailsWhileLocked) {
+  Ditto::AdaptiveMutex<> mutex;
+
+  EXPECT_TRUE(mutex.try_lock());
+  EXPECT_FALSE(mutex.try_lock());
+  mutex.unlock();
+
+  mutex.lock();
+  EXPECT_FALSE(mutex.try_lock());
+  mutex.unlock();
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
+
+TEST(AdaptiveMutexTest, WakesUpParkedThreads) {
+  // Without spinning, contended threads park right away
+  Ditto::AdaptiveMutex<0> mutex;
+  std::atomic_bool acquired{false};
+
+  mutex.lock();
+  std::thread waiter{[&] {
+    mutex.lock();
+    acquired = true;
+    mutex.unlock();
+  }};
+
+  std::this_thread::yield();
+  EXPECT_FALSE(acquired.load());
+  mutex.unlock();
+  waiter.join();
+  EXPECT_TRUE(acquired.load());
+}
+
+template <typename M>
+class AdaptiveMutexContentionTest : public testing::Test {};
+
+using AdaptiveMutexTypes =
+    testing::Types<Ditto::AdaptiveMutex<>, Ditto::AdaptiveMutex<0>>;
+TYPED_TEST_SUITE(AdaptiveMutexContentionTest, AdaptiveMutexTypes);
+
+TYPED_TEST(AdaptiveMutexContentionTest, ProvidesMutualExclusion) {
+  constexpr int NUM_THREADS = 4;
+  constexpr int NUM_ITERATIONS = 10000;
+  Ditto::ResourceLock<std::uint64_t, TypeParam> counter{0u};
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < NUM_ITERATIONS; j++) {
+        counter.lock([](std::uint64_t& value) { value++; });
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  counter.lock([&](std::uint64_t& value) {
+    EXPECT_EQ(value, NUM_THREADS * NUM_ITERATIONS);
+  });
+}
+
+namespace {
+
+struct FakeInterrupts {
+  static inline bool enabled = true;
+  static inline int num_disables = 0;
+
+  static auto disable_interrupts() -> bool {
+    num_disables++;
+    return std::exchange(enabled, false);
+  }
+
+  static void restore_interrupts(bool state) { enabled = state; }
+};
+
+}  // namespace
+
+TEST(InterruptMaskMutexTest, MasksInterruptsWhileLocked) {
+  Ditto::ResourceLock<int, Ditto::InterruptMaskMutex<FakeInterrupts>> first{1};
+  Ditto::ResourceLock<int, Ditto::InterruptMaskMutex<FakeInterrupts>> second{
+      2};
+  FakeInterrupts::num_disables = 0;
+
+  first.lock([&](int&) {
+    EXPECT_FALSE(FakeInterrupts::enabled);
+    second.lock([](int&) { EXPECT_FALSE(FakeInterrupts::enabled); });
+    // Leaving the inner lock must not unmask interrupts yet
+    EXPECT_FALSE(FakeInterrupts::enabled);
+  });
+  EXPECT_TRUE(FakeInterrupts::enabled);
+  EXPECT_EQ(FakeInterrupts::num_disables, 2);
+}
@@ -2,6 +2,12 @@
 
 #include <gtest/gtest.h>
 
+#include <cmath>
+#include <map>
+#include <random>
+
+#include "ditto/pool_allocator.h"
+
 TEST(BinarySearchTreeTest, Constructor) {
   Ditto::BinarySearchTree<int, int> tree;
 }
@@ -104,3 +110,83 @@ TEST(BinarySearchTreeTest, DepthTest) {
     EXPECT_EQ(*result.value(), i);
   }
 }
+
+TEST(BinarySearchTreeTest, UsesTheAllocator) {
+  struct Tag {};
+  using Allocator = Ditto::FixedPoolAllocator<int, 9, Tag>;
+
+  // The pool only fits 9 nodes, so this fails if nodes are leaked
+  for (int round = 0; round < 2; round++) {
+    Ditto::BinarySearchTree<int, int, Allocator> tree;
+    for (int key : {8, 4, 12, 2, 6, 10, 14, 1, 3}) {
+      tree.insert(key, key);
+    }
+
+    auto result = tree.erase(4);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result.value(), 4);
+    EXPECT_TRUE(tree.lookup(3).has_value());
+    EXPECT_TRUE(tree.lookup(6).has_value());
+    tree.insert(5, 5);
+  }
+}
+
+TEST(BinarySearchTreeTest, ClearsDegenerateTree) {
+  Ditto::BinarySearchTree<int, int, Ditto::SlabAllocator<int>> tree;
+  // Degenerate trees are as deep as they are large, and are freed without
+  // recursion
+  for (int i = 0; i < 10000; i++) {
+    tree.insert(-i, i);
+  }
+  tree.clear();
+  EXPECT_EQ(tree.depth(), 0);
+
+  tree.insert(1, 2);
+  EXPECT_EQ(*tree.lookup(1).value(), 2);
+}
+
+TEST(BinarySearchTreeTest, AvlTreeStaysBalanced) {
+  Ditto::AvlTree<int, int> tree;
+  // Keys in ascending order would make an unbalanced tree a list
+  for (int i = 0; i < 1000; i++) {
+    tree.insert(i, i);
+  }
+  EXPECT_LE(tree.depth(), 1.44 * std::log2(1000.0 + 2.0));
+
+  for (int i = 0; i < 1000; i++) {
+    auto result = tree.lookup(i);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result.value(), i);
+  }
+}
+
+TEST(BinarySearchTreeTest, AvlTreeEraseKeepsBalance) {
+  Ditto::AvlTree<int, int> tree;
+  std::map<int, int> expected;
+  std::mt19937 generator{11};
+  std::uniform_int_distribution<int> distribution{0, 2000};
+
+  for (int i = 0; i < 10000; i++) {
+    const int key = distribution(generator);
+    if ((i % 3) != 0) {
+      tree.insert(key, i);
+      expected[key] = i;
+    } else {
+      auto result = tree.erase(key);
+      auto it = expected.find(key);
+      ASSERT_EQ(result.has_value(), it != expected.end());
+      if (it != expected.end()) {
+        EXPECT_EQ(result.value(), it->second);
+        expected.erase(it);
+      }
+    }
+    const double size = static_cast<double>(expected.size());
+    ASSERT_LE(tree.depth(), 1.44 * std::log2(size + 2.0));
+  }
+
+  for (const auto& [key, value] : expected) {
+    auto result = tree.lookup(key);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(*result.value(), value);
+  }
+}
@@ -0,0 +1,277 @@
+#include "ditto/bplus_tree.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ditto/pool_allocator.h"
+
+using testing::ElementsAre;
+
+namespace {
+
+// Small nodes, so that tests exercise several levels of inner nodes
+template <class K = int, class V = int>
+using SmallTree = Ditto::BPlusTree<K, V, 64>;
+
+template <class Tree>
+auto keys_of(const Tree& tree) -> std::vector<int> {
+  std::vector<int> keys;
+  for (auto [key, value] : tree) {
+    keys.push_back(key);
+  }
+  return keys;
+}
+
+}  // namespace
+
+TEST(BPlusTreeTest, InsertAndLookup) {
+  Ditto::BPlusTree<int, int> tree;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_FALSE(tree.lookup(12).has_value());
+
+  tree.insert(12, 234);
+  tree.insert(23, 235);
+  tree.insert(11, 237);
+  tree.insert(12, 238);
+  EXPECT_EQ(tree.size(), 3);
+
+  auto result = tree.lookup(12);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(*result.value(), 238);
+  EXPECT_EQ(*tree.lookup(23).value(), 235);
+  EXPECT_EQ(*tree.lookup(11).value(), 237);
+  EXPECT_FALSE(tree.lookup(10).has_value());
+  EXPECT_FALSE(tree.lookup(24).has_value());
+}
+
+TEST(BPlusTreeTest, MatchesStdMap) {
+  SmallTree<> tree;
+  std::map<int, int> expected;
+  std::mt19937 rng{42};
+  std::uniform_int_distribution<int> keys{0, 999};
+
+  for (int i = 0; i < 5000; i++) {
+    const int key = keys(rng);
+    if (rng() % 3 == 0) {
+      auto result = tree.erase(key);
+      auto iter = expected.find(key);
+      ASSERT_EQ(result.has_value(), iter != expected.end());
+      if (iter != expected.end()) {
+        EXPECT_EQ(result.value(), iter->second);
+        expected.erase(iter);
+      }
+    } else {
+      tree.insert(key, i);
+      expected[key] = i;
+    }
+    ASSERT_EQ(tree.size(), expected.size());
+  }
+
+  std::vector<int> expected_keys;
+  for (const auto& [key, value] : expected) {
+    expected_keys.push_back(key);
+    ASSERT_TRUE(tree.lookup(key).has_value());
+    EXPECT_EQ(*tree.lookup(key).value(), value);
+  }
+  EXPECT_EQ(keys_of(tree), expected_keys);
+}
+
+TEST(BPlusTreeTest, StaysShallow) {
+  SmallTree<> tree;
+  for (int key = 0; key < 10000; key++) {
+    tree.insert(key, key);
+  }
+  // Nodes of this tree have at least 2 children
+  EXPECT_LE(tree.depth(), std::log2(10000.0) + 1);
+
+  // Erasing everything shrinks it back
+  std::vector<int> keys(10000);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{7});
+  for (int key : keys) {
+    ASSERT_TRUE(tree.erase(key).has_value());
+  }
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.depth(), 0);
+  EXPECT_EQ(tree.begin(), tree.end());
+}
+
+TEST(BPlusTreeTest, IteratesInBothDirections) {
+  SmallTree<> tree;
+  for (int key : {5, 1, 9, 3, 7, 2, 8, 4, 6, 0}) {
+    tree.insert(key, key * 10);
+  }
+  EXPECT_THAT(keys_of(tree), ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+
+  for (auto [key, value] : tree) {
+    value += key;
+  }
+  EXPECT_EQ(*tree.lookup(3).value(), 33);
+
+  std::vector<int> reversed;
+  auto iter = tree.end();
+  while (iter != tree.begin()) {
+    --iter;
+    reversed.push_back((*iter).key);
+  }
+  EXPECT_THAT(reversed, ElementsAre(9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+}
+
+TEST(BPlusTreeTest, Bounds) {
+  SmallTree<> tree;
+  for (int key = 0; key < 100; key += 10) {
+    tree.insert(key, key);
+  }
+
+  EXPECT_EQ((*tree.lower_bound(20)).key, 20);
+  EXPECT_EQ((*tree.upper_bound(20)).key, 30);
+  EXPECT_EQ((*tree.lower_bound(21)).key, 30);
+  EXPECT_EQ((*tree.upper_bound(21)).key, 30);
+  EXPECT_EQ((*tree.lower_bound(-5)).key, 0);
+  EXPECT_EQ(tree.lower_bound(91), tree.end());
+  EXPECT_EQ(tree.upper_bound(90), tree.end());
+
+  const auto& const_tree = tree;
+  EXPECT_EQ((*const_tree.lower_bound(45)).value, 50);
+}
+
+TEST(BPlusTreeTest, ForEachInRange) {
+  SmallTree<> tree;
+  for (int key = 0; key < 100; key++) {
+    tree.insert(key, key);
+  }
+
+  std::vector<int> values;
+  tree.for_each_in_range(
+      10, 15, [&](const int& key, int& value) { values.push_back(value); });
+  EXPECT_THAT(values, ElementsAre(10, 11, 12, 13, 14));
+
+  values.clear();
+  const auto& const_tree = tree;
+  const_tree.for_each_in_range(95, 200, [&](const int& key, const int& value) {
+    values.push_back(key);
+  });
+  EXPECT_THAT(values, ElementsAre(95, 96, 97, 98, 99));
+
+  values.clear();
+  tree.for_each_in_range(
+      50, 50, [&](const int& key, int& value) { values.push_back(key); });
+  EXPECT_TRUE(values.empty());
+}
+
+TEST(BPlusTreeTest, BulkLoad) {
+  std::vector<Ditto::Pair<int, int>> entries;
+  for (int key = 0; key < 1000; key++) {
+    entries.emplace_back(key * 2, key);
+  }
+
+  SmallTree<> tree{entries};
+  EXPECT_EQ(tree.size(), 1000);
+  for (int key = 0; key < 1000; key++) {
+    ASSERT_TRUE(tree.lookup(key * 2).has_value());
+    EXPECT_EQ(*tree.lookup(key * 2).value(), key);
+    EXPECT_FALSE(tree.lookup(key * 2 + 1).has_value());
+  }
+
+  std::vector<int> expected_keys;
+  for (const auto& entry : entries) {
+    expected_keys.push_back(entry.left());
+  }
+  EXPECT_EQ(keys_of(tree), expected_keys);
+
+  // The bulk loaded tree is still a valid tree to modify
+  for (int key = 0; key < 2000; key += 3) {
+    static_cast<void>(tree.erase(key));
+  }
+  tree.insert(1, 1);
+  for (int key = 0; key < 2000; key++) {
+    const bool expected = (key == 1) || ((key % 2 == 0) && (key % 3 != 0));
+    EXPECT_EQ(tree.lookup(key).has_value(), expected);
+  }
+}
+
+TEST(BPlusTreeTest, BulkLoadSmallInputs) {
+  std::vector<Ditto::Pair<int, int>> entries;
+  SmallTree<> empty{entries};
+  EXPECT_TRUE(empty.empty());
+  EXPECT_EQ(empty.depth(), 0);
+
+  entries.emplace_back(1, 2);
+  SmallTree<> single{entries};
+  EXPECT_EQ(single.depth(), 1);
+  EXPECT_EQ(*single.lookup(1).value(), 2);
+}
+
+TEST(BPlusTreeTest, BulkLoadUsesTheAllocator) {
+  struct Tag {};
+  using Allocator = Ditto::FixedPoolAllocator<int, 64, Tag>;
+  std::vector<Ditto::Pair<int, int>> entries;
+  for (int key = 0; key < 200; key++) {
+    entries.emplace_back(key, -key);
+  }
+
+  // The pool only fits 64 nodes, so this fails if nodes are leaked
+  for (int round = 0; round < 2; round++) {
+    Ditto::BPlusTree<int, int, 64, Allocator> tree{entries};
+    EXPECT_EQ(tree.size(), 200);
+    // 40 leaves of 5 entries under 8, 2 and 1 inner nodes
+    EXPECT_EQ(tree.depth(), 4);
+    for (int key = 0; key < 200; key++) {
+      EXPECT_EQ(*tree.lookup(key).value(), -key);
+    }
+  }
+}
+
+TEST(BPlusTreeTest, MovesNonTrivialValues) {
+  auto counter = std::make_shared<int>(0);
+  {
+    SmallTree<int, std::shared_ptr<int>> tree;
+    for (int key = 0; key < 200; key++) {
+      tree.insert(key, counter);
+    }
+    for (int key = 0; key < 200; key += 2) {
+      ASSERT_TRUE(tree.erase(key).has_value());
+    }
+    EXPECT_EQ(counter.use_count(), 101);
+
+    SmallTree<int, std::shared_ptr<int>> moved{std::move(tree)};
+    EXPECT_TRUE(tree.empty());
+    EXPECT_EQ(moved.size(), 100);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(BPlusTreeTest, StringKeys) {
+  Ditto::BPlusTree<std::string, int> tree;
+  for (const char* key : {"pear", "apple", "fig", "banana", "cherry"}) {
+    tree.insert(key, 1);
+  }
+  std::vector<std::string> keys;
+  tree.for_each_in_range("b", "g", [&](const std::string& key, int& value) {
+    keys.push_back(key);
+  });
+  EXPECT_THAT(keys, ElementsAre("banana", "cherry", "fig"));
+}
+
+TEST(BPlusTreeTest, ClearsSlabAllocatedTreeAtOnce) {
+  Ditto::BPlusTree<int, int, 256, Ditto::SlabAllocator<int>> tree;
+  for (int key = 0; key < 10000; key++) {
+    tree.insert(key, key);
+  }
+  tree.clear();
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.begin(), tree.end());
+
+  tree.insert(5, 5);
+  EXPECT_EQ(*tree.lookup(5).value(), 5);
+  EXPECT_EQ(tree.depth(), 1);
+}
@@ -194,3 +194,48 @@ TEST(CircularQueueTest, DestructorDestroysElementsInTheBuffer) {
 
   EXPECT_CALL(whiny, destructor()).Times(SIZE - 2);
 }
+
+TEST(CircularQueueTest, TracksSizeAcrossWrapAround) {
+  CircularQueue<int, 3> buffer;
+  EXPECT_EQ(buffer.size(), 0);
+
+  EXPECT_TRUE(buffer.push(1));
+  EXPECT_TRUE(buffer.push(2));
+  EXPECT_EQ(buffer.size(), 2);
+  EXPECT_TRUE(buffer.push(3));
+  EXPECT_EQ(buffer.size(), 3);
+
+  EXPECT_EQ(buffer.pop().value(), 1);
+  EXPECT_EQ(buffer.pop().value(), 2);
+  EXPECT_TRUE(buffer.push(4));
+  EXPECT_EQ(buffer.size(), 2);
+
+  buffer.discard();
+  buffer.discard();
+  EXPECT_EQ(buffer.size(), 0);
+}
+
+TEST(CircularQueueTest, FindsElementsInFifoOrder) {
+  CircularQueue<std::string, 3> buffer;
+  EXPECT_EQ(buffer.find_if([](const std::string&) { return true; }), nullptr);
+
+  EXPECT_TRUE(buffer.push("first"));
+  EXPECT_TRUE(buffer.push("second"));
+  buffer.discard();
+  EXPECT_TRUE(buffer.push("third"));
+  EXPECT_TRUE(buffer.push("fourth"));
+
+  auto* found = buffer.find_if(
+      [](const std::string& element) { return element.size() > 5; });
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(*found, "second");
+
+  found = buffer.find_if(
+      [](const std::string& element) { return element == "fourth"; });
+  ASSERT_NE(found, nullptr);
+  EXPECT_EQ(*found, "fourth");
+
+  EXPECT_EQ(buffer.find_if(
+                [](const std::string& element) { return element == "first"; }),
+            nullptr);
+}
@@ -0,0 +1,160 @@
+#include "ditto/concurrent_skip_list.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using testing::ElementsAre;
+
+namespace {
+
+template <class List>
+auto keys_in_range(const List& list, int first, int last) -> std::vector<int> {
+  std::vector<int> keys;
+  list.for_each_in_range(first, last, [&](const int& key, const int& value) {
+    EXPECT_EQ(value, 10 * key);
+    keys.push_back(key);
+  });
+  return keys;
+}
+
+}  // namespace
+
+TEST(ConcurrentSkipListTest, InsertLookupAndErase) {
+  Ditto::ConcurrentSkipList<int, int> list;
+  EXPECT_TRUE(list.empty());
+
+  EXPECT_TRUE(list.insert(3, 30));
+  EXPECT_TRUE(list.insert(1, 10));
+  EXPECT_TRUE(list.insert(2, 20));
+  // Existing keys are not overwritten
+  EXPECT_FALSE(list.insert(2, 0));
+  EXPECT_EQ(list.size(), 3);
+
+  EXPECT_EQ(list.lookup(2).value(), 20);
+  EXPECT_TRUE(list.contains(3));
+  EXPECT_FALSE(list.lookup(4).has_value());
+
+  EXPECT_EQ(list.erase(2).value(), 20);
+  EXPECT_FALSE(list.erase(2).has_value());
+  EXPECT_FALSE(list.contains(2));
+  EXPECT_EQ(list.size(), 2);
+
+  EXPECT_TRUE(list.insert(2, 20));
+  EXPECT_EQ(list.lookup(2).value(), 20);
+}
+
+TEST(ConcurrentSkipListTest, ScansRangesInOrder) {
+  Ditto::ConcurrentSkipList<int, int> list;
+  for (int key : {5, 1, 9, 3, 7, 2, 8}) {
+    ASSERT_TRUE(list.insert(key, 10 * key));
+  }
+
+  EXPECT_THAT(keys_in_range(list, 0, 100), ElementsAre(1, 2, 3, 5, 7, 8, 9));
+  EXPECT_THAT(keys_in_range(list, 3, 8), ElementsAre(3, 5, 7));
+  EXPECT_THAT(keys_in_range(list, 4, 5), ElementsAre());
+}
+
+TEST(ConcurrentSkipListTest, ReclaimsErasedNodes) {
+  auto counter = std::make_shared<int>(0);
+  {
+    Ditto::ConcurrentSkipList<int, std::shared_ptr<int>> list;
+    for (int key = 0; key < 1000; key++) {
+      list.insert(key, counter);
+    }
+    for (int key = 0; key < 1000; key += 2) {
+      ASSERT_TRUE(list.erase(key).has_value());
+    }
+    // Erased nodes are reclaimed in batches
+    EXPECT_LE(counter.use_count(),
+              1 + 500 + static_cast<long>(list.RECLAIM_BATCH_SIZE));
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(ConcurrentSkipListTest, ConcurrentInsertions) {
+  constexpr int NUM_THREADS = 4;
+  constexpr int KEYS_PER_THREAD = 2000;
+  Ditto::ConcurrentSkipList<int, int> list;
+
+  std::vector<std::thread> threads;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    threads.emplace_back([&list, i] {
+      // Threads interleave their keys, so they insert next to each other
+      for (int j = 0; j < KEYS_PER_THREAD; j++) {
+        const int key = j * NUM_THREADS + i;
+        EXPECT_TRUE(list.insert(key, 10 * key));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(list.size(), NUM_THREADS * KEYS_PER_THREAD);
+  const auto keys = keys_in_range(list, 0, NUM_THREADS * KEYS_PER_THREAD);
+  ASSERT_EQ(keys.size(), NUM_THREADS * KEYS_PER_THREAD);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    EXPECT_EQ(keys[i], static_cast<int>(i));
+  }
+}
+
+TEST(ConcurrentSkipListTest, ReadersSeeConsistentScansDuringWrites) {
+  static constexpr int NUM_KEYS = 1000;
+  Ditto::ConcurrentSkipList<int, int> list;
+  // Even keys stay in the list, odd keys are inserted and erased repeatedly
+  for (int key = 0; key < NUM_KEYS; key += 2) {
+    list.insert(key, 10 * key);
+  }
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> writers;
+  for (int i = 0; i < 2; i++) {
+    writers.emplace_back([&list, i] {
+      for (int round = 0; round < 20; round++) {
+        for (int key = 1 + 2 * i; key < NUM_KEYS; key += 4) {
+          list.insert(key, 10 * key);
+        }
+        for (int key = 1 + 2 * i; key < NUM_KEYS; key += 4) {
+          EXPECT_TRUE(list.erase(key).has_value());
+        }
+      }
+    });
+  }
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 2; i++) {
+    readers.emplace_back([&list, &done] {
+      while (!done.load()) {
+        int previous = -1;
+        int num_even = 0;
+        list.for_each_in_range(0, NUM_KEYS,
+                               [&](const int& key, const int& value) {
+                                 EXPECT_GT(key, previous);
+                                 EXPECT_EQ(value, 10 * key);
+                                 previous = key;
+                                 num_even += (key % 2 == 0) ? 1 : 0;
+                               });
+        EXPECT_EQ(num_even, NUM_KEYS / 2);
+        EXPECT_EQ(list.lookup(500).value(), 5000);
+      }
+    });
+  }
+
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  done.store(true);
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(list.size(), NUM_KEYS / 2);
+  for (int key = 1; key < NUM_KEYS; key += 2) {
+    EXPECT_FALSE(list.contains(key));
+  }
+}
@@ -4,8 +4,13 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <thread>
+#include <vector>
+
+#include "ditto/task.h"
 
 using testing::InSequence;
 using testing::StrictMock;
@@ -68,3 +73,437 @@ TEST(EventLoopTest, TestLoop) {
   std::thread t{[&loop]() { loop.run(); }};
   t.join();
 }
+
+using PriorityEventLoop = Ditto::EventLoop<Event, Hal, 4, 10, 3>;
+
+class MockPriorityListener : public PriorityEventLoop::Listener {
+ public:
+  MOCK_METHOD(void, on_event, (Event), (override));
+};
+
+TEST(EventLoopTest, DispatchesHighestPriorityFirst) {
+  StrictMock<MockPriorityListener> listener;
+  testing::NiceMock<Hal> hal;
+  PriorityEventLoop loop{&hal};
+  loop.register_listener(&listener);
+
+  loop.post_event(Event::SOMETHING, 0);
+  loop.post_event(Event::SOMETHING, 1);
+  loop.post_event(Event::SOMETHING_ELSE, 2);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE));
+  EXPECT_CALL(listener, on_event(Event::SOMETHING)).Times(2);
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+
+  loop.run();
+}
+
+TEST(EventLoopTest, AgingLetsLowPriorityEventsProgress) {
+  StrictMock<MockPriorityListener> listener;
+  testing::NiceMock<Hal> hal;
+  PriorityEventLoop loop{&hal};
+  loop.register_listener(&listener);
+  loop.set_aging_threshold(2);
+
+  loop.post_event(Event::SOMETHING, 0);
+  loop.post_event(Event::SOMETHING_ELSE, 2);
+  loop.post_event(Event::SOMETHING_ELSE, 2);
+  loop.post_event(Event::SOMETHING_ELSE, 2);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE)).Times(2);
+  EXPECT_CALL(listener, on_event(Event::SOMETHING));
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE));
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+
+  loop.run();
+}
+
+TEST(EventLoopTest, CountsOverflowsPerLane) {
+  testing::NiceMock<Hal> hal;
+  Ditto::EventLoop<Event, Hal, 2, 10, 2> loop{&hal};
+
+  loop.post_event(Event::SOMETHING, 1);
+  loop.post_event(Event::SOMETHING, 1);
+  loop.post_event(Event::SOMETHING_ELSE, 1);
+  loop.post_event(Event::SOMETHING_ELSE, 0);
+
+  EXPECT_EQ(loop.overflow_count(0), 0);
+  EXPECT_EQ(loop.overflow_count(1), 1);
+}
+
+class ClockHal {
+ public:
+  void wfe() { m_now++; }
+  void disable_interrupts() {}
+  void enable_interrupts() {}
+  [[nodiscard]] auto now() const -> std::uint32_t { return m_now; }
+
+ private:
+  std::uint32_t m_now = 0;
+};
+
+using ClockEventLoop = Ditto::EventLoop<Event, ClockHal>;
+
+namespace {
+
+auto wait_then_sleep(ClockEventLoop* loop, ClockHal* hal,
+                     std::vector<std::uint32_t>* steps) -> Ditto::Task<> {
+  steps->push_back(hal->now());
+  const Event event = co_await loop->wait_for(Event::SOMETHING);
+  EXPECT_EQ(event, Event::SOMETHING);
+  steps->push_back(hal->now());
+  co_await loop->sleep_for(5);
+  steps->push_back(hal->now());
+  loop->stop();
+}
+
+}  // namespace
+
+TEST(EventLoopTest, ResumesCoroutinesOnEventsAndTimers) {
+  ClockHal hal;
+  ClockEventLoop loop{&hal};
+  std::vector<std::uint32_t> steps;
+
+  auto task = wait_then_sleep(&loop, &hal, &steps);
+  task.start();
+  EXPECT_EQ(steps, std::vector<std::uint32_t>{0});
+
+  loop.post_event(Event::SOMETHING_ELSE);
+  loop.post_event(Event::SOMETHING);
+  loop.run();
+
+  EXPECT_TRUE(task.done());
+  EXPECT_EQ(steps, (std::vector<std::uint32_t>{0, 0, 5}));
+}
+
+namespace {
+
+auto wait_for_event(EventLoop* loop, bool* resumed) -> Ditto::Task<> {
+  co_await loop->wait_for(Event::SOMETHING);
+  *resumed = true;
+}
+
+auto sleep_then_flag(ClockEventLoop* loop, std::uint32_t ticks, bool* resumed)
+    -> Ditto::Task<> {
+  co_await loop->sleep_for(ticks);
+  *resumed = true;
+}
+
+auto sleep_then_stop(ClockEventLoop* loop, std::uint32_t ticks)
+    -> Ditto::Task<> {
+  co_await loop->sleep_for(ticks);
+  loop->stop();
+}
+
+}  // namespace
+
+TEST(EventLoopTest, DestroyingASuspendedTaskCancelsItsEventWait) {
+  testing::NiceMock<Hal> hal;
+  EventLoop loop{&hal};
+  bool abandoned_resumed = false;
+  bool resumed = false;
+
+  {
+    auto abandoned = wait_for_event(&loop, &abandoned_resumed);
+    abandoned.start();
+  }
+  auto task = wait_for_event(&loop, &resumed);
+  task.start();
+
+  loop.post_event(Event::SOMETHING);
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+  loop.run();
+
+  EXPECT_FALSE(abandoned_resumed);
+  EXPECT_TRUE(resumed);
+  EXPECT_TRUE(task.done());
+}
+
+TEST(EventLoopTest, DestroyingASuspendedTaskCancelsItsTimer) {
+  ClockHal hal;
+  ClockEventLoop loop{&hal};
+  bool abandoned_resumed = false;
+  bool resumed = false;
+
+  {
+    auto abandoned = sleep_then_flag(&loop, 5, &abandoned_resumed);
+    abandoned.start();
+  }
+  auto task = sleep_then_flag(&loop, 5, &resumed);
+  task.start();
+  auto stopper = sleep_then_stop(&loop, 10);
+  stopper.start();
+
+  loop.run();
+
+  EXPECT_FALSE(abandoned_resumed);
+  EXPECT_TRUE(resumed);
+  EXPECT_TRUE(stopper.done());
+}
+
+class CycleCountingHal {
+ public:
+  void wfe() {}
+  void disable_interrupts() {}
+  void enable_interrupts() {}
+  [[nodiscard]] auto cycle_count() const -> std::uint32_t { return cycles; }
+
+  std::uint32_t cycles = 0;
+};
+
+using InstrumentedEventLoop =
+    Ditto::EventLoop<Event, CycleCountingHal, 10, 10, 1,
+                     Ditto::EventLoopStats<2>>;
+
+class SlowListener : public InstrumentedEventLoop::Listener {
+ public:
+  SlowListener(InstrumentedEventLoop* loop, CycleCountingHal* hal)
+      : m_loop(loop), m_hal(hal) {}
+
+  void on_event(Event event) override {
+    if (event == Event::SOMETHING) {
+      m_hal->cycles += 50;
+    } else {
+      m_loop->stop();
+    }
+  }
+
+ private:
+  InstrumentedEventLoop* m_loop;
+  CycleCountingHal* m_hal;
+};
+
+TEST(EventLoopTest, MeasuresQueueLatencyAndHandlerDuration) {
+  CycleCountingHal hal;
+  InstrumentedEventLoop loop{&hal};
+  SlowListener listener{&loop, &hal};
+  loop.register_listener(&listener);
+
+  hal.cycles = 100;
+  loop.post_event(Event::SOMETHING);
+  loop.post_event(Event::SOMETHING_ELSE);
+  hal.cycles = 400;
+  loop.run();
+
+  const auto& stats = loop.instrumentation();
+  EXPECT_EQ(stats.queue_high_water_mark(), 2);
+
+  EXPECT_EQ(stats.queue_latency(Event::SOMETHING).count(), 1);
+  EXPECT_EQ(stats.queue_latency(Event::SOMETHING).max(), 300);
+  EXPECT_EQ(stats.handler_duration(Event::SOMETHING).count(), 1);
+  EXPECT_EQ(stats.handler_duration(Event::SOMETHING).max(), 50);
+
+  EXPECT_EQ(stats.queue_latency(Event::SOMETHING_ELSE).count(), 1);
+  EXPECT_EQ(stats.queue_latency(Event::SOMETHING_ELSE).max(), 350);
+  EXPECT_EQ(stats.handler_duration(Event::SOMETHING_ELSE).max(), 0);
+}
+
+using SmallEventLoop = Ditto::EventLoop<Event, Hal, 2>;
+
+class MockSmallListener : public SmallEventLoop::Listener {
+ public:
+  MOCK_METHOD(void, on_event, (Event), (override));
+};
+
+TEST(EventLoopTest, DropsNewestEventsByDefault) {
+  StrictMock<MockSmallListener> listener;
+  testing::NiceMock<Hal> hal;
+  SmallEventLoop loop{&hal};
+  loop.register_listener(&listener);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE),
+            Ditto::PostStatus::DROPPED);
+  EXPECT_EQ(loop.overflow_count(0), 1);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING)).Times(2);
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+  loop.run();
+}
+
+TEST(EventLoopTest, CanDropOldestEventsOnOverflow) {
+  StrictMock<MockSmallListener> listener;
+  testing::NiceMock<Hal> hal;
+  SmallEventLoop loop{&hal};
+  loop.register_listener(&listener);
+  loop.set_overflow_policy(Ditto::OverflowPolicy::DROP_OLDEST);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE),
+            Ditto::PostStatus::DROPPED_OLDEST);
+  EXPECT_EQ(loop.overflow_count(0), 1);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING));
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE));
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+  loop.run();
+}
+
+TEST(EventLoopTest, CanCoalesceEventsOnOverflow) {
+  testing::NiceMock<Hal> hal;
+  SmallEventLoop loop{&hal};
+  loop.set_overflow_policy(Ditto::OverflowPolicy::COALESCE);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::COALESCED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE),
+            Ditto::PostStatus::DROPPED);
+  EXPECT_EQ(loop.overflow_count(0), 1);
+}
+
+class ThreadedHal {
+ public:
+  void wfe() { std::this_thread::yield(); }
+  void yield() { std::this_thread::yield(); }
+  void disable_interrupts() { m_mutex.lock(); }
+  void enable_interrupts() { m_mutex.unlock(); }
+
+ private:
+  std::mutex m_mutex;
+};
+
+using ThreadedEventLoop = Ditto::EventLoop<int, ThreadedHal, 2>;
+
+class CountingListener : public ThreadedEventLoop::Listener {
+ public:
+  CountingListener(ThreadedEventLoop* loop, int expected_events)
+      : m_loop(loop), m_expected_events(expected_events) {}
+
+  void on_event(int event) override {
+    received.push_back(event);
+    if (static_cast<int>(received.size()) == m_expected_events) {
+      m_loop->stop();
+    }
+  }
+
+  std::vector<int> received;
+
+ private:
+  ThreadedEventLoop* m_loop;
+  int m_expected_events;
+};
+
+TEST(EventLoopTest, CanBlockProducersUntilThereIsSpace) {
+  constexpr int NUM_EVENTS = 100;
+  ThreadedHal hal;
+  ThreadedEventLoop loop{&hal};
+  CountingListener listener{&loop, NUM_EVENTS};
+  loop.register_listener(&listener);
+  loop.set_overflow_policy(Ditto::OverflowPolicy::BLOCK);
+
+  std::thread consumer{[&loop]() { loop.run(); }};
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    EXPECT_EQ(loop.post_event(i), Ditto::PostStatus::QUEUED);
+  }
+  consumer.join();
+
+  ASSERT_EQ(listener.received.size(), NUM_EVENTS);
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    EXPECT_EQ(listener.received[i], i);
+  }
+  EXPECT_EQ(loop.overflow_count(0), 0);
+}
+
+TEST(EventLoopTest, CoalescesPendingEvents) {
+  StrictMock<MockListener> listener;
+  testing::NiceMock<Hal> hal;
+  EventLoop loop{&hal};
+  loop.register_listener(&listener);
+  loop.set_coalescing(Event::SOMETHING, true);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::COALESCED);
+  }
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE), Ditto::PostStatus::QUEUED);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING)).WillOnce([&loop]() {
+    // Once dispatched, the event is no longer pending
+    EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  });
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE)).Times(2);
+  EXPECT_CALL(listener, on_event(Event::SOMETHING));
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+  loop.run();
+
+  EXPECT_EQ(loop.overflow_count(0), 0);
+}
+
+TEST(EventLoopTest, DroppedEventsAreNoLongerPending) {
+  testing::NiceMock<Hal> hal;
+  SmallEventLoop loop{&hal};
+  loop.set_coalescing(Event::SOMETHING, true);
+  loop.set_overflow_policy(Ditto::OverflowPolicy::DROP_OLDEST);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE),
+            Ditto::PostStatus::DROPPED_OLDEST);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING),
+            Ditto::PostStatus::DROPPED_OLDEST);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::COALESCED);
+}
+
+TEST(EventLoopTest, UrgentEventsAreNotCoalescedIntoLowerLanes) {
+  StrictMock<MockPriorityListener> listener;
+  testing::NiceMock<Hal> hal;
+  PriorityEventLoop loop{&hal};
+  loop.register_listener(&listener);
+  loop.set_coalescing(Event::SOMETHING, true);
+
+  EXPECT_EQ(loop.post_event(Event::SOMETHING, 0), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING_ELSE, 1),
+            Ditto::PostStatus::QUEUED);
+  // A copy pending in a lower lane would be dispatched too late
+  EXPECT_EQ(loop.post_event(Event::SOMETHING, 2), Ditto::PostStatus::QUEUED);
+  // A copy pending in the same or a higher lane is dispatched soon enough
+  EXPECT_EQ(loop.post_event(Event::SOMETHING, 2),
+            Ditto::PostStatus::COALESCED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING, 1),
+            Ditto::PostStatus::COALESCED);
+
+  InSequence s;
+  EXPECT_CALL(listener, on_event(Event::SOMETHING));
+  EXPECT_CALL(listener, on_event(Event::SOMETHING_ELSE));
+  EXPECT_CALL(listener, on_event(Event::SOMETHING));
+  EXPECT_CALL(hal, wfe()).WillOnce([&loop]() { loop.stop(); });
+  loop.run();
+}
+
+TEST(EventLoopTest, OnlyCoalescingEventsNeedToFitTheBitset) {
+  ThreadedHal hal;
+  ThreadedEventLoop loop{&hal};
+  CountingListener listener{&loop, 2};
+  loop.register_listener(&listener);
+
+  EXPECT_FALSE(loop.set_coalescing(1000, true));
+  EXPECT_TRUE(loop.set_coalescing(1, true));
+
+  EXPECT_EQ(loop.post_event(1000), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(1000), Ditto::PostStatus::QUEUED);
+  loop.run();
+
+  EXPECT_EQ(listener.received, (std::vector<int>{1000, 1000}));
+}
+
+TEST(EventLoopTest, RefusesToBlockWithoutYield) {
+  testing::NiceMock<Hal> hal;
+  SmallEventLoop loop{&hal};
+  EXPECT_TRUE(loop.set_overflow_policy(Ditto::OverflowPolicy::DROP_OLDEST));
+  EXPECT_FALSE(loop.set_overflow_policy(Ditto::OverflowPolicy::BLOCK));
+
+  // The previous policy is kept
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING), Ditto::PostStatus::QUEUED);
+  EXPECT_EQ(loop.post_event(Event::SOMETHING),
+            Ditto::PostStatus::DROPPED_OLDEST);
+}
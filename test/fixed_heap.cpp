@@ -0,0 +1,121 @@
+#include "ditto/fixed_heap.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <string>
+#include <vector>
+
+using testing::ElementsAre;
+
+namespace {
+
+template <class Heap>
+auto drain(Heap& heap) -> std::vector<typename Heap::value_type> {
+  std::vector<typename Heap::value_type> result;
+  while (auto value = heap.pop()) {
+    result.push_back(*value);
+  }
+  return result;
+}
+
+// Checks a heap against std::priority_queue with random pushes and pops
+template <std::size_t ARITY>
+void check_against_priority_queue() {
+  constexpr std::size_t CAPACITY = 257;
+  Ditto::FixedDaryHeap<std::uint32_t, CAPACITY, ARITY> heap;
+  std::priority_queue<std::uint32_t, std::vector<std::uint32_t>,
+                      std::greater<>>
+      expected;
+  std::mt19937 generator{ARITY};
+
+  for (int i = 0; i < 10000; i++) {
+    if (((generator() % 3) != 0) && !heap.full()) {
+      const std::uint32_t value = generator() % 1000;
+      ASSERT_TRUE(heap.push(value));
+      expected.push(value);
+    } else if (!expected.empty()) {
+      const auto value = heap.pop();
+      ASSERT_TRUE(value.has_value());
+      ASSERT_EQ(*value, expected.top());
+      expected.pop();
+    } else {
+      ASSERT_FALSE(heap.pop().has_value());
+    }
+    ASSERT_EQ(heap.size(), expected.size());
+    if (!expected.empty()) {
+      ASSERT_EQ(heap.top(), expected.top());
+    }
+  }
+}
+
+}  // namespace
+
+TEST(FixedHeapTest, PopsInOrder) {
+  Ditto::FixedHeap<int, 8> heap;
+  EXPECT_TRUE(heap.empty());
+  EXPECT_FALSE(heap.pop().has_value());
+
+  for (int value : {5, 3, 8, 1, 9, 2}) {
+    EXPECT_TRUE(heap.push(value));
+  }
+  EXPECT_EQ(heap.size(), 6);
+  EXPECT_EQ(heap.top(), 1);
+  EXPECT_THAT(drain(heap), ElementsAre(1, 2, 3, 5, 8, 9));
+  EXPECT_TRUE(heap.empty());
+}
+
+TEST(FixedHeapTest, MaxHeap) {
+  Ditto::FixedHeap<int, 8, std::greater<int>> heap;
+  for (int value : {5, 3, 8, 1, 9, 2, 9}) {
+    EXPECT_TRUE(heap.push(value));
+  }
+  EXPECT_THAT(drain(heap), ElementsAre(9, 9, 8, 5, 3, 2, 1));
+}
+
+TEST(FixedHeapTest, RejectsPushWhenFull) {
+  Ditto::FixedHeap<int, 3> heap;
+  EXPECT_TRUE(heap.push(3));
+  EXPECT_TRUE(heap.push(2));
+  EXPECT_TRUE(heap.emplace(1));
+  EXPECT_TRUE(heap.full());
+  EXPECT_FALSE(heap.push(0));
+  EXPECT_EQ(heap.top(), 1);
+
+  EXPECT_EQ(heap.pop(), 1);
+  EXPECT_TRUE(heap.push(0));
+  EXPECT_THAT(drain(heap), ElementsAre(0, 2, 3));
+}
+
+TEST(FixedHeapTest, DestroysElements) {
+  // Long strings live on the heap, so leaking one is caught by the sanitizers
+  Ditto::FixedDaryHeap<std::string, 16, 4> heap;
+  for (char c : std::string{"heapsort"}) {
+    EXPECT_TRUE(heap.emplace(40, c));
+  }
+  EXPECT_EQ(heap.pop(), std::string(40, 'a'));
+  EXPECT_EQ(heap.pop(), std::string(40, 'e'));
+  EXPECT_EQ(heap.size(), 6);
+
+  heap.clear();
+  EXPECT_TRUE(heap.empty());
+  EXPECT_TRUE(heap.emplace(40, 'z'));
+}
+
+TEST(FixedHeapTest, DefaultArityFillsACacheLine) {
+  EXPECT_EQ(Ditto::CACHE_LINE_ARITY<std::uint64_t>, 8);
+  EXPECT_EQ(Ditto::CACHE_LINE_ARITY<std::uint8_t>, 8);
+  EXPECT_EQ((Ditto::CACHE_LINE_ARITY<std::array<std::uint64_t, 4>>), 2);
+  EXPECT_EQ((Ditto::CACHE_LINE_ARITY<std::array<std::uint64_t, 16>>), 2);
+}
+
+TEST(FixedHeapTest, MatchesPriorityQueue) {
+  check_against_priority_queue<2>();
+  check_against_priority_queue<3>();
+  check_against_priority_queue<4>();
+  check_against_priority_queue<8>();
+}
@@ -0,0 +1,46 @@
+#include "ditto/histogram.h"
+
+#include <gtest/gtest.h>
+
+TEST(Log2HistogramTest, IsEmptyWhenConstructed) {
+  Ditto::Log2Histogram<8> histogram;
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.total(), 0);
+  EXPECT_EQ(histogram.max(), 0);
+  for (std::size_t i = 0; i < histogram.num_buckets(); i++) {
+    EXPECT_EQ(histogram.bucket(i), 0);
+  }
+}
+
+TEST(Log2HistogramTest, RecordsSamplesInLogarithmicBuckets) {
+  Ditto::Log2Histogram<8> histogram;
+  histogram.record(0);
+  histogram.record(1);
+  histogram.record(2);
+  histogram.record(3);
+  histogram.record(64);
+  histogram.record(127);
+
+  EXPECT_EQ(histogram.bucket(0), 1);
+  EXPECT_EQ(histogram.bucket(1), 1);
+  EXPECT_EQ(histogram.bucket(2), 2);
+  EXPECT_EQ(histogram.bucket(7), 2);
+  EXPECT_EQ(histogram.count(), 6);
+  EXPECT_EQ(histogram.total(), 197);
+  EXPECT_EQ(histogram.max(), 127);
+
+  EXPECT_EQ(histogram.bucket_lower_bound(0), 0);
+  EXPECT_EQ(histogram.bucket_lower_bound(1), 1);
+  EXPECT_EQ(histogram.bucket_lower_bound(7), 64);
+}
+
+TEST(Log2HistogramTest, LastBucketCountsLargeSamples) {
+  Ditto::Log2Histogram<4> histogram;
+  histogram.record(8);
+  histogram.record(1000);
+  EXPECT_EQ(histogram.bucket(3), 2);
+
+  histogram.reset();
+  EXPECT_EQ(histogram.count(), 0);
+  EXPECT_EQ(histogram.bucket(3), 0);
+}
@@ -0,0 +1,180 @@
+#include "ditto/indexed_priority_queue.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+using testing::ElementsAre;
+
+namespace {
+
+template <class Queue>
+auto drain(Queue& queue) -> std::vector<std::size_t> {
+  std::vector<std::size_t> result;
+  while (auto index = queue.pop()) {
+    result.push_back(*index);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(IndexedPriorityQueueTest, PopsByPriority) {
+  Ditto::IndexedPriorityQueue<int, 8> queue;
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.pop().has_value());
+
+  EXPECT_TRUE(queue.push(0, 50));
+  EXPECT_TRUE(queue.push(3, 10));
+  EXPECT_TRUE(queue.push(7, 30));
+  EXPECT_TRUE(queue.push(5, 20));
+
+  EXPECT_EQ(queue.size(), 4);
+  EXPECT_TRUE(queue.contains(7));
+  EXPECT_FALSE(queue.contains(1));
+  EXPECT_EQ(queue.priority(7), 30);
+  EXPECT_EQ(queue.top(), 3);
+  EXPECT_EQ(queue.top_priority(), 10);
+
+  EXPECT_THAT(drain(queue), ElementsAre(3, 5, 7, 0));
+  EXPECT_FALSE(queue.contains(3));
+}
+
+TEST(IndexedPriorityQueueTest, PushingAQueuedIndexFails) {
+  Ditto::IndexedPriorityQueue<int, 4> queue;
+  EXPECT_TRUE(queue.push(2, 10));
+  EXPECT_FALSE(queue.push(2, 5));
+  EXPECT_EQ(queue.priority(2), 10);
+  EXPECT_EQ(queue.size(), 1);
+}
+
+TEST(IndexedPriorityQueueTest, DecreaseKey) {
+  Ditto::IndexedPriorityQueue<int, 8> queue;
+  for (std::size_t i = 0; i < 8; i++) {
+    EXPECT_TRUE(queue.push(i, 100 + static_cast<int>(i)));
+  }
+
+  queue.decrease_key(6, 1);
+  EXPECT_EQ(queue.top(), 6);
+  queue.decrease_key(4, 50);
+  queue.decrease_key(4, 50);
+  EXPECT_EQ(queue.priority(4), 50);
+
+  EXPECT_THAT(drain(queue), ElementsAre(6, 4, 0, 1, 2, 3, 5, 7));
+}
+
+TEST(IndexedPriorityQueueTest, UpdateAndErase) {
+  Ditto::IndexedPriorityQueue<int, 8, std::greater<int>> queue;
+  for (std::size_t i = 0; i < 6; i++) {
+    EXPECT_TRUE(queue.push(i, static_cast<int>(i)));
+  }
+  EXPECT_EQ(queue.top(), 5);
+
+  queue.update(5, -1);
+  queue.update(0, 10);
+  EXPECT_TRUE(queue.erase(3));
+  EXPECT_FALSE(queue.erase(3));
+  EXPECT_FALSE(queue.erase(7));
+
+  EXPECT_THAT(drain(queue), ElementsAre(0, 4, 2, 1, 5));
+}
+
+TEST(IndexedPriorityQueueTest, Clear) {
+  Ditto::IndexedPriorityQueue<int, 4> queue;
+  EXPECT_TRUE(queue.push(1, 1));
+  EXPECT_TRUE(queue.push(2, 2));
+  queue.clear();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_FALSE(queue.contains(1));
+  EXPECT_TRUE(queue.push(1, 3));
+  EXPECT_EQ(queue.top(), 1);
+}
+
+TEST(IndexedPriorityQueueTest, MatchesMap) {
+  constexpr std::size_t CAPACITY = 300;
+  Ditto::IndexedPriorityQueue<std::uint32_t, CAPACITY> queue;
+  std::map<std::size_t, std::uint32_t> expected;
+  std::mt19937 generator{7};
+
+  for (int i = 0; i < 20000; i++) {
+    const std::size_t index = generator() % CAPACITY;
+    const std::uint32_t priority = generator() % 1000;
+    switch (generator() % 4) {
+      case 0:
+        ASSERT_EQ(queue.push(index, priority), !expected.contains(index));
+        expected.try_emplace(index, priority);
+        break;
+      case 1:
+        if (expected.contains(index)) {
+          queue.update(index, priority);
+          expected[index] = priority;
+        }
+        break;
+      case 2:
+        ASSERT_EQ(queue.erase(index), expected.erase(index) == 1);
+        break;
+      default:
+        if (!expected.empty()) {
+          const std::uint32_t smallest = queue.top_priority();
+          const std::size_t top = *queue.pop();
+          ASSERT_EQ(expected.at(top), smallest);
+          for (const auto& [key, value] : expected) {
+            ASSERT_LE(smallest, value);
+          }
+          expected.erase(top);
+        }
+        break;
+    }
+
+    ASSERT_EQ(queue.size(), expected.size());
+    for (const auto& [key, value] : expected) {
+      ASSERT_EQ(queue.priority(key), value);
+    }
+  }
+}
+
+TEST(IndexedPriorityQueueTest, Dijkstra) {
+  constexpr std::size_t NUM_VERTICES = 6;
+  struct Edge {
+    std::size_t to;
+    std::uint32_t weight;
+  };
+  const std::array<std::vector<Edge>, NUM_VERTICES> graph{{
+      {{1, 7}, {2, 9}, {5, 14}},
+      {{0, 7}, {2, 10}, {3, 15}},
+      {{0, 9}, {1, 10}, {3, 11}, {5, 2}},
+      {{1, 15}, {2, 11}, {4, 6}},
+      {{3, 6}, {5, 9}},
+      {{0, 14}, {2, 2}, {4, 9}},
+  }};
+
+  std::array<std::uint32_t, NUM_VERTICES> distance;
+  distance.fill(std::numeric_limits<std::uint32_t>::max());
+  distance[0] = 0;
+
+  Ditto::IndexedPriorityQueue<std::uint32_t, NUM_VERTICES> queue;
+  EXPECT_TRUE(queue.push(0, 0));
+  while (auto vertex = queue.pop()) {
+    for (const Edge& edge : graph[*vertex]) {
+      const std::uint32_t candidate = distance[*vertex] + edge.weight;
+      if (candidate >= distance[edge.to]) {
+        continue;
+      }
+      distance[edge.to] = candidate;
+      if (queue.contains(edge.to)) {
+        queue.decrease_key(edge.to, candidate);
+      } else {
+        EXPECT_TRUE(queue.push(edge.to, candidate));
+      }
+    }
+  }
+
+  EXPECT_THAT(distance, ElementsAre(0, 7, 9, 20, 20, 11));
+}
@@ -0,0 +1,181 @@
+#include "ditto/intrusive_list.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using testing::ElementsAre;
+using testing::ElementsAreArray;
+
+namespace {
+
+struct Request {
+  explicit Request(int id) : id(id) {}
+
+  int id;
+  Ditto::IntrusiveListHook pending_hook;
+  Ditto::IntrusiveListHook active_hook;
+
+  auto operator==(const Request& other) const -> bool { return id == other.id; }
+};
+
+using PendingList = Ditto::IntrusiveList<Request, &Request::pending_hook>;
+using ActiveList = Ditto::IntrusiveList<Request, &Request::active_hook>;
+
+auto ids(const PendingList& list) -> std::vector<int> {
+  std::vector<int> result;
+  for (const Request& request : list) {
+    result.push_back(request.id);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(IntrusiveListTest, PushAndPop) {
+  std::array requests{Request{1}, Request{2}, Request{3}};
+  PendingList list;
+  EXPECT_TRUE(list.empty());
+
+  list.push_back(requests[0]);
+  list.push_back(requests[1]);
+  list.push_front(requests[2]);
+  EXPECT_EQ(list.size(), 3);
+  EXPECT_THAT(ids(list), ElementsAre(3, 1, 2));
+  EXPECT_EQ(list.front().id, 3);
+  EXPECT_EQ(list.back().id, 2);
+
+  list.pop_front();
+  EXPECT_FALSE(requests[2].pending_hook.is_linked());
+  list.pop_back();
+  EXPECT_THAT(ids(list), ElementsAre(1));
+
+  list.pop_back();
+  EXPECT_TRUE(list.empty());
+}
+
+TEST(IntrusiveListTest, InsertEraseAndRemove) {
+  std::array requests{Request{1}, Request{2}, Request{3}, Request{4}};
+  PendingList list;
+  list.push_back(requests[0]);
+  list.push_back(requests[2]);
+
+  auto iter = list.insert(++list.cbegin(), requests[1]);
+  EXPECT_EQ(iter->id, 2);
+  list.insert(list.cend(), requests[3]);
+  EXPECT_THAT(ids(list), ElementsAre(1, 2, 3, 4));
+
+  iter = list.erase(list.iterator_to(requests[1]));
+  EXPECT_EQ(iter->id, 3);
+  EXPECT_EQ(list.erase(list.iterator_to(requests[3])), list.end());
+
+  list.remove(requests[0]);
+  EXPECT_THAT(ids(list), ElementsAre(3));
+  EXPECT_EQ(list.size(), 1);
+
+  list.clear();
+  EXPECT_TRUE(list.empty());
+  for (const Request& request : requests) {
+    EXPECT_FALSE(request.pending_hook.is_linked());
+  }
+}
+
+TEST(IntrusiveListTest, ObjectsCanBeInSeveralLists) {
+  std::array requests{Request{1}, Request{2}, Request{3}};
+  PendingList pending;
+  ActiveList active;
+
+  for (Request& request : requests) {
+    pending.push_back(request);
+  }
+  active.push_front(requests[0]);
+  active.push_front(requests[2]);
+
+  pending.remove(requests[2]);
+  EXPECT_THAT(ids(pending), ElementsAre(1, 2));
+  EXPECT_THAT(active,
+              ElementsAreArray({std::ref(requests[2]), std::ref(requests[0])}));
+
+  pending.clear();
+  active.clear();
+}
+
+TEST(IntrusiveListTest, IteratesInReverse) {
+  std::array requests{Request{1}, Request{2}, Request{3}};
+  PendingList list;
+  for (Request& request : requests) {
+    list.push_back(request);
+  }
+
+  std::vector<int> reversed;
+  for (auto iter = list.rbegin(); iter != list.rend(); ++iter) {
+    reversed.push_back(iter->id);
+  }
+  EXPECT_THAT(reversed, ElementsAre(3, 2, 1));
+  list.clear();
+}
+
+TEST(IntrusiveListTest, CanBeMoved) {
+  std::array requests{Request{1}, Request{2}};
+  PendingList list;
+  list.push_back(requests[0]);
+  list.push_back(requests[1]);
+
+  PendingList moved{std::move(list)};
+  EXPECT_TRUE(list.empty());
+  EXPECT_THAT(ids(moved), ElementsAre(1, 2));
+
+  list = std::move(moved);
+  EXPECT_TRUE(moved.empty());
+  EXPECT_THAT(ids(list), ElementsAre(1, 2));
+  list.pop_front();
+  EXPECT_THAT(ids(list), ElementsAre(2));
+}
+
+TEST(IntrusiveListTest, CopiedObjectsAreNotLinked) {
+  Request request{1};
+  PendingList list;
+  list.push_back(request);
+
+  Request copy = request;
+  EXPECT_FALSE(copy.pending_hook.is_linked());
+  list.clear();
+}
+
+namespace {
+
+struct Base {
+  virtual ~Base() = default;
+  virtual auto id() const -> int = 0;
+};
+
+// Not standard-layout, and not default constructible
+struct Job : Base {
+  explicit Job(int id) : m_id(id) {}
+  auto id() const -> int override { return m_id; }
+
+  int m_id;
+  Ditto::IntrusiveListHook hook;
+};
+
+}  // namespace
+
+TEST(IntrusiveListTest, WorksWithPolymorphicTypes) {
+  std::array jobs{Job{1}, Job{2}, Job{3}};
+  Ditto::IntrusiveList<Job, &Job::hook> list;
+  for (Job& job : jobs) {
+    list.push_front(job);
+  }
+
+  std::vector<int> result;
+  for (const Base& job : list) {
+    result.push_back(job.id());
+  }
+  EXPECT_THAT(result, ElementsAre(3, 2, 1));
+  EXPECT_EQ(&list.back(), &jobs[0]);
+  list.clear();
+}
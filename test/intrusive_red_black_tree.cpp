@@ -0,0 +1,184 @@
+#include "ditto/intrusive_red_black_tree.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <list>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+using testing::ElementsAre;
+
+namespace {
+
+struct Timer {
+  Timer(std::uint64_t deadline, int id) : deadline(deadline), id(id) {}
+
+  std::uint64_t deadline;
+  int id;
+  Ditto::IntrusiveRedBlackTreeHook hook;
+};
+
+struct ByDeadline {
+  auto operator()(const Timer& a, const Timer& b) const -> bool {
+    return a.deadline < b.deadline;
+  }
+};
+
+using TimerQueue =
+    Ditto::IntrusiveRedBlackTree<Timer, &Timer::hook, ByDeadline>;
+
+auto ids(const TimerQueue& queue) -> std::vector<int> {
+  std::vector<int> result;
+  for (const Timer& timer : queue) {
+    result.push_back(timer.id);
+  }
+  return result;
+}
+
+}  // namespace
+
+TEST(IntrusiveRedBlackTreeTest, InsertKeepsOrder) {
+  std::vector<Timer> timers{{30, 0}, {10, 1}, {20, 2}, {40, 3}, {5, 4}};
+  TimerQueue queue;
+  EXPECT_TRUE(queue.empty());
+  for (Timer& timer : timers) {
+    queue.insert(timer);
+    EXPECT_TRUE(timer.hook.is_linked());
+  }
+
+  EXPECT_EQ(queue.size(), 5);
+  EXPECT_THAT(ids(queue), ElementsAre(4, 1, 2, 0, 3));
+  EXPECT_EQ(queue.front().id, 4);
+
+  std::vector<int> reversed;
+  for (auto it = queue.rbegin(); it != queue.rend(); ++it) {
+    reversed.push_back(it->id);
+  }
+  EXPECT_THAT(reversed, ElementsAre(3, 0, 2, 1, 4));
+  queue.clear();
+}
+
+TEST(IntrusiveRedBlackTreeTest, EqualElementsKeepInsertionOrder) {
+  std::vector<Timer> timers{{10, 0}, {10, 1}, {5, 2}, {10, 3}};
+  TimerQueue queue;
+  for (Timer& timer : timers) {
+    queue.insert(timer);
+  }
+  EXPECT_THAT(ids(queue), ElementsAre(2, 0, 1, 3));
+  queue.clear();
+}
+
+TEST(IntrusiveRedBlackTreeTest, TracksTheMinimum) {
+  std::vector<Timer> timers{{30, 0}, {10, 1}, {20, 2}};
+  TimerQueue queue;
+  for (Timer& timer : timers) {
+    queue.insert(timer);
+  }
+
+  EXPECT_EQ(queue.front().id, 1);
+  queue.pop_front();
+  EXPECT_FALSE(timers[1].hook.is_linked());
+  EXPECT_EQ(queue.front().id, 2);
+
+  // Removing another element keeps the minimum
+  queue.remove(timers[0]);
+  EXPECT_EQ(queue.front().id, 2);
+
+  queue.insert(timers[1]);
+  EXPECT_EQ(queue.front().id, 1);
+
+  queue.pop_front();
+  queue.pop_front();
+  EXPECT_TRUE(queue.empty());
+  EXPECT_EQ(queue.begin(), queue.end());
+}
+
+TEST(IntrusiveRedBlackTreeTest, EraseAndBounds) {
+  std::vector<Timer> timers;
+  for (int i = 0; i < 10; i++) {
+    timers.emplace_back(10 * i, i);
+  }
+  TimerQueue queue;
+  for (Timer& timer : timers) {
+    queue.insert(timer);
+  }
+
+  const Timer probe{35, -1};
+  EXPECT_EQ(queue.lower_bound(probe)->id, 4);
+  EXPECT_EQ(queue.upper_bound(Timer{40, -1})->id, 5);
+  EXPECT_EQ(queue.lower_bound(Timer{100, -1}), queue.end());
+
+  auto it = queue.erase(queue.iterator_to(timers[4]));
+  EXPECT_EQ(it->id, 5);
+  EXPECT_FALSE(timers[4].hook.is_linked());
+  EXPECT_THAT(ids(queue), ElementsAre(0, 1, 2, 3, 5, 6, 7, 8, 9));
+
+  // Decrementing end() goes to the last element
+  EXPECT_EQ((--queue.end())->id, 9);
+  queue.clear();
+  for (const Timer& timer : timers) {
+    EXPECT_FALSE(timer.hook.is_linked());
+  }
+}
+
+TEST(IntrusiveRedBlackTreeTest, MatchesMultiset) {
+  // Timers must not move while linked, std::list keeps them in place
+  std::list<Timer> timers;
+  std::multiset<std::uint64_t> expected;
+  TimerQueue queue;
+  std::mt19937 generator{13};
+  std::uniform_int_distribution<std::uint64_t> deadlines{0, 500};
+
+  for (int i = 0; i < 5000; i++) {
+    if (((i % 3) != 2) || timers.empty()) {
+      Timer& timer = timers.emplace_back(deadlines(generator), i);
+      queue.insert(timer);
+      expected.insert(timer.deadline);
+    } else if ((i % 2) == 0) {
+      const std::uint64_t deadline = queue.front().deadline;
+      Timer* first = &queue.front();
+      queue.pop_front();
+      expected.erase(expected.find(deadline));
+      timers.remove_if([first](const Timer& timer) { return &timer == first; });
+    } else {
+      Timer& timer = timers.front();
+      queue.remove(timer);
+      expected.erase(expected.find(timer.deadline));
+      timers.pop_front();
+    }
+
+    ASSERT_EQ(queue.size(), expected.size());
+    if (!expected.empty()) {
+      ASSERT_EQ(queue.front().deadline, *expected.begin());
+    }
+  }
+
+  std::vector<std::uint64_t> deadlines_in_queue;
+  for (const Timer& timer : queue) {
+    deadlines_in_queue.push_back(timer.deadline);
+  }
+  EXPECT_EQ(deadlines_in_queue,
+            std::vector<std::uint64_t>(expected.begin(), expected.end()));
+  queue.clear();
+}
+
+TEST(IntrusiveRedBlackTreeTest, Move) {
+  std::vector<Timer> timers{{2, 0}, {1, 1}, {3, 2}};
+  TimerQueue queue;
+  for (Timer& timer : timers) {
+    queue.insert(timer);
+  }
+
+  TimerQueue moved{std::move(queue)};
+  EXPECT_TRUE(queue.empty());
+  EXPECT_THAT(ids(moved), ElementsAre(1, 0, 2));
+  EXPECT_EQ(moved.front().id, 1);
+
+  queue = std::move(moved);
+  EXPECT_THAT(ids(queue), ElementsAre(1, 0, 2));
+  queue.clear();
+}
@@ -5,8 +5,15 @@
 #include <gtest/gtest.h>
 
 #include <array>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include "ditto/pool_allocator.h"
+
 using Ditto::LinkedList;
 using testing::ElementsAreArray;
 
@@ -177,3 +184,223 @@ TEST(LinkedList, Back) {
   EXPECT_EQ(2, *list.back_iter());
   EXPECT_EQ(2, list.back());
 }
+
+TEST(LinkedList, PopLastElementFromFront) {
+  LinkedList<int> list;
+  list.push_back(1);
+  list.pop_front();
+
+  EXPECT_EQ(list.rbegin(), list.rend());
+  list.push_back(2);
+  ASSERT_THAT(list, ElementsAreArray(std::array{2}));
+  EXPECT_EQ(list.back(), 2);
+}
+
+namespace {
+
+struct AllocationCounters {
+  std::size_t allocations = 0;
+  std::size_t deallocations = 0;
+};
+
+template <class T>
+class CountingAllocator {
+ public:
+  using value_type = T;
+
+  explicit CountingAllocator(AllocationCounters* counters)
+      : m_counters(counters) {}
+
+  template <class U>
+  explicit CountingAllocator(const CountingAllocator<U>& other)
+      : m_counters(other.m_counters) {}
+
+  auto allocate(std::size_t n) -> T* {
+    m_counters->allocations += n;
+    return std::allocator<T>{}.allocate(n);
+  }
+
+  void deallocate(T* ptr, std::size_t n) {
+    m_counters->deallocations += n;
+    std::allocator<T>{}.deallocate(ptr, n);
+  }
+
+  template <class U>
+  auto operator==(const CountingAllocator<U>& other) const -> bool {
+    return m_counters == other.m_counters;
+  }
+
+ private:
+  AllocationCounters* m_counters;
+
+  template <class U>
+  friend class CountingAllocator;
+};
+
+}  // namespace
+
+TEST(LinkedList, AllocatesNodesFromAllocator) {
+  AllocationCounters counters;
+  {
+    LinkedList<std::string, CountingAllocator<std::string>> list{
+        CountingAllocator<std::string>{&counters}};
+    list.push_back("first");
+    list.emplace_front("second");
+    list.insert(++list.cbegin(), "third");
+    EXPECT_EQ(counters.allocations, 3);
+
+    list.pop_back();
+    EXPECT_EQ(counters.deallocations, 1);
+    ASSERT_THAT(list, ElementsAreArray({"second", "third"}));
+  }
+  EXPECT_EQ(counters.deallocations, 3);
+}
+
+TEST(LinkedList, UsesFixedPoolAllocator) {
+  struct PoolTag {};
+  using Allocator = Ditto::FixedPoolAllocator<int, 4, PoolTag>;
+  using NodePool =
+      Ditto::FixedPoolAllocator<LinkedList<int, Allocator>::Node, 4, PoolTag>;
+
+  {
+    LinkedList<int, Allocator> list;
+    for (int i = 0; i < 4; i++) {
+      list.push_back(i);
+    }
+    EXPECT_EQ(NodePool::available(), 0);
+
+    list.erase(++list.cbegin());
+    EXPECT_EQ(NodePool::available(), 1);
+    list.push_front(4);
+    ASSERT_THAT(list, ElementsAreArray({4, 0, 2, 3}));
+
+    // Lists sharing a pool can be moved around freely
+    LinkedList<int, Allocator> moved{std::move(list)};
+    EXPECT_TRUE(list.empty());
+    ASSERT_THAT(moved, ElementsAreArray({4, 0, 2, 3}));
+  }
+  EXPECT_EQ(NodePool::available(), 4);
+}
+
+TEST(LinkedList, DestroysLongListsWithoutRecursion) {
+  constexpr int NUM_ELEMENTS = 1000000;
+  LinkedList<int> list;
+  for (int i = 0; i < NUM_ELEMENTS; i++) {
+    list.push_back(i);
+  }
+  EXPECT_EQ(list.size(), NUM_ELEMENTS);
+  list.clear();
+  EXPECT_TRUE(list.empty());
+
+  for (int i = 0; i < NUM_ELEMENTS; i++) {
+    list.push_front(i);
+  }
+}
+
+TEST(LinkedList, SplicesWholeList) {
+  LinkedList<int> list;
+  list.push_back(1);
+  list.push_back(4);
+  LinkedList<int> other;
+  other.push_back(2);
+  other.push_back(3);
+
+  list.splice(++list.cbegin(), other);
+  EXPECT_TRUE(other.empty());
+  EXPECT_EQ(list.size(), 4);
+  ASSERT_THAT(list, ElementsAreArray({1, 2, 3, 4}));
+
+  other.splice(other.cend(), list);
+  EXPECT_TRUE(list.empty());
+  ASSERT_THAT(other, ElementsAreArray({1, 2, 3, 4}));
+  EXPECT_EQ(other.back(), 4);
+}
+
+TEST(LinkedList, SplicesSingleElements) {
+  LinkedList<int> list;
+  list.push_back(1);
+  list.push_back(2);
+  list.push_back(3);
+  LinkedList<int> other;
+  other.push_back(4);
+
+  list.splice(list.cbegin(), other, other.cbegin());
+  EXPECT_TRUE(other.empty());
+  ASSERT_THAT(list, ElementsAreArray({4, 1, 2, 3}));
+
+  // Within the same list
+  list.splice(list.cend(), list, list.cbegin());
+  ASSERT_THAT(list, ElementsAreArray({1, 2, 3, 4}));
+  list.splice(list.cbegin(), list, list.cbegin());
+  ASSERT_THAT(list, ElementsAreArray({1, 2, 3, 4}));
+  EXPECT_EQ(list.size(), 4);
+
+  ASSERT_THAT(std::vector<int>(list.crbegin(), list.crend()),
+              ElementsAreArray({4, 3, 2, 1}));
+}
+
+TEST(LinkedList, SplicesRanges) {
+  LinkedList<int> list;
+  LinkedList<int> other;
+  for (int i = 0; i < 5; i++) {
+    list.push_back(i);
+    other.push_back(10 + i);
+  }
+
+  auto first = ++other.cbegin();
+  auto last = first;
+  std::advance(last, 3);
+  list.splice(++list.cbegin(), other, first, last);
+  EXPECT_EQ(list.size(), 8);
+  EXPECT_EQ(other.size(), 2);
+  ASSERT_THAT(list, ElementsAreArray({0, 11, 12, 13, 1, 2, 3, 4}));
+  ASSERT_THAT(other, ElementsAreArray({10, 14}));
+
+  // Move the tail of the list to its front
+  first = list.cbegin();
+  std::advance(first, 5);
+  list.splice(list.cbegin(), list, first, list.cend());
+  EXPECT_EQ(list.size(), 8);
+  ASSERT_THAT(list, ElementsAreArray({2, 3, 4, 0, 11, 12, 13, 1}));
+  EXPECT_EQ(list.back(), 1);
+}
+
+TEST(LinkedList, MergesSortedLists) {
+  LinkedList<int> list;
+  for (int value : {1, 3, 3, 8}) {
+    list.push_back(value);
+  }
+  LinkedList<int> other;
+  for (int value : {0, 2, 3, 4, 5, 9, 10}) {
+    other.push_back(value);
+  }
+
+  list.merge(other);
+  EXPECT_TRUE(other.empty());
+  EXPECT_EQ(list.size(), 11);
+  ASSERT_THAT(list, ElementsAreArray({0, 1, 2, 3, 3, 3, 4, 5, 8, 9, 10}));
+  EXPECT_EQ(list.back(), 10);
+}
+
+TEST(LinkedList, MergeIsStableAndDoesNotAllocate) {
+  AllocationCounters counters;
+  using Entry = std::pair<int, char>;
+  CountingAllocator<Entry> allocator{&counters};
+  LinkedList<Entry, CountingAllocator<Entry>> list{allocator};
+  LinkedList<Entry, CountingAllocator<Entry>> other{allocator};
+  list.push_back({2, 'a'});
+  list.push_back({1, 'a'});
+  other.push_back({3, 'b'});
+  other.push_back({2, 'b'});
+  other.push_back({1, 'b'});
+
+  const std::size_t allocations = counters.allocations;
+  list.merge(other, [](const Entry& lhs, const Entry& rhs) {
+    return lhs.first > rhs.first;
+  });
+  EXPECT_EQ(counters.allocations, allocations);
+  EXPECT_EQ(counters.deallocations, 0);
+  ASSERT_THAT(list, ElementsAreArray({Entry{3, 'b'}, Entry{2, 'a'},
+                                      Entry{2, 'b'}, Entry{1, 'a'},
+                                      Entry{1, 'b'}}));
+}
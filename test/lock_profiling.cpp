@@ -0,0 +1,206 @@
+#include "ditto/lock_profiling.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "ditto/resource_lock.h"
+#include "ditto/shared_mutex.h"
+
+using Ditto::LockProfile;
+using Ditto::ProfiledMutex;
+
+namespace {
+
+// Return the address they return to, which is in the calling test
+template <class Resource>
+[[gnu::noinline]] auto write_from_here(Resource& resource) -> const void* {
+  resource.lock([](int& value) { value++; });
+  return __builtin_return_address(0);
+}
+
+template <class Mutex>
+[[gnu::noinline]] auto lock_from_here(Mutex& mutex) -> const void* {
+  mutex.lock();
+  mutex.unlock();
+  return __builtin_return_address(0);
+}
+
+auto only_profile() -> const LockProfile& {
+  const LockProfile* only = nullptr;
+  LockProfile::for_each([&](const LockProfile& profile) {
+    EXPECT_EQ(only, nullptr);
+    only = &profile;
+  });
+  return *only;
+}
+
+}  // namespace
+
+TEST(LockProfilingTest, ProfiledLockIsCompiledOutByDefault) {
+#if defined(DITTO_LOCK_PROFILING)
+  EXPECT_TRUE((std::is_same_v<Ditto::ProfiledLock<std::mutex>,
+                              ProfiledMutex<std::mutex>>));
+#else
+  EXPECT_TRUE((std::is_same_v<Ditto::ProfiledLock<std::mutex>, std::mutex>));
+#endif
+}
+
+TEST(LockProfilingTest, CountsAcquisitionsAndHoldTimes) {
+  ProfiledMutex<std::mutex> mutex;
+
+  for (int i = 0; i < 10; i++) {
+    mutex.lock();
+    mutex.unlock();
+  }
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+
+  const LockProfile& profile = mutex.profile();
+  EXPECT_EQ(profile.acquisitions(), 11);
+  EXPECT_EQ(profile.contended_acquisitions(), 0);
+  EXPECT_EQ(profile.total_wait_time().count(), 0);
+  EXPECT_EQ(profile.hold_times().count(), 11);
+  EXPECT_EQ(profile.longest_hold().count(), profile.hold_times().max());
+  EXPECT_NE(profile.longest_hold_callers()[0], nullptr);
+}
+
+TEST(LockProfilingTest, LongestHoldCallersStartAtTheHolder) {
+  {
+    ProfiledMutex<std::mutex> mutex;
+    const void* caller = lock_from_here(mutex);
+    // The first frame is lock_from_here() itself
+    EXPECT_EQ(mutex.profile().longest_hold_callers()[1], caller);
+  }
+  {
+    Ditto::ResourceLock<int, ProfiledMutex<std::mutex>> resource{0};
+    const void* caller = write_from_here(resource);
+    // The frames of the lock guard and the mutex are left out, and so is
+    // ResourceLock::lock() when it is inlined in write_from_here()
+    const auto callers = only_profile().longest_hold_callers();
+    EXPECT_TRUE((callers[0] == caller) || (callers[1] == caller));
+  }
+}
+
+TEST(LockProfilingTest, ForwardsTimedLocking) {
+  using namespace std::chrono_literals;
+  Ditto::ResourceLock<int, ProfiledMutex<std::timed_mutex>> resource{1};
+  auto result = resource.try_lock_for(1ms, [](int& value) { return value; });
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(*result, 1);
+  EXPECT_EQ(only_profile().acquisitions(), 1);
+}
+
+TEST(LockProfilingTest, ProfilesTimedAcquisitions) {
+  using namespace std::chrono_literals;
+  ProfiledMutex<std::shared_timed_mutex> mutex;
+
+  EXPECT_TRUE(mutex.try_lock_for(1ms));
+  std::thread other{[&] {
+    EXPECT_FALSE(
+        mutex.try_lock_until(std::chrono::steady_clock::now() + 1ms));
+    EXPECT_FALSE(mutex.try_lock_shared_for(1ms));
+  }};
+  other.join();
+  mutex.unlock();
+
+  EXPECT_TRUE(
+      mutex.try_lock_shared_until(std::chrono::steady_clock::now() + 1ms));
+  mutex.unlock_shared();
+
+  // Failed attempts are not acquisitions
+  const LockProfile& profile = mutex.profile();
+  EXPECT_EQ(profile.acquisitions(), 2);
+  EXPECT_EQ(profile.contended_acquisitions(), 0);
+  EXPECT_EQ(profile.hold_times().count(), 1);
+
+  Ditto::ReadWriteLock<int, ProfiledMutex<std::shared_timed_mutex>> shared{2};
+  EXPECT_TRUE(shared.try_write_lock_for(1ms, [](int& value) { value = 3; }));
+  auto result =
+      shared.try_read_lock_for(1ms, [](const int& value) { return value; });
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(*result, 3);
+}
+
+TEST(LockProfilingTest, RecordsContendedAcquisitions) {
+  using namespace std::chrono_literals;
+  ProfiledMutex<std::mutex> mutex;
+  std::atomic_bool waiting{false};
+
+  mutex.lock();
+  std::thread waiter{[&] {
+    waiting = true;
+    mutex.lock();
+    mutex.unlock();
+  }};
+  while (!waiting) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(1ms);
+  mutex.unlock();
+  waiter.join();
+
+  const LockProfile& profile = mutex.profile();
+  EXPECT_EQ(profile.acquisitions(), 2);
+  EXPECT_EQ(profile.contended_acquisitions(), 1);
+  EXPECT_GT(profile.total_wait_time().count(), 0);
+  EXPECT_GE(profile.longest_hold(), 1ms);
+}
+
+TEST(LockProfilingTest, ProfilesSharedAcquisitions) {
+  Ditto::ReadWriteLock<int, ProfiledMutex<Ditto::SharedMutex>> resource{123};
+
+  resource.write_lock([](int& value) { value = 3; });
+  resource.read_lock([&](const int&) {
+    resource.read_lock([](const int& value) { EXPECT_EQ(value, 3); });
+  });
+
+  std::size_t num_profiles = 0;
+  LockProfile::for_each([&](const LockProfile& profile) {
+    num_profiles++;
+    EXPECT_EQ(profile.acquisitions(), 3);
+    // Only exclusive holds are timed
+    EXPECT_EQ(profile.hold_times().count(), 1);
+  });
+  EXPECT_EQ(num_profiles, 1);
+}
+
+TEST(LockProfilingTest, RegistryTracksLiveLocks) {
+  auto count_profiles = [] {
+    std::size_t count = 0;
+    LockProfile::for_each([&](const LockProfile&) { count++; });
+    return count;
+  };
+
+  EXPECT_EQ(count_profiles(), 0);
+  {
+    ProfiledMutex<std::mutex> first;
+    {
+      ProfiledMutex<std::mutex> second;
+      ProfiledMutex<std::mutex> third;
+      EXPECT_EQ(count_profiles(), 3);
+    }
+    EXPECT_EQ(count_profiles(), 1);
+  }
+  EXPECT_EQ(count_profiles(), 0);
+}
+
+TEST(LockProfilingTest, DumpsAcquiredLocks) {
+  ProfiledMutex<std::mutex> used;
+  ProfiledMutex<std::mutex> unused;
+  used.lock();
+  used.unlock();
+
+  testing::internal::CaptureStdout();
+  LockProfile::dump();
+  const std::string output = testing::internal::GetCapturedStdout();
+
+  EXPECT_NE(output.find("1 acquisitions, 0 contended"), std::string::npos);
+  EXPECT_EQ(output.find("0 acquisitions"), std::string::npos);
+}
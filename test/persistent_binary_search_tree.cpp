@@ -0,0 +1,158 @@
+#include "ditto/persistent_binary_search_tree.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using testing::ElementsAre;
+
+namespace {
+
+template <class Tree>
+auto keys_of(const Tree& tree) -> std::vector<int> {
+  std::vector<int> keys;
+  tree.for_each([&](const int& key, const int& /*unused*/) {
+    keys.push_back(key);
+  });
+  return keys;
+}
+
+}  // namespace
+
+TEST(PersistentBinarySearchTreeTest, Empty) {
+  Ditto::PersistentBinarySearchTree<int, int> tree;
+  EXPECT_TRUE(tree.empty());
+  EXPECT_EQ(tree.depth(), 0);
+  EXPECT_FALSE(tree.lookup(1).has_value());
+  EXPECT_TRUE(tree.erase(1).empty());
+}
+
+TEST(PersistentBinarySearchTreeTest, InsertReturnsNewVersion) {
+  Ditto::PersistentBinarySearchTree<int, int> empty;
+  const auto one = empty.insert(1, 10);
+  const auto two = one.insert(2, 20);
+  const auto replaced = two.insert(1, 11);
+
+  EXPECT_TRUE(empty.empty());
+  EXPECT_THAT(keys_of(one), ElementsAre(1));
+  EXPECT_THAT(keys_of(two), ElementsAre(1, 2));
+  EXPECT_EQ(replaced.size(), 2);
+
+  EXPECT_EQ(*one.lookup(1).value(), 10);
+  EXPECT_EQ(*two.lookup(1).value(), 10);
+  EXPECT_EQ(*replaced.lookup(1).value(), 11);
+  EXPECT_FALSE(one.lookup(2).has_value());
+}
+
+TEST(PersistentBinarySearchTreeTest, EraseReturnsNewVersion) {
+  Ditto::PersistentBinarySearchTree<int, int> tree;
+  for (int key = 0; key < 10; key++) {
+    tree = tree.insert(key, key);
+  }
+
+  const auto erased = tree.erase(4);
+  EXPECT_EQ(tree.size(), 10);
+  EXPECT_TRUE(tree.lookup(4).has_value());
+  EXPECT_EQ(erased.size(), 9);
+  EXPECT_FALSE(erased.lookup(4).has_value());
+  EXPECT_THAT(keys_of(erased), ElementsAre(0, 1, 2, 3, 5, 6, 7, 8, 9));
+
+  // Erasing a missing key shares the whole tree
+  const auto same = erased.erase(4);
+  EXPECT_EQ(same.lookup(5).value().get(), erased.lookup(5).value().get());
+}
+
+TEST(PersistentBinarySearchTreeTest, SharesUnchangedNodes) {
+  Ditto::PersistentBinarySearchTree<int, int> tree;
+  for (int key = 0; key < 1000; key++) {
+    tree = tree.insert(key, key);
+  }
+
+  const auto modified = tree.insert(1000, 1000);
+  std::size_t shared = 0;
+  for (int key = 0; key < 1000; key++) {
+    if (tree.lookup(key).value().get() == modified.lookup(key).value().get()) {
+      shared++;
+    }
+  }
+  // Only the path to the new key is copied
+  EXPECT_GE(shared, 1000 - 2 * tree.depth());
+}
+
+TEST(PersistentBinarySearchTreeTest, StaysBalanced) {
+  Ditto::PersistentBinarySearchTree<int, int> tree;
+  std::map<int, int> expected;
+  std::mt19937 generator{5};
+  std::uniform_int_distribution<int> distribution{0, 1000};
+
+  for (int i = 0; i < 5000; i++) {
+    const int key = (i < 1000) ? i : distribution(generator);
+    if ((i < 1000) || ((i % 2) == 0)) {
+      tree = tree.insert(key, i);
+      expected[key] = i;
+    } else {
+      tree = tree.erase(key);
+      expected.erase(key);
+    }
+    const double size = static_cast<double>(expected.size());
+    ASSERT_LE(tree.depth(), 1.44 * std::log2(size + 2.0));
+  }
+
+  ASSERT_EQ(tree.size(), expected.size());
+  auto it = expected.begin();
+  tree.for_each([&](const int& key, const int& value) {
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(value, it->second);
+    ++it;
+  });
+}
+
+TEST(PersistentBinarySearchTreeTest, SnapshotsCanBeReadConcurrently) {
+  Ditto::PersistentBinarySearchTree<int, int> tree;
+  for (int key = 0; key < 1000; key++) {
+    tree = tree.insert(key, key);
+  }
+
+  // Readers use a snapshot while the writer keeps deriving new versions
+  const auto snapshot = tree;
+  std::vector<std::thread> readers;
+  for (int i = 0; i < 4; i++) {
+    readers.emplace_back([&snapshot] {
+      for (int round = 0; round < 10; round++) {
+        for (int key = 0; key < 1000; key++) {
+          auto value = snapshot.lookup(key);
+          ASSERT_TRUE(value.has_value());
+          EXPECT_EQ(*value.value(), key);
+        }
+      }
+    });
+  }
+  for (int key = 0; key < 1000; key++) {
+    tree = tree.insert(key + 1000, key).erase(key);
+  }
+  for (auto& reader : readers) {
+    reader.join();
+  }
+
+  EXPECT_EQ(snapshot.size(), 1000);
+  EXPECT_EQ(tree.size(), 1000);
+  EXPECT_FALSE(tree.lookup(0).has_value());
+}
+
+TEST(PersistentBinarySearchTreeTest, ReleasesNodesOfDroppedVersions) {
+  auto counter = std::make_shared<int>(0);
+  {
+    Ditto::PersistentBinarySearchTree<int, std::shared_ptr<int>> tree;
+    for (int key = 0; key < 100; key++) {
+      tree = tree.insert(key, counter);
+    }
+    EXPECT_EQ(counter.use_count(), 101);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
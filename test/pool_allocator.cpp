@@ -0,0 +1,155 @@
+#include "ditto/pool_allocator.h"
+
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "ditto/binary_search_tree.h"
+#include "ditto/pair.h"
+#include "ditto/red_black_tree.h"
+
+namespace {
+
+struct alignas(16) Aligned {
+  std::uint8_t data[24];
+};
+
+}  // namespace
+
+TEST(FixedPoolAllocatorTest, AllocatesAllSlotsAndReusesFreedOnes) {
+  struct Tag {};
+  using Allocator = Ditto::FixedPoolAllocator<Aligned, 3, Tag>;
+  Allocator allocator;
+  EXPECT_EQ(Allocator::available(), 3);
+
+  std::set<Aligned*> slots;
+  for (int i = 0; i < 3; i++) {
+    Aligned* slot = allocator.allocate(1);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(slot) % alignof(Aligned), 0);
+    slots.insert(slot);
+  }
+  EXPECT_EQ(slots.size(), 3);
+  EXPECT_EQ(Allocator::available(), 0);
+
+  Aligned* freed = *slots.begin();
+  allocator.deallocate(freed, 1);
+  EXPECT_EQ(Allocator::available(), 1);
+  EXPECT_EQ(allocator.allocate(1), freed);
+
+  for (Aligned* slot : slots) {
+    allocator.deallocate(slot, 1);
+  }
+  EXPECT_EQ(Allocator::available(), 3);
+}
+
+TEST(FixedPoolAllocatorTest, ReboundAllocatorsHaveTheirOwnPools) {
+  struct Tag {};
+  using IntAllocator = Ditto::FixedPoolAllocator<int, 2, Tag>;
+  using DoubleAllocator =
+      std::allocator_traits<IntAllocator>::rebind_alloc<double>;
+
+  IntAllocator int_allocator;
+  DoubleAllocator double_allocator{int_allocator};
+  EXPECT_TRUE(int_allocator == double_allocator);
+
+  int* value = int_allocator.allocate(1);
+  EXPECT_EQ(IntAllocator::available(), 1);
+  EXPECT_EQ(DoubleAllocator::available(), 2);
+  int_allocator.deallocate(value, 1);
+}
+
+TEST(SlabAllocatorTest, AllocatesContiguousSlots) {
+  Ditto::SlabAllocator<Aligned, 4> allocator;
+
+  Aligned* first = allocator.allocate(1);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(first) % alignof(Aligned), 0);
+  for (int i = 1; i < 4; i++) {
+    EXPECT_EQ(allocator.allocate(1), first + i);
+  }
+
+  // The next slab is somewhere else, but still aligned
+  Aligned* next_slab = allocator.allocate(1);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(next_slab) % alignof(Aligned),
+            0);
+
+  // Freed slots are reused first
+  allocator.deallocate(first + 2, 1);
+  EXPECT_EQ(allocator.allocate(1), first + 2);
+}
+
+TEST(SlabAllocatorTest, DeallocatesAllOnlyWhenNotShared) {
+  Ditto::SlabAllocator<int, 8> allocator;
+  int* first = allocator.allocate(1);
+  EXPECT_NE(allocator.allocate(1), first);
+
+  {
+    Ditto::SlabAllocator<double, 8> rebound{allocator};
+    EXPECT_TRUE(rebound == allocator);
+    EXPECT_FALSE(allocator.deallocate_all());
+  }
+
+  // The slabs are kept and refilled from the start
+  EXPECT_TRUE(allocator.deallocate_all());
+  EXPECT_EQ(allocator.allocate(1), first);
+}
+
+TEST(SlabAllocatorTest, MovedFromAllocatorsKeepTheirArena) {
+  Ditto::SlabAllocator<int> allocator;
+  Ditto::SlabAllocator<int> moved{std::move(allocator)};
+  EXPECT_TRUE(moved == allocator);
+
+  int* value = allocator.allocate(1);
+  moved.deallocate(value, 1);
+  EXPECT_FALSE(Ditto::SlabAllocator<int>{} == allocator);
+}
+
+TEST(SlabAllocatorTest, ReboundAllocatorsGetSlotsOfTheirSize) {
+  Ditto::SlabAllocator<std::uint8_t, 4> small;
+  Ditto::SlabAllocator<Aligned, 4> large{small};
+  EXPECT_TRUE(small == large);
+
+  std::uint8_t* first_small = small.allocate(1);
+  Aligned* first_large = large.allocate(1);
+  EXPECT_EQ(reinterpret_cast<std::uintptr_t>(first_large) % alignof(Aligned),
+            0);
+  for (int i = 1; i < 4; i++) {
+    // Each size keeps carving its own slabs
+    std::uint8_t* next_small = small.allocate(1);
+    EXPECT_EQ(next_small - first_small, i * sizeof(void*));
+    EXPECT_EQ(large.allocate(1), first_large + i);
+  }
+
+  // Allocators of types with the same slot layout share the slabs
+  Ditto::SlabAllocator<std::uint16_t, 4> same_size{small};
+  small.deallocate(first_small, 1);
+  EXPECT_EQ(static_cast<void*>(same_size.allocate(1)), first_small);
+}
+
+TEST(SlabAllocatorTest, AllocatesArraysFromTheHeap) {
+  Ditto::SlabAllocator<int, 4> allocator;
+  int* array = allocator.allocate(100);
+  array[99] = 1;
+  int* single = allocator.allocate(1);
+  EXPECT_NE(single, nullptr);
+  allocator.deallocate(array, 100);
+  allocator.deallocate(single, 1);
+}
+
+TEST(SlabAllocatorTest, CanBeSharedByContainersWithDifferentNodes) {
+  Ditto::SlabAllocator<Ditto::Pair<int, int>> allocator;
+  Ditto::BinarySearchTree<int, int, decltype(allocator)> bst{allocator};
+  Ditto::RedBlackTree<int, int, decltype(allocator)> rbt{allocator};
+
+  for (int key = 0; key < 1000; key++) {
+    bst.insert(key, -key);
+    rbt.insert(key, key);
+  }
+  for (int key = 0; key < 1000; key++) {
+    EXPECT_EQ(*bst.lookup(key).value(), -key);
+    EXPECT_EQ(*rbt.lookup(key).value(), key);
+  }
+}
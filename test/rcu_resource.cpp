@@ -0,0 +1,155 @@
+#include "ditto/rcu_resource.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+class CountedValue {
+ public:
+  CountedValue(std::atomic<int>* destroyed, int value)
+      : m_destroyed(destroyed), m_value(value) {}
+  CountedValue(const CountedValue&) = default;
+  ~CountedValue() { m_destroyed->fetch_add(1); }
+
+  [[nodiscard]] auto value() const -> int { return m_value; }
+  void set_value(int value) { m_value = value; }
+
+ private:
+  std::atomic<int>* m_destroyed;
+  int m_value;
+};
+
+}  // namespace
+
+TEST(RcuResourceTest, CanReadAndUpdateResource) {
+  Ditto::RcuResource<int> resource{123};
+
+  resource.read_lock([](const int& value) { EXPECT_EQ(value, 123); });
+
+  resource.update([](int& value) {
+    EXPECT_EQ(value, 123);
+    value = 3;
+  });
+
+  resource.read_lock([](const int& value) { EXPECT_EQ(value, 3); });
+}
+
+TEST(RcuResourceTest, CanReturnValuesFromClosures) {
+  Ditto::RcuResource<std::vector<int>> resource{3, 1};
+
+  auto previous_size = resource.update([](std::vector<int>& values) {
+    const std::size_t size = values.size();
+    values.push_back(2);
+    return size;
+  });
+  EXPECT_EQ(previous_size, 3);
+
+  auto sum = resource.read_lock([](const std::vector<int>& values) {
+    int sum = 0;
+    for (int value : values) {
+      sum += value;
+    }
+    return sum;
+  });
+  EXPECT_EQ(sum, 5);
+}
+
+TEST(RcuResourceTest, ReclaimsOldVersionsAfterUpdate) {
+  std::atomic<int> destroyed{0};
+  {
+    Ditto::RcuResource<CountedValue> resource{&destroyed, 1};
+
+    resource.update([](CountedValue& value) { value.set_value(2); });
+    EXPECT_EQ(destroyed.load(), 1);
+
+    resource.update([](CountedValue& value) { value.set_value(3); });
+    EXPECT_EQ(destroyed.load(), 2);
+
+    resource.read_lock(
+        [](const CountedValue& value) { EXPECT_EQ(value.value(), 3); });
+  }
+  EXPECT_EQ(destroyed.load(), 3);
+}
+
+TEST(RcuResourceTest, UpdateWaitsForReadersOfThePreviousVersion) {
+  std::atomic<int> destroyed{0};
+  Ditto::RcuResource<CountedValue> resource{&destroyed, 1};
+  std::atomic_bool reading{false};
+  std::atomic_bool release_reader{false};
+  std::atomic_bool updated{false};
+
+  std::thread reader{[&] {
+    resource.read_lock([&](const CountedValue& value) {
+      reading = true;
+      while (!release_reader) {
+        std::this_thread::yield();
+      }
+      // The snapshot is still alive while the reader is using it
+      EXPECT_EQ(value.value(), 1);
+      EXPECT_EQ(destroyed.load(), 0);
+    });
+  }};
+
+  while (!reading) {
+    std::this_thread::yield();
+  }
+
+  std::thread writer{[&] {
+    resource.update([](CountedValue& value) { value.set_value(2); });
+    updated = true;
+  }};
+
+  // New readers see the new version without waiting for the writer
+  while (resource.read_lock(
+             [](const CountedValue& value) { return value.value(); }) != 2) {
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(updated.load());
+
+  release_reader = true;
+  reader.join();
+  writer.join();
+  EXPECT_TRUE(updated.load());
+  EXPECT_EQ(destroyed.load(), 1);
+}
+
+TEST(RcuResourceTest, ReadersAlwaysSeeConsistentSnapshots) {
+  constexpr int NUM_READERS = 3;
+  constexpr int NUM_UPDATES = 200;
+  Ditto::RcuResource<std::vector<int>> resource{16, 0};
+  std::atomic_bool done{false};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < NUM_READERS; i++) {
+    readers.emplace_back([&] {
+      while (!done) {
+        resource.read_lock([](const std::vector<int>& values) {
+          for (int value : values) {
+            EXPECT_EQ(value, values.front());
+          }
+        });
+      }
+    });
+  }
+
+  for (int i = 1; i <= NUM_UPDATES; i++) {
+    resource.update([i](std::vector<int>& values) {
+      for (int& value : values) {
+        value = i;
+      }
+    });
+  }
+  done = true;
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  resource.read_lock([&](const std::vector<int>& values) {
+    EXPECT_EQ(values.front(), NUM_UPDATES);
+  });
+}
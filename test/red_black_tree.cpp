@@ -1,8 +1,23 @@
 #include "ditto/red_black_tree.h"
 
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cmath>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "ditto/pool_allocator.h"
+
+using testing::ElementsAre;
 
 TEST(RedBlackTreeTest, Constructor) { Ditto::RedBlackTree<int, int> tree; }
 
@@ -66,3 +81,423 @@ TEST(RedBlackTreeTest, DepthTest) {
   auto result = tree.lookup(1000);
   ASSERT_FALSE(result.has_value());
 }
+
+namespace {
+
+auto keys_of(const Ditto::RedBlackTree<int, int>& tree) -> std::vector<int> {
+  std::vector<int> keys;
+  for (auto [key, value] : tree) {
+    keys.push_back(key);
+  }
+  return keys;
+}
+
+}  // namespace
+
+TEST(RedBlackTreeTest, IteratesInOrder) {
+  Ditto::RedBlackTree<int, int> tree;
+  EXPECT_EQ(tree.begin(), tree.end());
+
+  for (int key : {5, 1, 9, 3, 7, 2, 8}) {
+    tree.insert(key, key * 10);
+  }
+  EXPECT_THAT(keys_of(tree), ElementsAre(1, 2, 3, 5, 7, 8, 9));
+
+  for (auto [key, value] : tree) {
+    value += key;
+  }
+  EXPECT_EQ(*tree.lookup(3).value(), 33);
+
+  // Iterate backwards from end()
+  std::vector<int> reversed;
+  auto iter = tree.end();
+  while (iter != tree.begin()) {
+    --iter;
+    reversed.push_back((*iter).key);
+  }
+  EXPECT_THAT(reversed, ElementsAre(9, 8, 7, 5, 3, 2, 1));
+}
+
+TEST(RedBlackTreeTest, Bounds) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 100; key += 10) {
+    tree.insert(key, key);
+  }
+
+  EXPECT_EQ((*tree.lower_bound(20)).key, 20);
+  EXPECT_EQ((*tree.upper_bound(20)).key, 30);
+  EXPECT_EQ((*tree.lower_bound(21)).key, 30);
+  EXPECT_EQ((*tree.upper_bound(21)).key, 30);
+  EXPECT_EQ((*tree.lower_bound(-5)).key, 0);
+  EXPECT_EQ(tree.lower_bound(91), tree.end());
+  EXPECT_EQ(tree.upper_bound(90), tree.end());
+
+  const auto& const_tree = tree;
+  EXPECT_EQ((*const_tree.lower_bound(45)).value, 50);
+}
+
+TEST(RedBlackTreeTest, ForEachInRange) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 100; key++) {
+    tree.insert(key, key);
+  }
+
+  std::vector<int> keys;
+  tree.for_each_in_range(10, 15, [&](const int& /*unused*/, int& value) {
+    keys.push_back(value);
+  });
+  EXPECT_THAT(keys, ElementsAre(10, 11, 12, 13, 14));
+
+  keys.clear();
+  const auto& const_tree = tree;
+  const_tree.for_each_in_range(
+      95, 200,
+      [&](const int& key, const int& /*unused*/) { keys.push_back(key); });
+  EXPECT_THAT(keys, ElementsAre(95, 96, 97, 98, 99));
+
+  keys.clear();
+  tree.for_each_in_range(
+      50, 50, [&](const int& key, int& /*unused*/) { keys.push_back(key); });
+  EXPECT_TRUE(keys.empty());
+}
+
+TEST(RedBlackTreeTest, ZigZagInsertionsKeepInvariants) {
+  // Each triple needs a double rotation at the grandparent
+  for (const auto& keys : {std::array{30, 10, 20}, std::array{10, 30, 20}}) {
+    Ditto::RedBlackTree<int, int> tree;
+    for (int key : keys) {
+      tree.insert(key, key);
+      EXPECT_TRUE(tree.satisfies_invariants());
+    }
+    EXPECT_EQ(tree.depth(), 2);
+  }
+}
+
+TEST(RedBlackTreeTest, RandomOperationsKeepInvariants) {
+  Ditto::RedBlackTree<int, int> tree;
+  std::map<int, int> expected;
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<int> keys{0, 500};
+
+  for (int i = 0; i < 5000; i++) {
+    const int key = keys(generator);
+    if ((generator() % 3) == 0) {
+      EXPECT_EQ(tree.erase(key).has_value(), expected.erase(key) == 1);
+    } else {
+      tree.insert(key, i);
+      expected[key] = i;
+    }
+    ASSERT_TRUE(tree.satisfies_invariants()) << "after operation " << i;
+  }
+
+  std::vector<std::pair<int, int>> contents;
+  for (auto [key, value] : tree) {
+    contents.emplace_back(key, value);
+  }
+  EXPECT_EQ(contents,
+            (std::vector<std::pair<int, int>>{expected.begin(),
+                                              expected.end()}));
+  EXPECT_EQ(tree.size(), expected.size());
+}
+
+TEST(RedBlackTreeTest, EraseSingle) {
+  Ditto::RedBlackTree<int, int> tree;
+  EXPECT_FALSE(tree.erase(1).has_value());
+
+  tree.insert(1, 10);
+  auto result = tree.erase(1);
+  ASSERT_TRUE(result.has_value());
+  EXPECT_EQ(result.value(), 10);
+  EXPECT_FALSE(tree.lookup(1).has_value());
+  EXPECT_EQ(tree.begin(), tree.end());
+  EXPECT_EQ(tree.depth(), 0);
+}
+
+TEST(RedBlackTreeTest, EraseWithIterator) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 10; key++) {
+    tree.insert(key, key);
+  }
+
+  // Erase the odd keys while iterating
+  auto iter = tree.begin();
+  while (iter != tree.end()) {
+    if ((*iter).key % 2 != 0) {
+      iter = tree.erase(iter);
+    } else {
+      ++iter;
+    }
+  }
+  EXPECT_THAT(keys_of(tree), ElementsAre(0, 2, 4, 6, 8));
+  EXPECT_EQ(tree.erase(tree.cend()), tree.end());
+}
+
+TEST(RedBlackTreeTest, EraseKeepsBalance) {
+  constexpr int NUM_ELEMENTS = 2000;
+  Ditto::RedBlackTree<int, int> tree;
+  std::map<int, int> expected;
+
+  std::vector<int> keys(NUM_ELEMENTS);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::mt19937 rng{1234};
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (int key : keys) {
+    tree.insert(key, key * 2);
+    expected.emplace(key, key * 2);
+  }
+
+  std::shuffle(keys.begin(), keys.end(), rng);
+  for (std::size_t i = 0; i < keys.size(); i++) {
+    const int key = keys[i];
+    auto result = tree.erase(key);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result.value(), key * 2);
+    EXPECT_FALSE(tree.erase(key).has_value());
+    expected.erase(key);
+
+    if (i % 100 == 0) {
+      const double size = static_cast<double>(expected.size());
+      EXPECT_LE(tree.depth(), 2 * std::log2(size + 1.0));
+
+      std::vector<int> expected_keys;
+      for (const auto& [expected_key, value] : expected) {
+        expected_keys.push_back(expected_key);
+      }
+      ASSERT_EQ(keys_of(tree), expected_keys);
+    }
+  }
+  EXPECT_EQ(tree.begin(), tree.end());
+}
+
+TEST(RedBlackTreeTest, EraseKeepsOtherElementsInPlace) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 32; key++) {
+    tree.insert(key, key);
+  }
+
+  // Erasing a node with two children must not move its successor's value
+  int* successor_value = tree.lookup(16).value().get();
+  ASSERT_TRUE(tree.erase(15).has_value());
+  EXPECT_EQ(tree.lookup(16).value().get(), successor_value);
+  EXPECT_EQ(*successor_value, 16);
+}
+
+TEST(RedBlackTreeTest, UsesTheAllocator) {
+  struct Tag {};
+  using Allocator = Ditto::FixedPoolAllocator<int, 64, Tag>;
+
+  // The pool only fits 64 nodes, so this fails if nodes are leaked
+  for (int round = 0; round < 2; round++) {
+    Ditto::RedBlackTree<int, int, Allocator> tree;
+    for (int key = 0; key < 64; key++) {
+      tree.insert(key, key);
+    }
+
+    ASSERT_TRUE(tree.erase(10).has_value());
+    tree.insert(64, 64);
+
+    Ditto::RedBlackTree<int, int, Allocator> moved{std::move(tree)};
+    EXPECT_EQ((*moved.begin()).key, 0);
+    EXPECT_EQ(tree.begin(), tree.end());
+  }
+}
+
+TEST(RedBlackTreeTest, ClearsSlabAllocatedTreeAtOnce) {
+  Ditto::RedBlackTree<int, int, Ditto::SlabAllocator<int>> tree;
+  for (int key = 0; key < 1000; key++) {
+    tree.insert(key, key);
+  }
+  const int* first_value = tree.lookup(0).value().get();
+
+  tree.clear();
+  EXPECT_EQ(tree.begin(), tree.end());
+  EXPECT_FALSE(tree.lookup(0).has_value());
+
+  // The slabs are reused from the start
+  tree.insert(5, 5);
+  EXPECT_EQ(tree.lookup(5).value().get(), first_value);
+  EXPECT_EQ(tree.depth(), 1);
+}
+
+TEST(RedBlackTreeTest, ClearsTreeWithNonTrivialValues) {
+  auto counter = std::make_shared<int>(0);
+  Ditto::RedBlackTree<int, std::shared_ptr<int>, Ditto::SlabAllocator<int>>
+      tree;
+  for (int key = 0; key < 100; key++) {
+    tree.insert(key, counter);
+  }
+  EXPECT_EQ(counter.use_count(), 101);
+
+  tree.clear();
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(RedBlackTreeTest, Size) {
+  Ditto::RedBlackTree<int, int> tree;
+  EXPECT_TRUE(tree.empty());
+
+  for (int key = 0; key < 100; key++) {
+    tree.insert(key, key);
+  }
+  // Overwriting a value does not add an element
+  tree.insert(50, 0);
+  EXPECT_EQ(tree.size(), 100);
+
+  ASSERT_TRUE(tree.erase(50).has_value());
+  EXPECT_FALSE(tree.erase(50).has_value());
+  tree.erase(tree.begin());
+  EXPECT_EQ(tree.size(), 98);
+
+  Ditto::RedBlackTree<int, int> moved{std::move(tree)};
+  EXPECT_EQ(moved.size(), 98);
+  EXPECT_TRUE(tree.empty());
+
+  moved.clear();
+  EXPECT_TRUE(moved.empty());
+}
+
+TEST(RedBlackTreeTest, ForEach) {
+  Ditto::RedBlackTree<int, int> tree;
+  std::vector<int> keys(500);
+  std::iota(keys.begin(), keys.end(), 0);
+  std::shuffle(keys.begin(), keys.end(), std::mt19937{7});
+  for (int key : keys) {
+    tree.insert(key, key);
+  }
+
+  tree.for_each([](const int& /*unused*/, int& value) { value *= 2; });
+
+  std::vector<int> visited;
+  const auto& const_tree = tree;
+  const_tree.for_each([&](const int& key, const int& value) {
+    EXPECT_EQ(value, 2 * key);
+    visited.push_back(key);
+  });
+  std::sort(keys.begin(), keys.end());
+  EXPECT_EQ(visited, keys);
+}
+
+TEST(RedBlackTreeTest, VisitLevelOrder) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 7; key++) {
+    tree.insert(key, key);
+  }
+  // Levels are visited from the root down, each one from left to right
+  std::vector<std::uint32_t> depths;
+  std::vector<int> keys;
+  tree.visit_level_order(
+      [&](const int& key, const int& /*unused*/, std::uint32_t depth) {
+        keys.push_back(key);
+        depths.push_back(depth);
+      });
+  EXPECT_THAT(keys, ElementsAre(1, 0, 3, 2, 5, 4, 6));
+  EXPECT_THAT(depths, ElementsAre(0, 1, 1, 2, 2, 3, 3));
+  EXPECT_EQ(tree.depth(), 4);
+}
+
+TEST(RedBlackTreeTest, VisitsLargeTreeLevelByLevel) {
+  Ditto::RedBlackTree<int, int> tree;
+  for (int key = 0; key < 10000; key++) {
+    tree.insert(key, key);
+  }
+
+  std::size_t count = 0;
+  std::uint32_t last_depth = 0;
+  tree.visit_level_order(
+      [&](const int& /*unused*/, const int& /*unused*/, std::uint32_t depth) {
+        EXPECT_GE(depth, last_depth);
+        last_depth = depth;
+        count++;
+      });
+  EXPECT_EQ(count, tree.size());
+  EXPECT_EQ(last_depth + 1, tree.depth());
+}
+
+TEST(RedBlackTreeTest, FromSorted) {
+  for (int num_entries : {0, 1, 2, 3, 7, 8, 100, 1000}) {
+    std::vector<Ditto::Pair<int, int>> entries;
+    for (int i = 0; i < num_entries; i++) {
+      entries.emplace_back(2 * i, i);
+    }
+
+    auto tree = Ditto::RedBlackTree<int, int>::from_sorted(entries);
+    EXPECT_EQ(tree.size(), static_cast<std::size_t>(num_entries));
+    // Perfectly balanced
+    EXPECT_EQ(tree.depth(),
+              std::bit_width(static_cast<unsigned>(num_entries)));
+
+    int expected_key = 0;
+    for (auto [key, value] : tree) {
+      EXPECT_EQ(key, expected_key);
+      EXPECT_EQ(value, key / 2);
+      expected_key += 2;
+    }
+    EXPECT_EQ(expected_key, 2 * num_entries);
+  }
+}
+
+TEST(RedBlackTreeTest, FromSortedWithSlabAllocator) {
+  // A single entry is bulk-loaded in a slab slot, more in a heap array
+  for (int num_entries : {1, 100}) {
+    std::vector<Ditto::Pair<int, int>> entries;
+    for (int i = 0; i < num_entries; i++) {
+      entries.emplace_back(i, i);
+    }
+
+    using Tree = Ditto::RedBlackTree<int, int, Ditto::SlabAllocator<int, 4>>;
+    auto tree = Tree::from_sorted(entries);
+    tree.insert(num_entries, num_entries);
+    EXPECT_EQ(tree.size(), static_cast<std::size_t>(num_entries + 1));
+    EXPECT_TRUE(tree.erase(0).has_value());
+
+    tree.clear();
+    EXPECT_TRUE(tree.empty());
+    // Every node handed out after clearing is a distinct slot
+    for (int key = 0; key < 10; key++) {
+      tree.insert(key, key);
+    }
+    EXPECT_EQ(tree.size(), 10);
+    EXPECT_TRUE(tree.satisfies_invariants());
+    for (int key = 0; key < 10; key++) {
+      EXPECT_EQ(*tree.lookup(key).value(), key);
+    }
+  }
+}
+
+TEST(RedBlackTreeTest, FromSortedKeepsBalanceWhenModified) {
+  constexpr int NUM_ENTRIES = 1000;
+  std::vector<Ditto::Pair<int, int>> entries;
+  std::map<int, int> expected;
+  for (int i = 0; i < NUM_ENTRIES; i++) {
+    entries.emplace_back(2 * i, i);
+    expected[2 * i] = i;
+  }
+  auto tree = Ditto::RedBlackTree<int, int>::from_sorted(entries);
+
+  // Mixes nodes of the initial block with individually allocated ones
+  std::mt19937 generator{3};
+  std::uniform_int_distribution<int> distribution{0, 2 * NUM_ENTRIES};
+  for (int i = 0; i < 5000; i++) {
+    const int key = distribution(generator);
+    if ((i % 2) == 0) {
+      tree.insert(key, key);
+      expected[key] = key;
+    } else {
+      EXPECT_EQ(tree.erase(key).has_value(), expected.erase(key) == 1);
+    }
+    const double size = static_cast<double>(expected.size());
+    ASSERT_LE(tree.depth(), 2 * std::log2(size + 1.0));
+  }
+
+  ASSERT_EQ(tree.size(), expected.size());
+  auto it = expected.begin();
+  for (auto [key, value] : tree) {
+    EXPECT_EQ(key, it->first);
+    EXPECT_EQ(value, it->second);
+    ++it;
+  }
+
+  Ditto::RedBlackTree<int, int> moved{std::move(tree)};
+  moved.clear();
+  EXPECT_TRUE(moved.empty());
+}
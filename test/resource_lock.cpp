@@ -4,8 +4,17 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <array>
+#include <chrono>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ditto/shared_mutex.h"
 
 using testing::StrictMock;
 
@@ -69,6 +78,201 @@ TEST(ResourceLockTest, locks_and_unlocks_resource) {
   });
 }
 
+TEST(ResourceLockTest, try_lock_runs_action_when_uncontended) {
+  Ditto::ResourceLock<int, std::mutex> int_resource{123};
+
+  const bool ran = int_resource.try_lock([](int& res) { res = 3; });
+  EXPECT_TRUE(ran);
+
+  auto val = int_resource.try_lock([](int& res) { return res; });
+  ASSERT_TRUE(val.has_value());
+  EXPECT_EQ(*val, 3);
+}
+
+TEST(ResourceLockTest, try_lock_skips_action_when_contended) {
+  Ditto::ResourceLock<int, std::mutex> int_resource{123};
+
+  int_resource.lock([&](int&) {
+    std::thread worker{[&] {
+      const bool ran = int_resource.try_lock([](int& res) { res = 3; });
+      EXPECT_FALSE(ran);
+
+      auto val = int_resource.try_lock([](int& res) { return res; });
+      EXPECT_FALSE(val.has_value());
+    }};
+    worker.join();
+  });
+
+  int_resource.lock([](int& res) { EXPECT_EQ(res, 123); });
+}
+
+TEST(ResourceLockTest, try_lock_for_gives_up_after_timeout) {
+  using namespace std::chrono_literals;
+  Ditto::ResourceLock<int, std::timed_mutex> int_resource{123};
+
+  int_resource.lock([&](int&) {
+    std::thread worker{[&] {
+      auto val = int_resource.try_lock_for(1ms, [](int& res) { return res; });
+      EXPECT_FALSE(val.has_value());
+    }};
+    worker.join();
+  });
+
+  auto val = int_resource.try_lock_for(1ms, [](int& res) { return res; });
+  ASSERT_TRUE(val.has_value());
+  EXPECT_EQ(*val, 123);
+}
+
+TEST(ResourceLockTest, copy_locks_the_source) {
+  Ditto::ResourceLock<int, DummyMutex> int_resource{123};
+  StrictMock<MutexMock> mutex_mock;
+  g_mutex_mock = &mutex_mock;
+
+  EXPECT_CALL(mutex_mock, lock());
+  EXPECT_CALL(mutex_mock, unlock());
+  Ditto::ResourceLock<int, DummyMutex> copy{int_resource};
+  testing::Mock::VerifyAndClearExpectations(g_mutex_mock);
+  g_mutex_mock = nullptr;
+
+  copy.lock([](int& res) { EXPECT_EQ(res, 123); });
+}
+
+TEST(ResourceLockTest, can_copy_and_move) {
+  Ditto::ResourceLock<std::string, std::mutex> str_resource{"first"};
+  Ditto::ResourceLock<std::string, std::mutex> copy{str_resource};
+  copy.lock([](std::string& res) { EXPECT_EQ(res, "first"); });
+
+  Ditto::ResourceLock<std::unique_ptr<int>, std::mutex> ptr_resource{
+      std::make_unique<int>(123)};
+  Ditto::ResourceLock<std::unique_ptr<int>, std::mutex> moved{
+      std::move(ptr_resource)};
+  moved.lock([](std::unique_ptr<int>& res) {
+    ASSERT_TRUE(res);
+    EXPECT_EQ(*res, 123);
+  });
+
+  Ditto::ResourceLock<std::string, std::mutex> other{"second"};
+  copy = other;
+  copy.lock([](std::string& res) { EXPECT_EQ(res, "second"); });
+
+  copy = copy;
+  copy.lock([](std::string& res) { EXPECT_EQ(res, "second"); });
+
+  copy = Ditto::ResourceLock<std::string, std::mutex>{"third"};
+  copy.lock([](std::string& res) { EXPECT_EQ(res, "third"); });
+}
+
+TEST(ResourceLockTest, can_be_stored_in_containers) {
+  std::vector<Ditto::ResourceLock<int, std::mutex>> shards;
+  for (int i = 0; i < 8; i++) {
+    shards.emplace_back(i);
+  }
+
+  int sum = 0;
+  for (auto& shard : shards) {
+    sum += shard.lock([](int& res) { return res; });
+  }
+  EXPECT_EQ(sum, 28);
+}
+
+TEST(LockAllTest, runs_action_with_all_resources) {
+  Ditto::ResourceLock<int, std::mutex> from{100};
+  Ditto::ResourceLock<int, std::mutex> to{20};
+
+  auto total = Ditto::lock_all(
+      [](int& from_res, int& to_res) {
+        from_res -= 30;
+        to_res += 30;
+        return from_res + to_res;
+      },
+      from, to);
+  EXPECT_EQ(total, 120);
+
+  from.lock([](int& res) { EXPECT_EQ(res, 70); });
+  to.lock([](int& res) { EXPECT_EQ(res, 50); });
+}
+
+TEST(LockAllTest, supports_different_resource_and_mutex_types) {
+  Ditto::ResourceLock<int, std::mutex> counter{1};
+  Ditto::ResourceLock<std::string, std::timed_mutex> name{"name"};
+  Ditto::ResourceLock<std::vector<int>, Ditto::SharedMutex> values;
+
+  Ditto::lock_all(
+      [](int& counter_res, std::string& name_res,
+         std::vector<int>& values_res) {
+        values_res.push_back(counter_res);
+        name_res += std::to_string(counter_res);
+      },
+      counter, name, values);
+
+  name.lock([](std::string& res) { EXPECT_EQ(res, "name1"); });
+  values.lock([](std::vector<int>& res) { EXPECT_EQ(res.size(), 1); });
+}
+
+std::vector<std::pair<const void*, bool>> g_lock_log;
+
+class RecordingMutex {
+ public:
+  void lock() { g_lock_log.emplace_back(this, true); }
+  void unlock() { g_lock_log.emplace_back(this, false); }
+};
+
+TEST(LockAllTest, locks_in_address_order_and_unlocks_in_reverse) {
+  std::array<Ditto::ResourceLock<int, RecordingMutex>, 3> resources;
+
+  for (int i = 0; i < 2; i++) {
+    g_lock_log.clear();
+    if (i == 0) {
+      Ditto::lock_all([](int&, int&, int&) {}, resources[2], resources[0],
+                      resources[1]);
+    } else {
+      Ditto::lock_all([](int&, int&, int&) {}, resources[1], resources[2],
+                      resources[0]);
+    }
+
+    ASSERT_EQ(g_lock_log.size(), 6);
+    for (std::size_t j = 0; j < 3; j++) {
+      EXPECT_TRUE(g_lock_log[j].second);
+      EXPECT_FALSE(g_lock_log[5 - j].second);
+      EXPECT_EQ(g_lock_log[j].first, g_lock_log[5 - j].first);
+    }
+    EXPECT_LT(g_lock_log[0].first, g_lock_log[1].first);
+    EXPECT_LT(g_lock_log[1].first, g_lock_log[2].first);
+  }
+}
+
+TEST(LockAllTest, opposite_argument_orders_do_not_deadlock) {
+  constexpr int NUM_ITERATIONS = 10000;
+  Ditto::ResourceLock<int, std::mutex> a{1000};
+  Ditto::ResourceLock<int, std::mutex> b{1000};
+
+  auto transfer = [](int& from, int& to) {
+    from--;
+    to++;
+  };
+
+  std::thread forward{[&] {
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+      Ditto::lock_all(transfer, a, b);
+    }
+  }};
+  std::thread backward{[&] {
+    for (int i = 0; i < NUM_ITERATIONS; i++) {
+      Ditto::lock_all(transfer, b, a);
+    }
+  }};
+  forward.join();
+  backward.join();
+
+  auto total = Ditto::lock_all(
+      [](int& a_res, int& b_res) {
+        EXPECT_EQ(a_res, 1000);
+        return a_res + b_res;
+      },
+      a, b);
+  EXPECT_EQ(total, 2000);
+}
+
 TEST(ReadWriteLockTest, can_default_construct) {
   Ditto::ReadWriteLock<int, std::mutex> int_resource;
 }
@@ -130,3 +334,109 @@ TEST(ResourceLockTest, moves_out_in_write_lock) {
   EXPECT_TRUE(val);
   EXPECT_EQ(*val, 123);
 }
+
+TEST(ReadWriteLockTest, can_use_shared_mutex) {
+  Ditto::ReadWriteLock<int, Ditto::SharedMutex> int_resource{123};
+
+  int_resource.write_lock([](int& res) { res = 1234; });
+
+  int val = int_resource.read_lock([](const int& res) { return res; });
+  EXPECT_EQ(val, 1234);
+}
+
+TEST(ReadWriteLockTest, read_lock_does_not_copy_the_resource) {
+  Ditto::ReadWriteLock<std::unique_ptr<int>, Ditto::SharedMutex> int_resource{
+      std::make_unique<int>(123)};
+
+  int val = int_resource.read_lock(
+      [](const std::unique_ptr<int>& res) { return *res; });
+  EXPECT_EQ(val, 123);
+}
+
+TEST(ReadWriteLockTest, try_locks_fail_while_writer_holds_the_lock) {
+  Ditto::ReadWriteLock<int, std::mutex> int_resource{123};
+
+  int_resource.write_lock([&](int&) {
+    std::thread worker{[&] {
+      EXPECT_FALSE(int_resource.try_write_lock([](int&) {}));
+      EXPECT_FALSE(int_resource.try_read_lock([](const int&) {}));
+    }};
+    worker.join();
+  });
+
+  EXPECT_TRUE(int_resource.try_write_lock([](int& res) { res = 3; }));
+  auto val = int_resource.try_read_lock([](const int& res) { return res; });
+  ASSERT_TRUE(val.has_value());
+  EXPECT_EQ(*val, 3);
+}
+
+TEST(ReadWriteLockTest, try_read_lock_succeeds_with_other_readers) {
+  Ditto::ReadWriteLock<int, Ditto::SharedMutex> int_resource{123};
+
+  int_resource.read_lock([&](const int&) {
+    std::thread worker{[&] {
+      auto val =
+          int_resource.try_read_lock([](const int& res) { return res; });
+      ASSERT_TRUE(val.has_value());
+      EXPECT_EQ(*val, 123);
+      EXPECT_FALSE(int_resource.try_write_lock([](int&) {}));
+    }};
+    worker.join();
+  });
+}
+
+template <typename M>
+class TimedReadWriteLockTest : public testing::Test {};
+
+using TimedMutexTypes =
+    testing::Types<std::timed_mutex, std::shared_timed_mutex,
+                   Ditto::SharedMutex>;
+TYPED_TEST_SUITE(TimedReadWriteLockTest, TimedMutexTypes);
+
+TYPED_TEST(TimedReadWriteLockTest, timed_locks_give_up_after_timeout) {
+  using namespace std::chrono_literals;
+  Ditto::ReadWriteLock<int, TypeParam> int_resource{123};
+
+  int_resource.write_lock([&](int&) {
+    std::thread worker{[&] {
+      EXPECT_FALSE(int_resource.try_write_lock_for(1ms, [](int&) {}));
+      EXPECT_FALSE(int_resource.try_read_lock_for(1ms, [](const int&) {}));
+    }};
+    worker.join();
+  });
+
+  int_resource.read_lock([&](const int&) {
+    std::thread worker{[&] {
+      EXPECT_FALSE(int_resource.try_write_lock_for(1ms, [](int&) {}));
+    }};
+    worker.join();
+  });
+
+  EXPECT_TRUE(int_resource.try_write_lock_for(1ms, [](int& res) { res = 3; }));
+  auto val = int_resource.try_read_lock_for(
+      1ms, [](const int& res) { return res; });
+  ASSERT_TRUE(val.has_value());
+  EXPECT_EQ(*val, 3);
+}
+
+TEST(ReadWriteLockTest, can_copy_and_move) {
+  Ditto::ReadWriteLock<std::string, Ditto::SharedMutex> str_resource{"first"};
+  Ditto::ReadWriteLock<std::string, Ditto::SharedMutex> copy{str_resource};
+  copy.read_lock([](const std::string& res) { EXPECT_EQ(res, "first"); });
+
+  Ditto::ReadWriteLock<std::unique_ptr<int>, std::mutex> ptr_resource{
+      std::make_unique<int>(123)};
+  Ditto::ReadWriteLock<std::unique_ptr<int>, std::mutex> moved{
+      std::move(ptr_resource)};
+  moved.read_lock([](const std::unique_ptr<int>& res) {
+    ASSERT_TRUE(res);
+    EXPECT_EQ(*res, 123);
+  });
+
+  Ditto::ReadWriteLock<std::string, Ditto::SharedMutex> other{"second"};
+  copy = other;
+  copy.read_lock([](const std::string& res) { EXPECT_EQ(res, "second"); });
+
+  copy = Ditto::ReadWriteLock<std::string, Ditto::SharedMutex>{"third"};
+  copy.read_lock([](const std::string& res) { EXPECT_EQ(res, "third"); });
+}
@@ -0,0 +1,96 @@
+#include "ditto/seq_lock.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Statistics {
+  std::uint32_t count;
+  std::uint64_t total;
+  std::uint8_t flags;
+};
+
+}  // namespace
+
+TEST(SeqLockTest, CanConstructResourceForwardingArgs) {
+  Ditto::SeqLock<int> int_resource{123};
+  EXPECT_EQ(int_resource.load(), 123);
+
+  Ditto::SeqLock<Statistics> stats{1u, std::uint64_t{2}, std::uint8_t{3}};
+  const Statistics snapshot = stats.load();
+  EXPECT_EQ(snapshot.count, 1);
+  EXPECT_EQ(snapshot.total, 2);
+  EXPECT_EQ(snapshot.flags, 3);
+}
+
+TEST(SeqLockTest, CanLockResource) {
+  Ditto::SeqLock<int> int_resource{123};
+
+  int_resource.lock([](int& res) {
+    EXPECT_EQ(res, 123);
+    res = 3;
+  });
+
+  int_resource.read_lock([](const int& res) { EXPECT_EQ(res, 3); });
+}
+
+TEST(SeqLockTest, CanReturnValuesFromClosures) {
+  Ditto::SeqLock<int> int_resource{123};
+
+  auto previous = int_resource.lock([](int& res) {
+    const int prev = res;
+    res = 0;
+    return prev;
+  });
+  EXPECT_EQ(previous, 123);
+
+  auto current = int_resource.read_lock([](const int& res) { return res; });
+  EXPECT_EQ(current, 0);
+}
+
+TEST(SeqLockTest, CanStoreValues) {
+  Ditto::SeqLock<Statistics> stats{0u, std::uint64_t{0}, std::uint8_t{0}};
+  stats.store(Statistics{4, 5, 6});
+  EXPECT_EQ(stats.load().total, 5);
+}
+
+TEST(SeqLockTest, ReadersNeverObserveTornWrites) {
+  constexpr int NUM_READERS = 3;
+  constexpr std::uint32_t NUM_WRITES = 5000;
+
+  Ditto::SeqLock<Statistics> stats{0u, std::uint64_t{0}, std::uint8_t{0}};
+  std::atomic_bool done{false};
+  std::atomic_int errors{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < NUM_READERS; i++) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        stats.read_lock([&](const Statistics& snapshot) {
+          if (snapshot.total != std::uint64_t{snapshot.count} * 3) {
+            errors++;
+          }
+        });
+      }
+    });
+  }
+
+  for (std::uint32_t i = 0; i < NUM_WRITES; i++) {
+    stats.lock([](Statistics& value) {
+      value.count++;
+      value.total += 3;
+    });
+  }
+  done = true;
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(errors, 0);
+  EXPECT_EQ(stats.load().count, NUM_WRITES);
+}
@@ -0,0 +1,118 @@
+#include "ditto/shared_mutex.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+template <class Mutex>
+class SharedMutexTest : public testing::Test {};
+
+using SharedMutexTypes =
+    testing::Types<Ditto::SharedMutex, Ditto::DistributedSharedMutex<>,
+                   Ditto::DistributedSharedMutex<1>>;
+TYPED_TEST_SUITE(SharedMutexTest, SharedMutexTypes);
+
+TYPED_TEST(SharedMutexTest, ExclusiveLockExcludesEveryone) {
+  TypeParam mutex;
+  mutex.lock();
+  EXPECT_FALSE(mutex.try_lock());
+  EXPECT_FALSE(mutex.try_lock_shared());
+  mutex.unlock();
+
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
+
+TYPED_TEST(SharedMutexTest, SharedLocksCanBeHeldConcurrently) {
+  TypeParam mutex;
+  mutex.lock_shared();
+  EXPECT_TRUE(mutex.try_lock_shared());
+  EXPECT_FALSE(mutex.try_lock());
+
+  mutex.unlock_shared();
+  EXPECT_FALSE(mutex.try_lock());
+  mutex.unlock_shared();
+
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
+
+TYPED_TEST(SharedMutexTest, WaitingWriterBlocksNewReaders) {
+  TypeParam mutex;
+  std::atomic_bool writer_done{false};
+
+  mutex.lock_shared();
+  std::thread writer{[&]() {
+    mutex.lock();
+    writer_done = true;
+    mutex.unlock();
+  }};
+
+  // Once the writer has announced itself, readers can no longer get in
+  while (mutex.try_lock_shared()) {
+    mutex.unlock_shared();
+    std::this_thread::yield();
+  }
+  EXPECT_FALSE(writer_done);
+
+  mutex.unlock_shared();
+  writer.join();
+  EXPECT_TRUE(writer_done);
+}
+
+TYPED_TEST(SharedMutexTest, ReadersNeverObserveTornWrites) {
+  constexpr int NUM_READERS = 4;
+  constexpr int NUM_WRITES = 2000;
+
+  TypeParam mutex;
+  int first = 0;
+  int second = 0;
+  std::atomic_bool done{false};
+  std::atomic_int errors{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < NUM_READERS; i++) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        std::shared_lock lock{mutex};
+        if (first != second) {
+          errors++;
+        }
+      }
+    });
+  }
+
+  for (int i = 0; i < NUM_WRITES; i++) {
+    std::scoped_lock lock{mutex};
+    first++;
+    second++;
+  }
+  done = true;
+
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(errors, 0);
+  EXPECT_EQ(first, NUM_WRITES);
+}
+
+TEST(DistributedSharedMutexTest, ReadersInDifferentThreadsShareTheLock) {
+  Ditto::DistributedSharedMutex<4> mutex;
+  mutex.lock_shared();
+
+  std::thread reader{[&]() {
+    EXPECT_TRUE(mutex.try_lock_shared());
+    EXPECT_FALSE(mutex.try_lock());
+    mutex.unlock_shared();
+  }};
+  reader.join();
+
+  EXPECT_FALSE(mutex.try_lock());
+  mutex.unlock_shared();
+  EXPECT_TRUE(mutex.try_lock());
+  mutex.unlock();
+}
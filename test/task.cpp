@@ -0,0 +1,77 @@
+#include "ditto/task.h"
+
+#include <gtest/gtest.h>
+
+namespace {
+
+auto forty_two() -> Ditto::Task<int> { co_return 42; }
+
+auto add_one() -> Ditto::Task<int> {
+  const int value = co_await forty_two();
+  co_return value + 1;
+}
+
+auto store(int* destination) -> Ditto::Task<> {
+  *destination = co_await add_one();
+}
+
+using SingleFramePool = Ditto::TaskFramePool<512, 1>;
+
+auto from_single_frame_pool() -> Ditto::Task<int, SingleFramePool> {
+  co_return 1;
+}
+
+using TinyFramePool = Ditto::TaskFramePool<8, 4>;
+
+auto from_tiny_frame_pool() -> Ditto::Task<int, TinyFramePool> { co_return 1; }
+
+auto await_tiny_frame_pool_task() -> Ditto::Task<int> {
+  co_return co_await from_tiny_frame_pool();
+}
+
+}  // namespace
+
+TEST(TaskTest, IsLazilyStarted) {
+  auto task = forty_two();
+  ASSERT_TRUE(task.valid());
+  EXPECT_FALSE(task.done());
+
+  task.start();
+  ASSERT_TRUE(task.done());
+  EXPECT_EQ(task.result(), 42);
+}
+
+TEST(TaskTest, AwaitsNestedTasks) {
+  int value = 0;
+  auto task = store(&value);
+  task.start();
+
+  EXPECT_TRUE(task.done());
+  EXPECT_EQ(value, 43);
+}
+
+TEST(TaskTest, FramesAreReturnedToThePool) {
+  auto first = from_single_frame_pool();
+  EXPECT_TRUE(first.valid());
+
+  auto second = from_single_frame_pool();
+  EXPECT_FALSE(second.valid());
+  EXPECT_FALSE(second.done());
+
+  first = Ditto::Task<int, SingleFramePool>{};
+  auto third = from_single_frame_pool();
+  ASSERT_TRUE(third.valid());
+  third.start();
+  EXPECT_EQ(third.result(), 1);
+}
+
+TEST(TaskTest, FramesLargerThanThePoolSlotsFail) {
+  auto task = from_tiny_frame_pool();
+  EXPECT_FALSE(task.valid());
+}
+
+TEST(TaskTest, AwaitingAnInvalidTaskTerminates) {
+  auto task = await_tiny_frame_pool_task();
+  ASSERT_TRUE(task.valid());
+  EXPECT_DEATH(task.start(), "");
+}
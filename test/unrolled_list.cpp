@@ -0,0 +1,125 @@
+#include "ditto/unrolled_list.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+using Ditto::UnrolledList;
+using testing::ElementsAre;
+using testing::ElementsAreArray;
+
+TEST(UnrolledListTest, PushBackAcrossChunks) {
+  UnrolledList<int, 4> list;
+  for (int i = 0; i < 10; i++) {
+    list.push_back(i);
+  }
+
+  EXPECT_EQ(list.size(), 10);
+  EXPECT_EQ(list.front(), 0);
+  EXPECT_EQ(list.back(), 9);
+  EXPECT_THAT(list, ElementsAre(0, 1, 2, 3, 4, 5, 6, 7, 8, 9));
+}
+
+TEST(UnrolledListTest, PushFrontAcrossChunks) {
+  UnrolledList<int, 4> list;
+  for (int i = 0; i < 6; i++) {
+    list.push_front(i);
+  }
+  list.push_back(6);
+
+  EXPECT_THAT(list, ElementsAre(5, 4, 3, 2, 1, 0, 6));
+  EXPECT_THAT(std::vector<int>(list.rbegin(), list.rend()),
+              ElementsAre(6, 0, 1, 2, 3, 4, 5));
+}
+
+TEST(UnrolledListTest, WorksAsAQueue) {
+  UnrolledList<int, 3> list;
+  std::deque<int> expected;
+
+  int next = 0;
+  for (int round = 0; round < 20; round++) {
+    for (int i = 0; i < round % 5 + 1; i++) {
+      list.push_back(next);
+      expected.push_back(next);
+      next++;
+    }
+    for (int i = 0; i < round % 3 + 1 && !expected.empty(); i++) {
+      EXPECT_EQ(list.front(), expected.front());
+      list.pop_front();
+      expected.pop_front();
+    }
+    ASSERT_EQ(list.size(), expected.size());
+    ASSERT_THAT(list, ElementsAreArray(expected));
+  }
+
+  while (!list.empty()) {
+    EXPECT_EQ(list.back(), expected.back());
+    list.pop_back();
+    expected.pop_back();
+  }
+  EXPECT_TRUE(expected.empty());
+  EXPECT_EQ(list.begin(), list.end());
+}
+
+TEST(UnrolledListTest, ErasesElements) {
+  UnrolledList<std::string, 2> list;
+  for (const char* value : {"a", "b", "c", "d", "e"}) {
+    list.push_back(value);
+  }
+
+  // Erasing the last element of a chunk moves to the next chunk
+  auto iter = list.erase(++list.cbegin());
+  EXPECT_EQ(*iter, "c");
+  EXPECT_THAT(list, ElementsAre("a", "c", "d", "e"));
+
+  // Erasing the only element of a chunk releases it
+  iter = list.erase(list.cbegin());
+  EXPECT_EQ(*iter, "c");
+  EXPECT_THAT(list, ElementsAre("c", "d", "e"));
+
+  iter = list.erase(std::find(list.cbegin(), list.cend(), "e"));
+  EXPECT_EQ(iter, list.end());
+  EXPECT_EQ(list.back(), "d");
+  EXPECT_EQ(list.size(), 2);
+  EXPECT_THAT(list, ElementsAre("c", "d"));
+}
+
+TEST(UnrolledListTest, DestroysAllElements) {
+  auto counter = std::make_shared<int>(0);
+  {
+    UnrolledList<std::shared_ptr<int>, 4> list;
+    for (int i = 0; i < 9; i++) {
+      list.push_back(counter);
+      list.emplace_front(counter);
+    }
+    list.pop_front();
+    list.pop_back();
+    EXPECT_EQ(counter.use_count(), 17);
+
+    UnrolledList<std::shared_ptr<int>, 4> moved{std::move(list)};
+    EXPECT_TRUE(list.empty());
+    EXPECT_EQ(moved.size(), 16);
+  }
+  EXPECT_EQ(counter.use_count(), 1);
+}
+
+TEST(UnrolledListTest, ConstIteration) {
+  UnrolledList<int, 4> list;
+  for (int i = 0; i < 6; i++) {
+    list.push_back(i);
+  }
+  const auto& const_list = list;
+
+  int sum = 0;
+  for (UnrolledList<int, 4>::const_iterator iter = list.begin();
+       iter != const_list.end(); ++iter) {
+    sum += *iter;
+  }
+  EXPECT_EQ(sum, 15);
+  EXPECT_EQ(*--const_list.end(), 5);
+}